@@ -0,0 +1,439 @@
+/**
+ * @file       Arduino.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * The small part of the Arduino core TinyGSM needs, for building on a
+ * POSIX host (Linux gateway, Raspberry Pi, dev box).  Selected in
+ * TinyGsmCommon.h when TINY_GSM_HOST is defined.
+ */
+
+#ifndef TinyGsmHostArduino_h
+#define TinyGsmHostArduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <string>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define LOW    0
+#define HIGH   1
+#define INPUT  0
+#define OUTPUT 1
+
+using std::min;
+using std::max;
+
+template<class T, class L, class H>
+T constrain(T x, L lo, H hi) {
+  return (x < (T)lo) ? (T)lo : ((x > (T)hi) ? (T)hi : x);
+}
+
+/*
+ * Time
+ */
+
+inline uint64_t hostMicros64() {
+  static struct timespec start;
+  static bool started = false;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (!started) {
+    start = now;
+    started = true;
+  }
+  return (uint64_t)(now.tv_sec - start.tv_sec) * 1000000ULL +
+         (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+inline unsigned long micros() {
+  return (unsigned long)hostMicros64();
+}
+
+inline unsigned long millis() {
+  return (unsigned long)(hostMicros64() / 1000);
+}
+
+inline void yield() {
+  sched_yield();
+}
+
+inline void delay(unsigned long ms) {
+  if (ms == 0) {
+    yield();
+    return;
+  }
+  usleep(ms * 1000);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  usleep(us);
+}
+
+/*
+ * GPIO, there is none; TINY_GSM_RTS can be pointed at SerialPort::setRts()
+ */
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return LOW; }
+
+inline long random(long howbig) {
+  return howbig ? (rand() % howbig) : 0;
+}
+
+inline long random(long howsmall, long howbig) {
+  return (howsmall >= howbig) ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+inline void randomSeed(unsigned long seed) {
+  srand(seed);
+}
+
+/*
+ * String, on top of std::string
+ */
+
+class String {
+public:
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& c) : s(c) {}
+  explicit String(char c) : s(1, c) {}
+  String(int v, int base = DEC)           { format(base == HEX ? "%X" : "%d", v); }
+  String(unsigned v, int base = DEC)      { format(base == HEX ? "%X" : "%u", v); }
+  String(long v, int base = DEC)          { format(base == HEX ? "%lX" : "%ld", v); }
+  String(unsigned long v, int base = DEC) { format(base == HEX ? "%lX" : "%lu", v); }
+  String(double v, int dec = 2)           { format("%.*f", dec, v); }
+
+  bool reserve(unsigned n)       { s.reserve(n); return true; }
+  unsigned length() const        { return s.size(); }
+  const char* c_str() const      { return s.c_str(); }
+  char charAt(unsigned i) const  { return (*this)[i]; }
+  char operator[](unsigned i) const { return (i < s.size()) ? s[i] : 0; }
+  char& operator[](unsigned i)   { return s[i]; }
+
+  String& operator+=(const String& o)  { s += o.s; return *this; }
+  String& operator+=(const char* o)    { if (o) s += o; return *this; }
+  String& operator+=(char c)           { s += c; return *this; }
+  String& operator+=(unsigned char v)  { return *this += String((unsigned)v); }
+  String& operator+=(int v)            { return *this += String(v); }
+  String& operator+=(unsigned v)       { return *this += String(v); }
+  String& operator+=(long v)           { return *this += String(v); }
+  String& operator+=(unsigned long v)  { return *this += String(v); }
+  bool concat(const String& o)         { s += o.s; return true; }
+  bool concat(char c)                  { s += c; return true; }
+
+  friend String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+  friend String operator+(const String& a, const char* b)   { String r(a); r += b; return r; }
+  friend String operator+(const char* a, const String& b)   { String r(a); r += b; return r; }
+  friend String operator+(const String& a, char b)          { String r(a); r += b; return r; }
+  friend String operator+(const String& a, int b)           { String r(a); r += b; return r; }
+
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator==(const char* o) const   { return s == (o ? o : ""); }
+  bool operator!=(const String& o) const { return s != o.s; }
+  bool operator!=(const char* o) const   { return !(*this == o); }
+  bool equals(const String& o) const     { return s == o.s; }
+  bool equalsIgnoreCase(const String& o) const {
+    if (o.s.size() != s.size()) return false;
+    for (size_t i = 0; i < s.size(); i++) {
+      if (tolower(s[i]) != tolower(o.s[i])) return false;
+    }
+    return true;
+  }
+  bool startsWith(const String& p) const {
+    return s.size() >= p.s.size() && s.compare(0, p.s.size(), p.s) == 0;
+  }
+  bool endsWith(const String& p) const {
+    return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0;
+  }
+
+  int indexOf(char c, unsigned from = 0) const           { return pos(s.find(c, from)); }
+  int indexOf(const String& c, unsigned from = 0) const  { return pos(s.find(c.s, from)); }
+  int lastIndexOf(char c) const                          { return pos(s.rfind(c)); }
+  int lastIndexOf(char c, unsigned from) const           { return pos(s.rfind(c, from)); }
+  int lastIndexOf(const String& c) const                 { return pos(s.rfind(c.s)); }
+  int lastIndexOf(const String& c, unsigned from) const  { return pos(s.rfind(c.s, from)); }
+
+  String substring(unsigned b) const {
+    return (b >= s.size()) ? String() : String(s.substr(b));
+  }
+  String substring(unsigned b, unsigned e) const {
+    if (b > e) std::swap(b, e);
+    if (b >= s.size()) return String();
+    return String(s.substr(b, std::min<size_t>(e, s.size()) - b));
+  }
+
+  void replace(char f, char t) { std::replace(s.begin(), s.end(), f, t); }
+  void replace(const String& f, const String& t) {
+    if (f.s.empty()) return;
+    size_t p = 0;
+    while ((p = s.find(f.s, p)) != std::string::npos) {
+      s.replace(p, f.s.size(), t.s);
+      p += t.s.size();
+    }
+  }
+  void remove(unsigned i)             { if (i < s.size()) s.erase(i); }
+  void remove(unsigned i, unsigned n) { if (i < s.size()) s.erase(i, n); }
+  void trim() {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    s = s.substr(b, e - b);
+  }
+  void toUpperCase() { for (size_t i = 0; i < s.size(); i++) s[i] = toupper(s[i]); }
+  void toLowerCase() { for (size_t i = 0; i < s.size(); i++) s[i] = tolower(s[i]); }
+
+  long toInt() const    { return atol(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+  void toCharArray(char* buf, unsigned n) const {
+    if (!n) return;
+    size_t k = std::min<size_t>(n - 1, s.size());
+    memcpy(buf, s.data(), k);
+    buf[k] = 0;
+  }
+  void getBytes(unsigned char* buf, unsigned n) const { toCharArray((char*)buf, n); }
+
+private:
+  template<typename T>
+  void format(const char* fmt, T v) {
+    char b[34];
+    snprintf(b, sizeof(b), fmt, v);
+    s = b;
+  }
+  void format(const char* fmt, int dec, double v) {
+    char b[64];
+    snprintf(b, sizeof(b), fmt, dec, v);
+    s = b;
+  }
+  static int pos(size_t p) { return (p == std::string::npos) ? -1 : (int)p; }
+
+  std::string s;
+};
+
+/*
+ * Print and Stream
+ */
+
+class Print;
+
+class Printable {
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      if (!write(*buf++)) break;
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char* str) {
+    return str ? write((const uint8_t*)str, strlen(str)) : 0;
+  }
+  size_t write(const char* buf, size_t size) {
+    return write((const uint8_t*)buf, size);
+  }
+  virtual void flush() {}
+
+  size_t print(const char* str)         { return write(str); }
+  size_t print(const String& str)       { return write((const uint8_t*)str.c_str(), str.length()); }
+  size_t print(char c)                  { return write((uint8_t)c); }
+  size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(int v, int base = DEC)           { return print((long)v, base); }
+  size_t print(unsigned v, int base = DEC)      { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) {
+    if (base != DEC) return print((unsigned long)v, base);
+    char b[24];
+    snprintf(b, sizeof(b), "%ld", v);
+    return print(b);
+  }
+  size_t print(unsigned long v, int base = DEC) {
+    char b[24];
+    snprintf(b, sizeof(b), (base == HEX) ? "%lX" : "%lu", v);
+    return print(b);
+  }
+  size_t print(long long v, int base = DEC)          { return print((long)v, base); }
+  size_t print(unsigned long long v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(double v, int dec = 2) {
+    char b[64];
+    snprintf(b, sizeof(b), "%.*f", dec, v);
+    return print(b);
+  }
+  size_t print(const Printable& p) { return p.printTo(*this); }
+
+  size_t println() { return print("\r\n"); }
+  template<typename T>
+  size_t println(const T& v) { size_t n = print(v); return n + println(); }
+  template<typename T>
+  size_t println(const T& v, int base) { size_t n = print(v, base); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+  Stream() : _timeout(1000) {}
+
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() { return _timeout; }
+
+  size_t readBytes(char* buf, size_t size) {
+    size_t n = 0;
+    while (n < size) {
+      int c = timedRead();
+      if (c < 0) break;
+      buf[n++] = (char)c;
+    }
+    return n;
+  }
+  size_t readBytes(uint8_t* buf, size_t size) { return readBytes((char*)buf, size); }
+
+  String readStringUntil(char terminator) {
+    String ret;
+    int c = timedRead();
+    while (c >= 0 && c != terminator) {
+      ret += (char)c;
+      c = timedRead();
+    }
+    return ret;
+  }
+  String readString() {
+    String ret;
+    int c = timedRead();
+    while (c >= 0) {
+      ret += (char)c;
+      c = timedRead();
+    }
+    return ret;
+  }
+
+  bool find(const char* target) {
+    size_t i = 0, len = strlen(target);
+    while (i < len) {
+      int c = timedRead();
+      if (c < 0) return false;
+      i = (c == target[i]) ? i + 1 : ((c == target[0]) ? 1 : 0);
+    }
+    return true;
+  }
+
+  long parseInt() {
+    int c;
+    while ((c = timedPeek()) >= 0 && c != '-' && (c < '0' || c > '9')) {
+      read();
+    }
+    if (c < 0) return 0;
+    bool negative = (c == '-');
+    if (negative) read();
+    long value = 0;
+    while ((c = timedPeek()) >= '0' && c <= '9') {
+      value = value * 10 + c - '0';
+      read();
+    }
+    return negative ? -value : value;
+  }
+  float parseFloat() { return (float)parseInt(); }
+
+protected:
+  int timedRead() {
+    unsigned long start = millis();
+    do {
+      int c = read();
+      if (c >= 0) return c;
+      yield();
+    } while (millis() - start < _timeout);
+    return -1;
+  }
+  int timedPeek() {
+    unsigned long start = millis();
+    do {
+      int c = peek();
+      if (c >= 0) return c;
+      yield();
+    } while (millis() - start < _timeout);
+    return -1;
+  }
+
+  unsigned long _timeout;
+};
+
+/*
+ * The console, stdout and stdin, standing in for Serial
+ */
+
+class HostConsole : public Stream {
+public:
+  HostConsole() : peeked(-1) {}
+
+  void begin(unsigned long) {}
+  operator bool() { return true; }
+
+  size_t write(uint8_t c) {
+    return fwrite(&c, 1, 1, stdout);
+  }
+  size_t write(const uint8_t* buf, size_t size) {
+    return fwrite(buf, 1, size, stdout);
+  }
+  using Print::write;
+  void flush() {
+    fflush(stdout);
+  }
+
+  int available() {
+    if (peeked >= 0) return 1;
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    return (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) ? 1 : 0;
+  }
+  int read() {
+    int c = peek();
+    peeked = -1;
+    return c;
+  }
+  int peek() {
+    if (peeked < 0 && available()) {
+      uint8_t c;
+      if (::read(STDIN_FILENO, &c, 1) == 1) {
+        peeked = c;
+      }
+    }
+    return peeked;
+  }
+
+private:
+  int peeked;
+};
+
+static HostConsole Serial;
+
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file       IPAddress.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmHostIPAddress_h
+#define TinyGsmHostIPAddress_h
+
+#include <HostCompat/Arduino.h>
+
+class IPAddress : public Printable {
+public:
+  IPAddress() { memset(bytes, 0, sizeof(bytes)); }
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    bytes[0] = a; bytes[1] = b; bytes[2] = c; bytes[3] = d;
+  }
+  IPAddress(uint32_t address) { memcpy(bytes, &address, sizeof(bytes)); }
+  IPAddress(const uint8_t* address) { memcpy(bytes, address, sizeof(bytes)); }
+
+  bool fromString(const char* address) {
+    unsigned a, b, c, d;
+    char end;
+    if (sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 ||
+        a > 255 || b > 255 || c > 255 || d > 255) {
+      return false;
+    }
+    bytes[0] = a; bytes[1] = b; bytes[2] = c; bytes[3] = d;
+    return true;
+  }
+  bool fromString(const String& address) { return fromString(address.c_str()); }
+
+  operator uint32_t() const {
+    uint32_t v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+  }
+  bool operator==(const IPAddress& o) const { return memcmp(bytes, o.bytes, sizeof(bytes)) == 0; }
+  bool operator!=(const IPAddress& o) const { return !(*this == o); }
+  uint8_t operator[](int i) const { return bytes[i]; }
+  uint8_t& operator[](int i) { return bytes[i]; }
+
+  size_t printTo(Print& p) const {
+    size_t n = 0;
+    for (int i = 0; i < 4; i++) {
+      n += p.print((unsigned)bytes[i]);
+      if (i < 3) n += p.print('.');
+    }
+    return n;
+  }
+
+private:
+  uint8_t bytes[4];
+};
+
+#endif
@@ -0,0 +1,1182 @@
+/**
+ * @file       ModemSim.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * A fake modem behind a Stream, for running the drivers on a host without
+ * hardware.  Commands are answered by scripted rules (prefix -> canned text
+ * or a handler), bytes in both directions take as long as they would at the
+ * configured baud rate, each command adds a response latency, URCs can be
+ * injected at any time, and each family's socket commands serve a payload
+ * (e.g. extras/test_1k.bin) to every socket that is opened.  It can also
+ * play back a TinyGsmTrace recorded on a device.  After AT+CMUX it speaks
+ * 3GPP TS 27.010 basic option frames, for testing TinyGsmCmux, and a byte
+ * handler can stand in for the far end of a data call.
+ *
+ *   ModemSim sim(ModemSim::SIMCOM, 115200);
+ *   sim.loadPayload("extras/test_10k.bin");
+ *   TinyGsm modem(sim);
+ */
+
+#ifndef TinyGsmHostModemSim_h
+#define TinyGsmHostModemSim_h
+
+#include <HostCompat/Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+
+// Sockets the fake modem keeps, indexed by mux
+#ifndef TINY_GSM_SIM_SOCKETS
+  #define TINY_GSM_SIM_SOCKETS 8
+#endif
+
+// Received bytes a socket buffers inside the modem; the rest is still "in
+// the network" and shows up as the host reads
+#ifndef TINY_GSM_SIM_MODEM_BUFFER
+  #define TINY_GSM_SIM_MODEM_BUFFER 8192
+#endif
+
+// Bytes the host can write ahead of the wire, like a UART transmit fifo
+#ifndef TINY_GSM_SIM_TX_FIFO
+  #define TINY_GSM_SIM_TX_FIFO 64
+#endif
+
+// 27.010 framing, see TinyGsmCmux.h
+#define TINY_GSM_SIM_FLAG 0xF9
+#define TINY_GSM_SIM_SABM 0x2F
+#define TINY_GSM_SIM_UA   0x63
+#define TINY_GSM_SIM_DISC 0x43
+#define TINY_GSM_SIM_UIH  0xEF
+
+class ModemSim : public Stream {
+public:
+  enum Family {
+    SIMCOM,     // SIM800/808/900, SIM7000
+    QUECTEL,    // BG96
+    UBLOX,      // SARA-U/G, SARA-R4
+    SEQUANS,    // Monarch
+    ESPRESSIF,  // ESP8266 AT firmware
+    XBEE,       // Digi XBee cellular, transparent mode
+  };
+
+  // Called with the command text that follows the rule's prefix
+  typedef std::function<void(ModemSim& sim, const String& args)> Handler;
+  // Called once the bytes announced with expectData() have arrived
+  typedef std::function<void(ModemSim& sim, const std::string& data)> DataHandler;
+  // Called with each byte from the host, see setByteHandler()
+  typedef std::function<void(ModemSim& sim, uint8_t c)> ByteHandler;
+
+  struct Socket {
+    bool        open;
+    std::string rx;         // what the far end sends
+    size_t      rx_pos;     // next byte handed to the host
+    size_t      sent;       // bytes the host wrote to this socket
+  };
+
+  explicit ModemSim(Family family, unsigned long baud = 115200)
+    : family(family), nl((family == XBEE) ? "\r" : "\r\n"),
+      byte_us(0), latency_us(0), tx_done(0), reply_at(0),
+      rts_held(false), held_at(0), rx_limit(0), n_dropped(0), connect_ms(0),
+      data_left(0), data_mode(false), pluses(0), last_cr(false),
+      chained(false), chain_error(false),
+      mux_on(false), mux_synced(false), mux_n1(127), mux_dlci(1), mux_bad(0),
+      echo(false), close_after_payload(true),
+      n_commands(0), n_uploaded(0), n_downloaded(0),
+      replaying(false), trace_idx(0), trace_pos(0), trace_base(0),
+      host_bytes(0), mismatch(-1)
+  {
+    setBaud(baud);
+    for (int i = 0; i < TINY_GSM_SIM_SOCKETS; i++) {
+      sockets[i].open = false;
+      sockets[i].rx_pos = sockets[i].sent = 0;
+    }
+    setupCommon();
+    switch (family) {
+      case SIMCOM:    setupSimcom();    break;
+      case QUECTEL:   setupQuectel();   break;
+      case UBLOX:     setupUblox();     break;
+      case SEQUANS:   setupSequans();   break;
+      case ESPRESSIF: setupEspressif(); break;
+      case XBEE:      setupXBee();      break;
+    }
+  }
+
+  /*
+   * Script
+   */
+
+  // Later rules win over earlier ones, so these override the family's own.
+  // Lines of a canned response are separated by '\n' and framed like the
+  // modem would frame them, e.g. on("+CSQ", "+CSQ: 20,99\nOK").
+  void on(const char* prefix, const char* response, uint32_t latency_ms = 0) {
+    std::string text(response);
+    on(prefix, [text, latency_ms](ModemSim& sim, const String&) {
+      sim.delayReply(latency_ms);
+      size_t start = 0;
+      while (start <= text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        sim.reply(text.substr(start, end - start).c_str());
+        start = end + 1;
+      }
+    });
+  }
+
+  void on(const char* prefix, Handler handler) {
+    Rule r = { prefix, handler };
+    rules.push_back(r);
+  }
+
+  // Sends "<text>" as an unsolicited line, delay_ms from now
+  void urc(const char* text, uint32_t delay_ms = 0) {
+    Pending p = { nowUs() + (uint64_t)delay_ms * 1000, nl + text + nl };
+    if (family == XBEE) {
+      p.data = std::string(text) + nl;
+    }
+    if (mux_on) {
+      p.data = muxFrames(1, p.data);
+    }
+    std::deque<Pending>::iterator it = urcs.begin();
+    while (it != urcs.end() && it->due <= p.due) ++it;
+    urcs.insert(it, p);
+  }
+
+  /*
+   * Timing
+   */
+
+  // 10 bits per byte on the wire, 0 for no limit
+  void setBaud(unsigned long baud) {
+    byte_us = baud ? 10000000.0 / baud : 0;
+  }
+
+  // RTS from the host; while it is de-asserted nothing more arrives, as if
+  // the modem honoured CTS.  Like a modem that checks CTS between the
+  // packets it sends, a response or data push already under way is finished
+  // first.  Hook up with
+  //   #define TINY_GSM_RTS(ready) sim.setRts(ready)
+  void setRts(bool ready) {
+    uint64_t now = nowUs();
+    if (!ready && !rts_held) {
+      rts_held = true;
+      held_at = now;
+      for (size_t i = 0; i < out.size() && out[i].start <= now; i++) {
+        // Rounded up, so the last byte counts as arrived by then
+        uint64_t end = out[i].start + (uint64_t)(out[i].data.size() * byte_us) + 1;
+        if (end > held_at) held_at = end;
+      }
+    } else if (ready && rts_held) {
+      rts_held = false;
+      uint64_t shift = (now > held_at) ? now - held_at : 0;
+      for (size_t i = 0; i < out.size(); i++) {
+        if (out[i].start >= held_at) out[i].start += shift;
+      }
+    }
+  }
+
+  // Bytes the host's UART buffer holds, like the core's 64 on AVR; what
+  // arrives while it is full is lost.  0 for no limit
+  void setRxBuffer(size_t bytes) { rx_limit = bytes; }
+  size_t dropped() const { return n_dropped; }
+
+  // Time a socket takes to connect, reported with the modem's connect URC
+  void setConnectTime(uint32_t ms) { connect_ms = ms; }
+
+  // Time from the end of a command to the start of its response
+  void setLatency(uint32_t ms) {
+    latency_us = (uint64_t)ms * 1000;
+  }
+
+  // Drops everything not yet read, e.g. what is left after a failed run
+  void purge() {
+    out.clear();
+    urcs.clear();
+  }
+
+  /*
+   * Socket payloads
+   */
+
+  bool loadPayload(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+      return false;
+    }
+    payload.clear();
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      payload.append(buf, n);
+    }
+    fclose(f);
+    return true;
+  }
+
+  void setPayload(const uint8_t* data, size_t len) {
+    if (data && len) {
+      payload.assign((const char*)data, len);
+    } else {
+      payload.clear();
+    }
+  }
+
+  // Sends data written to a socket back on it
+  void setEcho(bool enable) { echo = enable; }
+
+  // Closes a socket from the far end once its payload has been read
+  void setCloseAfterPayload(bool enable) { close_after_payload = enable; }
+
+  // For sketches that call SerialAT.begin()
+  void begin(unsigned long baud) { setBaud(baud); }
+
+  /*
+   * Trace replay
+   */
+
+  // Plays back a TinyGsmTrace instead of the script: each stretch of modem
+  // output is sent once the host has written what came before it in the
+  // trace, after the recorded delay.  Returns false if it is not a trace.
+  bool loadTrace(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+      return false;
+    }
+    std::string raw;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      raw.append(buf, n);
+    }
+    fclose(f);
+    if (raw.compare(0, 4, "TGT1") != 0) {
+      return false;
+    }
+    trace.clear();
+    size_t pos = 4;
+    while (pos < raw.size()) {
+      TraceRecord r;
+      uint8_t head = raw[pos++];
+      r.in = head & 0x80;
+      r.delta_ms = 0;
+      for (int shift = 0; pos < raw.size(); shift += 7) {
+        uint8_t b = raw[pos++];
+        r.delta_ms |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+      }
+      r.data = raw.substr(pos, (head & 0x7F) + 1);
+      pos += r.data.size();
+      trace.push_back(r);
+    }
+    replaying = true;
+    trace_idx = trace_pos = 0;
+    trace_base = nowUs();
+    host_bytes = 0;
+    mismatch = -1;
+    replayPump();
+    return true;
+  }
+
+  // Every record has been played and read
+  bool replayDone() const {
+    return replaying && trace_idx >= trace.size() && out.empty();
+  }
+
+  // Nothing is on its way to the host, so the trace waits for it to write
+  bool replayIdle() const {
+    return replaying && out.empty();
+  }
+
+  // Offset in the host's output of the first byte that differs from the
+  // trace, or -1
+  long replayMismatch() const { return mismatch; }
+
+  size_t replayPosition() const { return trace_idx; }
+  size_t replayRecords() const { return trace.size(); }
+
+  /*
+   * 27.010 multiplexer
+   */
+
+  // Each DLC gets the same command parser; replies go back on the DLC that
+  // asked and URCs on DLCI 1.  N1 is 127 (as on SIMCom and Quectel) unless
+  // AT+CMUX sets it, longer information fields are split.
+  bool     muxActive() const    { return mux_on; }
+  uint16_t muxFrameSize() const { return mux_n1; }
+  size_t   muxBadFrames() const { return mux_bad; }
+
+  // Sends a control channel message to the host, e.g. a PN command
+  void muxControl(const std::string& msg) {
+    reply_at = nowUs() + latency_us;
+    schedule(muxFrame(0, TINY_GSM_SIM_UIH, msg), reply_at);
+  }
+
+  // Control channel messages the host sent, oldest first
+  std::vector<std::string>& muxReceived() { return mux_control; }
+
+  /*
+   * Counters
+   */
+
+  uint32_t commands() const   { return n_commands; }
+  size_t   uploaded() const   { return n_uploaded; }
+  size_t   downloaded() const { return n_downloaded; }
+  void resetCounters() {
+    n_commands = 0;
+    n_uploaded = n_downloaded = 0;
+  }
+
+  /*
+   * For handlers
+   */
+
+  // A framed response line
+  void reply(const char* line) {
+    if (chained) {
+      // A line of ';'-joined commands ends with a single result
+      if (!strcmp(line, "OK")) return;
+      if (!strcmp(line, "ERROR")) chain_error = true;
+    }
+    emit((family == XBEE) ? std::string(line) + nl : nl + line + nl);
+  }
+  void reply(const String& line) { reply(line.c_str()); }
+  void ok()    { reply("OK"); }
+  void error() { reply("ERROR"); }
+
+  // Bytes exactly as given
+  void replyRaw(const std::string& bytes) { emit(bytes); }
+
+  // Adds to the latency of the response being built
+  void delayReply(uint32_t ms) { reply_at += (uint64_t)ms * 1000; }
+
+  // Reports a connect after setConnectTime(), with the socket's data URC
+  // when there is something to read
+  void connected(const char* line, const char* data_urc, int mux) {
+    if (!connect_ms) {
+      reply(line);
+      if (socketAvailable(mux)) reply(data_urc);
+      return;
+    }
+    urc(line, connect_ms);
+    if (socketAvailable(mux)) urc(data_urc, connect_ms);
+  }
+
+  // The next len bytes from the host are data, not commands
+  void expectData(size_t len, DataHandler done) {
+    data_left = len;
+    data_buf.clear();
+    data_done = done;
+    if (!len) {
+      done(*this, data_buf);
+    }
+  }
+
+  // Hands every byte from the host to handler instead of the command parser,
+  // e.g. a PPP peer after ATD*99#; an empty handler goes back to commands
+  void setByteHandler(ByteHandler handler) { byte_handler = handler; }
+
+  Socket& socket(int mux) {
+    return sockets[(unsigned)mux % TINY_GSM_SIM_SOCKETS];
+  }
+
+  void socketOpen(int mux) {
+    Socket& s = socket(mux);
+    s.open = true;
+    s.rx = payload;
+    s.rx_pos = 0;
+    s.sent = 0;
+  }
+
+  size_t socketAvailable(int mux) {
+    Socket& s = socket(mux);
+    return TinyGsmSimMin(s.rx.size() - s.rx_pos, (size_t)TINY_GSM_SIM_MODEM_BUFFER);
+  }
+
+  std::string socketRead(int mux, size_t max_len) {
+    Socket& s = socket(mux);
+    std::string out = s.rx.substr(s.rx_pos, max_len);
+    s.rx_pos += out.size();
+    n_downloaded += out.size();
+    return out;
+  }
+
+  void socketWrite(int mux, const std::string& data) {
+    Socket& s = socket(mux);
+    s.sent += data.size();
+    n_uploaded += data.size();
+    if (echo) {
+      s.rx += data;
+    }
+  }
+
+  // True once the far end has nothing more to say and hangs up
+  bool socketDrained(int mux) {
+    Socket& s = socket(mux);
+    return s.open && close_after_payload && !echo && s.rx_pos >= s.rx.size();
+  }
+
+  /*
+   * Stream
+   */
+
+  int available() {
+    uint64_t now = nowUs();
+    if (rts_held && now > held_at) now = held_at;
+    while (!urcs.empty() && urcs.front().due <= now) {
+      uint64_t at = urcs.front().due;
+      schedule(urcs.front().data, at);
+      urcs.pop_front();
+    }
+    size_t ready = 0;
+    for (size_t i = 0; i < out.size(); i++) {
+      Chunk& c = out[i];
+      if (now < c.start) break;
+      size_t arrived = byte_us ? (size_t)((now - c.start) / byte_us) : c.data.size();
+      arrived = TinyGsmSimMin(arrived, c.data.size());
+      size_t got = (arrived > c.pos) ? arrived - c.pos : 0;
+      if (rx_limit && ready + got > rx_limit) {
+        // The UART buffer was full when these came in
+        size_t keep = c.pos + (rx_limit - ready);
+        n_dropped += arrived - keep;
+        if (arrived < c.data.size()) {
+          Chunk rest = { c.data.substr(arrived), 0,
+                         c.start + (uint64_t)(arrived * byte_us) };
+          out.insert(out.begin() + i + 1, rest);
+        }
+        out[i].data.resize(keep);
+        if (out[i].pos >= keep) {
+          out.erase(out.begin() + i);
+          i--;
+        }
+        ready = rx_limit;
+        continue;
+      }
+      ready += got;
+      if (arrived < c.data.size()) break;
+    }
+    return (int)TinyGsmSimMin(ready, (size_t)0x7FFFFFFF);
+  }
+
+  int read() {
+    if (!available()) {
+      return -1;
+    }
+    Chunk& c = out.front();
+    uint8_t b = c.data[c.pos++];
+    if (c.pos >= c.data.size()) {
+      out.pop_front();
+    }
+    return b;
+  }
+
+  int peek() {
+    if (!available()) {
+      return -1;
+    }
+    return (uint8_t)out.front().data[out.front().pos];
+  }
+
+  size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    uint64_t now = nowUs();
+    uint64_t start = (tx_done > now) ? tx_done : now;
+    for (size_t i = 0; i < size; i++) {
+      feed(buf[i], start + (uint64_t)((i + 1) * byte_us));
+    }
+    tx_done = start + (uint64_t)(size * byte_us);
+    // Block like a full transmit fifo would
+    uint64_t ahead = (uint64_t)(TINY_GSM_SIM_TX_FIFO * byte_us);
+    if (tx_done > now + ahead) {
+      sleepUntil(tx_done - ahead);
+    }
+    return size;
+  }
+  using Print::write;
+
+  void flush() {
+    sleepUntil(tx_done);
+  }
+
+protected:
+  struct Rule {
+    std::string prefix;
+    Handler     handler;
+  };
+
+  struct Chunk {
+    std::string data;
+    size_t      pos;
+    uint64_t    start;
+  };
+
+  struct Pending {
+    uint64_t    due;
+    std::string data;
+  };
+
+  template<typename T>
+  static T TinyGsmSimMin(T a, T b) { return (a < b) ? a : b; }
+
+  static uint64_t nowUs() { return hostMicros64(); }
+
+  static void sleepUntil(uint64_t t) {
+    uint64_t now = nowUs();
+    if (t > now) {
+      usleep(t - now);
+    }
+  }
+
+  void emit(const std::string& bytes) {
+    schedule(mux_on ? muxFrames(mux_dlci, bytes) : bytes, reply_at);
+  }
+
+  void schedule(const std::string& bytes, uint64_t at) {
+    if (bytes.empty()) return;
+    uint64_t start = at;
+    if (!out.empty()) {
+      const Chunk& last = out.back();
+      uint64_t last_end = last.start + (uint64_t)(last.data.size() * byte_us);
+      if (last_end > start) start = last_end;
+    }
+    Chunk c = { bytes, 0, start };
+    out.push_back(c);
+  }
+
+  struct TraceRecord {
+    bool        in;
+    uint32_t    delta_ms;
+    std::string data;
+  };
+
+  // Schedules the modem's records up to the next one the host has to write
+  void replayPump() {
+    while (trace_idx < trace.size() && trace[trace_idx].in) {
+      trace_base += (uint64_t)trace[trace_idx].delta_ms * 1000;
+      schedule(trace[trace_idx].data, trace_base);
+      trace_idx++;
+    }
+  }
+
+  void replayFeed(uint8_t c, uint64_t at) {
+    host_bytes++;
+    if (trace_idx >= trace.size()) {
+      if (mismatch < 0) mismatch = host_bytes - 1;
+      return;
+    }
+    const TraceRecord& r = trace[trace_idx];
+    if (trace_pos == 0) {
+      // Later delays count from when the host started this record
+      trace_base = at;
+    }
+    if ((uint8_t)r.data[trace_pos] != c && mismatch < 0) {
+      mismatch = host_bytes - 1;
+    }
+    if (++trace_pos >= r.data.size()) {
+      trace_pos = 0;
+      trace_idx++;
+      replayPump();
+    }
+  }
+
+  void feed(uint8_t c, uint64_t at) {
+    if (replaying) {
+      replayFeed(c, at);
+      return;
+    }
+    if (byte_handler) {
+      reply_at = at + latency_us;
+      ByteHandler handler = byte_handler;
+      handler(*this, c);
+      return;
+    }
+    if (mux_on) {
+      muxFeed(c, at);
+      return;
+    }
+    feedLine(c, at);
+  }
+
+  void feedLine(uint8_t c, uint64_t at) {
+    // The "\n" of the "\r\n" that ended a command is not data
+    bool after_cr = last_cr;
+    last_cr = (c == '\r');
+    if (data_left && !(c == '\n' && after_cr && data_buf.empty())) {
+      data_buf += (char)c;
+      if (--data_left == 0) {
+        reply_at = at + latency_us;
+        DataHandler done = data_done;
+        done(*this, data_buf);
+      }
+      return;
+    }
+    if (data_mode) {
+      // XBee transparent mode, "+++" drops back to commands
+      if (c == '+' && ++pluses == 3) {
+        pluses = 0;
+        data_mode = false;
+        reply_at = at + latency_us;
+        ok();
+      } else if (c != '+') {
+        std::string data(pluses, '+');
+        data += (char)c;
+        pluses = 0;
+        socketWrite(0, data);
+      }
+      return;
+    }
+    if (c == '\r') {
+      std::string cmd;
+      cmd.swap(line);
+      reply_at = at + latency_us;
+      command(cmd);
+    } else if (c != '\n') {
+      line += (char)c;
+      if (family == XBEE && line == "+++") {
+        line.clear();
+        reply_at = at + latency_us;
+        ok();
+      }
+    }
+  }
+
+  void command(const std::string& text) {
+    size_t b = 0;
+    while (b < text.size() && isspace((unsigned char)text[b])) b++;
+    std::string cmd = text.substr(b);
+    if (cmd.empty()) {
+      return;
+    }
+    n_commands++;
+    if (cmd.size() >= 2 && toupper(cmd[0]) == 'A' && toupper(cmd[1]) == 'T') {
+      cmd = cmd.substr(2);
+    }
+    // "AT+CSQ;+CREG?" runs each command in turn, up to the first error
+    size_t semi = splitAt(cmd, 0);
+    if (family != XBEE && toupper(cmd[0]) != 'D' && semi < cmd.size()) {
+      chained = true;
+      chain_error = false;
+      for (size_t start = 0; start <= cmd.size() && !chain_error; start = semi + 1) {
+        semi = splitAt(cmd, start);
+        run(cmd.substr(start, semi - start));
+      }
+      chained = false;
+      if (!chain_error) ok();
+      return;
+    }
+    run(cmd);
+  }
+
+  /*
+   * 27.010 basic option
+   */
+
+  static uint8_t muxCrc(const std::string& bytes) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < bytes.size(); i++) {
+      crc ^= (uint8_t)bytes[i];
+      for (uint8_t b = 0; b < 8; b++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xE0 : (crc >> 1);
+      }
+    }
+    return 0xFF - crc;
+  }
+
+  // One frame from the modem; as the responder its address C/R bit is 0
+  std::string muxFrame(uint8_t dlci, uint8_t control, const std::string& data) {
+    std::string head;
+    head += (char)((dlci << 2) | 0x01);
+    head += (char)control;
+    if (data.size() > 127) {
+      head += (char)((data.size() << 1) & 0xFE);
+      head += (char)(data.size() >> 7);
+    } else {
+      head += (char)((data.size() << 1) | 0x01);
+    }
+    return std::string(1, (char)TINY_GSM_SIM_FLAG) + head + data +
+           (char)muxCrc(head) + (char)TINY_GSM_SIM_FLAG;
+  }
+
+  std::string muxFrames(uint8_t dlci, const std::string& data) {
+    std::string frames;
+    for (size_t pos = 0; pos < data.size(); pos += mux_n1) {
+      frames += muxFrame(dlci, TINY_GSM_SIM_UIH, data.substr(pos, mux_n1));
+    }
+    return frames;
+  }
+
+  // Collects a frame by its length field, basic option has no escaping
+  void muxFeed(uint8_t c, uint64_t at) {
+    if (mux_buf.empty() && c == TINY_GSM_SIM_FLAG) {
+      mux_synced = true;
+      return;
+    }
+    if (!mux_synced) {
+      return;  // e.g. the "\n" after AT+CMUX
+    }
+    mux_buf += (char)c;
+    if (mux_buf.size() < 3) return;
+    size_t head = ((uint8_t)mux_buf[2] & 0x01) ? 3 : 4;
+    if (mux_buf.size() < head) return;
+    size_t len = (uint8_t)mux_buf[2] >> 1;
+    if (head == 4) len |= (size_t)(uint8_t)mux_buf[3] << 7;
+    if (mux_buf.size() < head + len + 1) return;
+    std::string frame;
+    frame.swap(mux_buf);
+    if ((uint8_t)frame[head + len] != muxCrc(frame.substr(0, head))) {
+      mux_bad++;
+      return;
+    }
+    muxFrameIn((uint8_t)frame[0] >> 2, (uint8_t)frame[1] & ~0x10,
+               frame.substr(head, len), at);
+  }
+
+  void muxFrameIn(uint8_t dlci, uint8_t control, const std::string& data, uint64_t at) {
+    reply_at = at + latency_us;
+    if (control == TINY_GSM_SIM_SABM || control == TINY_GSM_SIM_DISC) {
+      schedule(muxFrame(dlci, TINY_GSM_SIM_UA | 0x10, ""), reply_at);
+      return;
+    }
+    if (control != TINY_GSM_SIM_UIH) {
+      return;
+    }
+    if (dlci > 0) {
+      mux_dlci = dlci;
+      for (size_t i = 0; i < data.size(); i++) {
+        feedLine(data[i], at);
+      }
+      return;
+    }
+    mux_control.push_back(data);
+    if (data.size() < 2 || !(data[0] & 0x02)) {
+      return;  // A response to one of ours
+    }
+    uint8_t type = data[0] & ~0x02;
+    std::string answer = data;
+    answer[0] = (char)type;
+    if (type == 0xC1) {         // CLD, back to AT commands after the answer
+      schedule(muxFrame(0, TINY_GSM_SIM_UIH, answer), reply_at);
+      mux_on = false;
+      return;
+    }
+    if (type != 0xE1 && type != 0x21) {  // Anything but MSC and TEST gets NSC
+      answer = std::string("\x11\x03") + data[0];
+    }
+    schedule(muxFrame(0, TINY_GSM_SIM_UIH, answer), reply_at);
+  }
+
+  // Position of the next ';' outside quotes, or the end
+  static size_t splitAt(const std::string& cmd, size_t start) {
+    bool quoted = false;
+    for (size_t i = start; i < cmd.size(); i++) {
+      if (cmd[i] == '"') quoted = !quoted;
+      else if (cmd[i] == ';' && !quoted) return i;
+    }
+    return cmd.size();
+  }
+
+  void run(const std::string& cmd) {
+    for (size_t i = rules.size(); i-- > 0; ) {
+      const std::string& p = rules[i].prefix;
+      if (cmd.compare(0, p.size(), p) == 0) {
+        rules[i].handler(*this, String(cmd.substr(p.size())));
+        return;
+      }
+    }
+    ok();
+  }
+
+  static int argInt(const String& args, int index) {
+    int pos = 0;
+    for (int i = 0; i < index; i++) {
+      pos = args.indexOf(',', pos);
+      if (pos < 0) return 0;
+      pos++;
+    }
+    while (pos < (int)args.length() && args[pos] == '"') pos++;
+    return atoi(args.c_str() + pos);
+  }
+
+  /*
+   * Family scripts
+   */
+
+  void setupCommon() {
+    on("",       "OK");
+    on("+CPIN?", "+CPIN: READY\nOK");
+    on("+CSQ",   "+CSQ: 20,99\nOK");
+    on("+CREG?", "+CREG: 0,1\nOK");
+    on("+CGREG?", "+CGREG: 0,1\nOK");
+    on("+CEREG?", "+CEREG: 0,1\nOK");
+    on("+CGATT?", "+CGATT: 1\nOK");
+    on("+GSN",   "861234567890123\nOK");
+    on("+CGSN",  "861234567890123\nOK");
+    on("+COPS?", "+COPS: 0,0,\"TinyGSM Sim\",7\nOK");
+    on("I", [](ModemSim& sim, const String& args) {  // ATI only
+      if (args.length() == 0) {
+        sim.reply("TinyGSM Sim");
+        sim.reply("Revision: 1.0");
+      }
+      sim.ok();
+    });
+    on("+CCID",  "+CCID: 8944500102198304826\nOK");
+    on("+QCCID", "+QCCID: 8944500102198304826\nOK");
+    on("+SQNCCID", "+SQNCCID: \"8944500102198304826\",\"\"\nOK");
+    on("+CMUX=", [](ModemSim& sim, const String& args) {
+      int n1 = argInt(args, 3);
+      sim.ok();
+      sim.mux_on = true;
+      sim.mux_synced = false;
+      sim.mux_buf.clear();
+      sim.mux_n1 = (n1 > 0) ? n1 : 127;
+    });
+  }
+
+  void setupSimcom() {
+    on("+GMM", "SIMCOM_SIM800\nOK");
+    on("+CBC", "+CBC: 0,80,3900\nOK");
+    on("+CIFSR", "10.0.0.2\nOK");
+    on("+CIPSTART=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.ok();
+      sim.socketOpen(mux);
+      sim.connected((String(mux) + ", CONNECT OK").c_str(),
+                    (String("+CIPRXGET: 1,") + mux).c_str(), mux);
+    });
+    on("+CIPSEND=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      size_t len = argInt(args, 1);
+      sim.replyRaw(sim.nl + ">");
+      sim.expectData(len, [mux](ModemSim& sim, const std::string& data) {
+        sim.socketWrite(mux, data);
+        sim.reply((String("DATA ACCEPT:") + mux + "," + (int)data.size()).c_str());
+      });
+    });
+    on("+CIPRXGET=4,", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.reply((String("+CIPRXGET: 4,") + mux + "," + (int)sim.socketAvailable(mux)).c_str());
+      sim.ok();
+    });
+    on("+CIPRXGET=2,", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      std::string data = sim.socketRead(mux, TinyGsmSimMin(argInt(args, 1), 1460));
+      String head = String("+CIPRXGET: 2,") + mux + "," + (int)data.size() + "," +
+                    (int)sim.socketAvailable(mux);
+      sim.replyRaw(sim.nl + head.c_str() + sim.nl + data);
+      sim.ok();
+      if (sim.socketDrained(mux)) {
+        sim.socket(mux).open = false;
+        sim.reply((String(mux) + ", CLOSED").c_str());
+      }
+    });
+    on("+CIPSTATUS=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.reply((String("+CIPSTATUS: ") + mux + ",0,\"TCP\",\"10.0.0.1\",\"80\",\"" +
+                 (sim.socket(mux).open ? "CONNECTED" : "CLOSED") + "\"").c_str());
+      sim.ok();
+    });
+    on("+CIPCLOSE=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.socket(mux).open = false;
+      sim.reply((String(mux) + ", CLOSE OK").c_str());
+    });
+  }
+
+  void setupQuectel() {
+    on("+GMM", "BG96\nOK");
+    on("+CBC", "+CBC: 0,80,3900\nOK");
+    on("+QIACT?", "+QIACT: 1,1,1,\"10.0.0.2\"\nOK");
+    on("+CGPADDR", "+CGPADDR: 1,\"10.0.0.2\"\nOK");
+    on("+QIOPEN=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 1);
+      sim.ok();
+      sim.socketOpen(mux);
+      sim.connected((String("+QIOPEN: ") + mux + ",0").c_str(),
+                    (String("+QIURC: \"recv\",") + mux).c_str(), mux);
+    });
+    on("+QISEND=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      size_t len = argInt(args, 1);
+      sim.replyRaw(sim.nl + ">");
+      sim.expectData(len, [mux](ModemSim& sim, const std::string& data) {
+        sim.socketWrite(mux, data);
+        sim.reply("SEND OK");
+      });
+    });
+    on("+QIRD=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      int size = argInt(args, 1);
+      Socket& s = sim.socket(mux);
+      if (size == 0) {
+        sim.reply((String("+QIRD: ") + (int)(s.rx_pos + sim.socketAvailable(mux)) + "," +
+                   (int)s.rx_pos + "," +
+                   (int)sim.socketAvailable(mux)).c_str());
+        sim.ok();
+        return;
+      }
+      std::string data = sim.socketRead(mux, TinyGsmSimMin(size, 1500));
+      sim.replyRaw(sim.nl + "+QIRD: " + String((int)data.size()).c_str() + sim.nl + data);
+      sim.ok();
+      if (sim.socketDrained(mux)) {
+        s.open = false;
+        sim.reply((String("+QIURC: \"closed\",") + mux).c_str());
+      }
+    });
+    on("+QISTATE=1,", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.reply((String("+QISTATE: ") + mux + ",\"TCP\",\"10.0.0.1\",80,5000," +
+                 (sim.socket(mux).open ? 2 : 4) + ",1," + mux + ",0,\"uart1\"").c_str());
+      sim.ok();
+    });
+    on("+QICLOSE=", [](ModemSim& sim, const String& args) {
+      sim.socket(argInt(args, 0)).open = false;
+      sim.ok();
+    });
+  }
+
+  void setupUblox() {
+    on("+CGMM", "SARA-U201\nOK");
+    on("+UPSND=0,0", "+UPSND: 0,0,\"10.0.0.2\"\nOK");
+    on("+UPSND=0,8", "+UPSND: 0,8,1\nOK");
+    on("+USOCR=", [](ModemSim& sim, const String&) {
+      int mux = 0;
+      while (mux < TINY_GSM_SIM_SOCKETS - 1 && sim.socket(mux).open) mux++;
+      sim.socket(mux).open = true;
+      sim.reply((String("+USOCR: ") + mux).c_str());
+      sim.ok();
+    });
+    on("+USOCO=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.socketOpen(mux);
+      String data = String("+UUSORD: ") + mux + "," + (int)sim.socketAvailable(mux);
+      if (argInt(args, 3) == 1) {
+        // Asynchronous: OK now, +UUSOCO once connected
+        sim.ok();
+        sim.connected((String("+UUSOCO: ") + mux + ",0").c_str(), data.c_str(), mux);
+      } else {
+        sim.delayReply(sim.connect_ms);
+        sim.ok();
+        if (sim.socketAvailable(mux)) {
+          sim.reply(data);
+        }
+      }
+    });
+    on("+USOWR=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      size_t len = argInt(args, 1);
+      sim.replyRaw(sim.nl + "@");
+      sim.expectData(len, [mux](ModemSim& sim, const std::string& data) {
+        sim.socketWrite(mux, data);
+        sim.reply((String("+USOWR: ") + mux + "," + (int)data.size()).c_str());
+        sim.ok();
+      });
+    });
+    on("+USORD=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      int size = argInt(args, 1);
+      if (!sim.socket(mux).open) {
+        sim.reply("+CME ERROR: Operation not allowed");
+        return;
+      }
+      if (size == 0) {
+        sim.reply((String("+USORD: ") + mux + "," + (int)sim.socketAvailable(mux)).c_str());
+        sim.ok();
+        return;
+      }
+      std::string data = sim.socketRead(mux, TinyGsmSimMin(size, 1024));
+      String head = String("+USORD: ") + mux + "," + (int)data.size() + ",\"";
+      sim.replyRaw(sim.nl + head.c_str() + data + "\"" + sim.nl);
+      sim.ok();
+      if (sim.socketDrained(mux)) {
+        sim.socket(mux).open = false;
+        sim.reply((String("+UUSOCL: ") + mux).c_str());
+      }
+    });
+    on("+USOCTL=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.reply((String("+USOCTL: ") + mux + ",10," + (sim.socket(mux).open ? 4 : 0)).c_str());
+      sim.ok();
+    });
+    on("+USOCL=", [](ModemSim& sim, const String& args) {
+      sim.socket(argInt(args, 0)).open = false;
+      sim.ok();
+    });
+  }
+
+  void setupSequans() {
+    on("+CGMM", "VZM20Q\nOK");
+    on("+CGPADDR", "+CGPADDR: 3,\"10.0.0.2\"\nOK");
+    on("+SQNSD=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.socketOpen(mux);
+      sim.ok();
+      if (sim.socketAvailable(mux)) {
+        sim.reply((String("+SQNSRING: ") + mux + "," + (int)sim.socketAvailable(mux)).c_str());
+      }
+    });
+    on("+SQNSS", [](ModemSim& sim, const String&) {
+      // Always all six; 0 = closed, 2 = suspended, 3 = suspended with data
+      for (int mux = 1; mux <= 6; mux++) {
+        int state = 0;
+        if (sim.socket(mux).open) {
+          state = sim.socketAvailable(mux) ? 3 : 2;
+        }
+        sim.reply((String("+SQNSS: ") + mux + "," + state).c_str());
+      }
+      sim.ok();
+    });
+    on("+SQNSSENDEXT=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      size_t len = argInt(args, 1);
+      sim.replyRaw(sim.nl + "> ");
+      sim.expectData(len, [mux](ModemSim& sim, const std::string& data) {
+        sim.socketWrite(mux, data);
+        sim.ok();
+      });
+    });
+    on("+SQNSI=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      Socket& s = sim.socket(mux);
+      sim.reply((String("+SQNSI: ") + mux + "," + (int)s.sent + "," + (int)s.rx_pos + "," +
+                 (int)sim.socketAvailable(mux) + ",0").c_str());
+      sim.ok();
+    });
+    on("+SQNSRECV=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      std::string data = sim.socketRead(mux, TinyGsmSimMin(argInt(args, 1), 1500));
+      String head = String("+SQNSRECV: ") + mux + "," + (int)data.size();
+      sim.replyRaw(sim.nl + head.c_str() + sim.nl + data);
+      sim.ok();
+      if (sim.socketDrained(mux)) {
+        sim.socket(mux).open = false;
+        sim.reply((String("+SQNSH: ") + mux).c_str());
+      }
+    });
+    on("+SQNSH=", [](ModemSim& sim, const String& args) {
+      sim.socket(argInt(args, 0)).open = false;
+      sim.ok();
+    });
+  }
+
+  void setupEspressif() {
+    on("+CIPSTATUS", "STATUS:3\nOK");
+    on("+CIFSR", "+CIFSR:STAIP,\"10.0.0.2\"\nOK");
+    on("+CWJAP_CUR?", "+CWJAP_CUR:\"TinyGSM\",\"00:00:00:00:00:00\",1,-50\nOK");
+    on("+CWJAP_CUR=", "WIFI CONNECTED\nWIFI GOT IP\nOK");
+    on("+CIPSTART=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.socketOpen(mux);
+      sim.reply((String(mux) + ",CONNECT").c_str());
+      sim.ok();
+    });
+    on("+CIPSEND=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      size_t len = argInt(args, 1);
+      sim.ok();
+      sim.replyRaw(">");
+      sim.expectData(len, [mux](ModemSim& sim, const std::string& data) {
+        sim.socketWrite(mux, data);
+        sim.reply((String("Recv ") + (int)data.size() + " bytes").c_str());
+        sim.reply("SEND OK");
+        // The far end answers what the host sent, and the ESP pushes the
+        // answer as it comes in.  Not before: while the driver waits for a
+        // reply it keeps RTS open, and a push would overrun its fifo.
+        while (sim.socketAvailable(mux)) {
+          std::string answer = sim.socketRead(mux, 1460);
+          String head = String("+IPD,") + mux + "," + (int)answer.size() + ":";
+          sim.replyRaw(sim.nl + head.c_str() + answer);
+        }
+        if (sim.socketDrained(mux)) {
+          sim.socket(mux).open = false;
+          sim.reply((String(mux) + ",CLOSED").c_str());
+        }
+      });
+    });
+    on("+CIPCLOSE=", [](ModemSim& sim, const String& args) {
+      int mux = argInt(args, 0);
+      sim.socket(mux).open = false;
+      sim.reply((String(mux) + ",CLOSED").c_str());
+      sim.ok();
+    });
+  }
+
+  void setupXBee() {
+    on("HS", "B08");   // XBee3 Cellular LTE-M
+    on("AI", "0");     // Registered
+    on("CI", "0");     // Socket open
+    on("MY", "10.0.0.2");
+    on("IM", "861234567890123");
+    on("LA", "10.0.0.1");
+    on("DE", [](ModemSim& sim, const String&) {
+      sim.socketOpen(0);
+      sim.ok();
+    });
+    on("CN", [](ModemSim& sim, const String&) {
+      sim.ok();
+      sim.data_mode = true;
+      // The socket's data flows as soon as command mode is left
+      while (sim.socket(0).open && sim.socketAvailable(0)) {
+        sim.replyRaw(sim.socketRead(0, sim.socketAvailable(0)));
+      }
+    });
+  }
+
+  Family                  family;
+  std::string             nl;
+  double                  byte_us;
+  uint64_t                latency_us;
+  uint64_t                tx_done;
+  uint64_t                reply_at;
+  bool                    rts_held;
+  uint64_t                held_at;
+  size_t                  rx_limit;
+  size_t                  n_dropped;
+  uint32_t                connect_ms;
+
+  std::vector<Rule>       rules;
+  std::string             line;
+  size_t                  data_left;
+  std::string             data_buf;
+  DataHandler             data_done;
+  ByteHandler             byte_handler;
+  bool                    data_mode;
+  uint8_t                 pluses;
+  bool                    last_cr;
+  bool                    chained;
+  bool                    chain_error;
+
+  bool                    mux_on;
+  bool                    mux_synced;
+  uint16_t                mux_n1;
+  uint8_t                 mux_dlci;
+  size_t                  mux_bad;
+  std::string             mux_buf;
+  std::vector<std::string> mux_control;
+
+  std::deque<Chunk>       out;
+  std::deque<Pending>     urcs;
+
+  std::string             payload;
+  Socket                  sockets[TINY_GSM_SIM_SOCKETS];
+  bool                    echo;
+  bool                    close_after_payload;
+
+  uint32_t                n_commands;
+  size_t                  n_uploaded;
+  size_t                  n_downloaded;
+
+  bool                    replaying;
+  std::vector<TraceRecord> trace;
+  size_t                  trace_idx;
+  size_t                  trace_pos;
+  uint64_t                trace_base;
+  long                    host_bytes;
+  long                    mismatch;
+};
+
+#endif
@@ -0,0 +1,20 @@
+/**
+ * @file       Replay.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Force-included into a sketch by "make replay", so that an unmodified
+ * sketch talking to Serial1 runs on the host against a recorded trace.
+ */
+
+#ifndef TinyGsmHostReplay_h
+#define TinyGsmHostReplay_h
+
+#include <HostCompat/ModemSim.h>
+
+// Plays back the trace given to tools/host/replay.cpp
+extern ModemSim Serial1;
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * @file       SerialPort.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * A termios serial port as an Arduino Stream, for driving a modem from a
+ * POSIX host.  Works the same on a USB/UART adapter, a Raspberry Pi UART
+ * or one end of a pty.
+ */
+
+#ifndef TinyGsmHostSerialPort_h
+#define TinyGsmHostSerialPort_h
+
+#include <HostCompat/Arduino.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#ifndef TINY_GSM_HOST_SERIAL_BUFFER
+  #define TINY_GSM_HOST_SERIAL_BUFFER 512
+#endif
+
+class SerialPort final : public Stream {
+public:
+  SerialPort() : fd(-1), rx_pos(0), rx_len(0) {}
+  ~SerialPort() { end(); }
+
+  // Opens the device raw, 8N1, optionally with RTS/CTS in the driver
+  bool begin(const char* device, unsigned long baud = 115200, bool rtscts = false) {
+    end();
+    fd = ::open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+      return false;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      tio.c_cflag |= CLOCAL | CREAD;
+      tio.c_cflag &= ~CSTOPB;
+#ifdef CRTSCTS
+      if (rtscts) {
+        tio.c_cflag |= CRTSCTS;
+      } else {
+        tio.c_cflag &= ~CRTSCTS;
+      }
+#endif
+      tio.c_cc[VMIN] = 0;
+      tio.c_cc[VTIME] = 0;
+      speed_t speed = baudToSpeed(baud);
+      cfsetispeed(&tio, speed);
+      cfsetospeed(&tio, speed);
+      tcsetattr(fd, TCSANOW, &tio);  // A pty takes the flags but ignores the rate
+    }
+    tcflush(fd, TCIOFLUSH);
+    return true;
+  }
+
+  // Lets an already open descriptor, e.g. the master side of a pty, be used
+  void begin(int descriptor) {
+    end();
+    fd = descriptor;
+  }
+
+  void end() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+    rx_pos = rx_len = 0;
+  }
+
+  operator bool() { return fd >= 0; }
+
+  int handle() { return fd; }
+
+  // Drives RTS by hand, e.g. #define TINY_GSM_RTS(ready) port.setRts(ready)
+  void setRts(bool asserted) {
+    int bits = TIOCM_RTS;
+    ioctl(fd, asserted ? TIOCMBIS : TIOCMBIC, &bits);
+  }
+
+  int available() {
+    if (rx_pos < rx_len) {
+      return rx_len - rx_pos;
+    }
+    fill();
+    return rx_len - rx_pos;
+  }
+
+  int read() {
+    if (!available()) {
+      return -1;
+    }
+    return rx_buf[rx_pos++];
+  }
+
+  int peek() {
+    if (!available()) {
+      return -1;
+    }
+    return rx_buf[rx_pos];
+  }
+
+  // Takes whatever is buffered, or one read() from the device
+  size_t readAvailable(uint8_t* buf, size_t len) {
+    if (!available()) {
+      return 0;
+    }
+    size_t n = rx_len - rx_pos;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(buf, rx_buf + rx_pos, n);
+    rx_pos += n;
+    return n;
+  }
+
+  size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    size_t sent = 0;
+    while (fd >= 0 && sent < size) {
+      ssize_t n = ::write(fd, buf + sent, size - sent);
+      if (n > 0) {
+        sent += n;
+      } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+        break;
+      } else {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        poll(&pfd, 1, 100);
+      }
+    }
+    return sent;
+  }
+  using Print::write;
+
+  void flush() {
+    if (fd >= 0) {
+      tcdrain(fd);
+    }
+  }
+
+protected:
+  void fill() {
+    rx_pos = rx_len = 0;
+    if (fd < 0) {
+      return;
+    }
+    ssize_t n = ::read(fd, rx_buf, sizeof(rx_buf));
+    if (n > 0) {
+      rx_len = n;
+    }
+  }
+
+  static speed_t baudToSpeed(unsigned long baud) {
+    switch (baud) {
+      case 1200:    return B1200;
+      case 2400:    return B2400;
+      case 4800:    return B4800;
+      case 9600:    return B9600;
+      case 19200:   return B19200;
+      case 38400:   return B38400;
+      case 57600:   return B57600;
+#ifdef B230400
+      case 230400:  return B230400;
+#endif
+#ifdef B460800
+      case 460800:  return B460800;
+#endif
+#ifdef B921600
+      case 921600:  return B921600;
+#endif
+      default:      return B115200;
+    }
+  }
+
+private:
+  int     fd;
+  size_t  rx_pos;
+  size_t  rx_len;
+  uint8_t rx_buf[TINY_GSM_HOST_SERIAL_BUFFER];
+};
+
+// Bulk reads for drivers built on a SerialPort, e.g. TinyGsmSim800T<SerialPort>
+inline size_t TinyGsmReadAvailable(SerialPort& port, uint8_t* buf, size_t len) {
+  return port.readAvailable(buf, len);
+}
+
+#endif
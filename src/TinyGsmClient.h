@@ -11,68 +11,108 @@
 
 #if defined(TINY_GSM_MODEM_SIM800)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_TRANSPARENT
+  #define TINY_GSM_MODEM_HAS_HTTP
   #define TINY_GSM_MODEM_HAS_SSL
+  #define TINY_GSM_MODEM_HAS_FILE_DOWNLOAD
+  #define TINY_GSM_MODEM_HAS_FILES
   #include <TinyGsmClientSIM800.h>
   typedef TinyGsmSim800 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmSim800T<S>;
   typedef TinyGsmSim800::GsmClient TinyGsmClient;
   typedef TinyGsmSim800::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim800::GsmClientTransparent TinyGsmClientTransparent;
+  typedef TinyGsmSim800::GsmHttp TinyGsmHttp;
 
 #elif defined(TINY_GSM_MODEM_SIM808) || defined(TINY_GSM_MODEM_SIM868)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_TRANSPARENT
+  #define TINY_GSM_MODEM_HAS_HTTP
   #define TINY_GSM_MODEM_HAS_SSL
   #define TINY_GSM_MODEM_HAS_GPS
+  #define TINY_GSM_MODEM_HAS_FILE_DOWNLOAD
+  #define TINY_GSM_MODEM_HAS_FILES
   #include <TinyGsmClientSIM808.h>
   typedef TinyGsmSim808 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmSim808T<S>;
   typedef TinyGsmSim808::GsmClient TinyGsmClient;
   typedef TinyGsmSim808::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim808::GsmClientTransparent TinyGsmClientTransparent;
+  typedef TinyGsmSim808::GsmHttp TinyGsmHttp;
 
 #elif defined(TINY_GSM_MODEM_SIM900)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_TRANSPARENT
   #include <TinyGsmClientSIM800.h>
   typedef TinyGsmSim800 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmSim800T<S>;
   typedef TinyGsmSim800::GsmClient TinyGsmClient;
+  typedef TinyGsmSim800::GsmClientTransparent TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_SIM7000)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_TRANSPARENT
+  #define TINY_GSM_MODEM_HAS_HTTP
   #define TINY_GSM_MODEM_HAS_GPS
   #include <TinyGsmClientSIM7000.h>
   typedef TinyGsmSim7000 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmSim7000T<S>;
   typedef TinyGsmSim7000::GsmClient TinyGsmClient;
   typedef TinyGsmSim7000::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim7000::GsmClientTransparent TinyGsmClientTransparent;
+  typedef TinyGsmSim7000::GsmHttp TinyGsmHttp;
 
 #elif defined(TINY_GSM_MODEM_UBLOX)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_TRANSPARENT
   #define TINY_GSM_MODEM_HAS_SSL
+  #define TINY_GSM_MODEM_HAS_FILE_DOWNLOAD
+  #define TINY_GSM_MODEM_HAS_FILES
   #include <TinyGsmClientUBLOX.h>
   typedef TinyGsmUBLOX TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmUBLOXT<S>;
   typedef TinyGsmUBLOX::GsmClient TinyGsmClient;
   typedef TinyGsmUBLOX::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmUBLOX::GsmClientTransparent TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_SARAR4)
   #define TINY_GSM_MODEM_HAS_GPRS
   #define TINY_GSM_MODEM_HAS_SSL
+  #define TINY_GSM_MODEM_HAS_FILE_DOWNLOAD
+  #define TINY_GSM_MODEM_HAS_FILES
   #include <TinyGsmClientSaraR4.h>
   typedef TinyGsmSaraR4 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmSaraR4T<S>;
   typedef TinyGsmSaraR4::GsmClient TinyGsmClient;
   typedef TinyGsmSaraR4::GsmClientSecure TinyGsmClientSecure;
 
 #elif defined(TINY_GSM_MODEM_M95)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_FILES
   #include <TinyGsmClientM95.h>
   typedef TinyGsmM95 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmM95T<S>;
   typedef TinyGsmM95::GsmClient TinyGsmClient;
 
 #elif defined(TINY_GSM_MODEM_BG96)
   #define TINY_GSM_MODEM_HAS_GPRS
+  #define TINY_GSM_MODEM_HAS_TRANSPARENT
+  #define TINY_GSM_MODEM_HAS_HTTP
+  #define TINY_GSM_MODEM_HAS_FILE_DOWNLOAD
+  #define TINY_GSM_MODEM_HAS_FILES
   #include <TinyGsmClientBG96.h>
   typedef TinyGsmBG96 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmBG96T<S>;
   typedef TinyGsmBG96::GsmClient TinyGsmClient;
+  typedef TinyGsmBG96::GsmClientTransparent TinyGsmClientTransparent;
+  typedef TinyGsmBG96::GsmHttp TinyGsmHttp;
 
 #elif defined(TINY_GSM_MODEM_MC20)
   #define TINY_GSM_MODEM_HAS_GPRS
   #define TINY_GSM_MODEM_HAS_SSL
   #include <TinyGsmClientMC20.h>
   typedef TinyGsmMC20 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmMC20T<S>;
   typedef TinyGsmMC20::GsmClient TinyGsmClient;
   typedef TinyGsmMC20::GsmClientSecure TinyGsmClientSecure;
 
@@ -80,19 +120,23 @@
   #define TINY_GSM_MODEM_HAS_GPRS
   #include <TinyGsmClientA6.h>
   typedef TinyGsmA6 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmA6T<S>;
   typedef TinyGsmA6::GsmClient TinyGsmClient;
 
 #elif defined(TINY_GSM_MODEM_M590)
   #define TINY_GSM_MODEM_HAS_GPRS
   #include <TinyGsmClientM590.h>
   typedef TinyGsmM590 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmM590T<S>;
   typedef TinyGsmM590::GsmClient TinyGsmClient;
 
 #elif defined(TINY_GSM_MODEM_MC60) || defined(TINY_GSM_MODEM_MC60E)
   #include <TinyGsmClientMC60.h>
   #define TINY_GSM_MODEM_HAS_GPRS
   #define TINY_GSM_MODEM_HAS_GPS
+  #define TINY_GSM_MODEM_HAS_FILES
   typedef TinyGsmMC60 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmMC60T<S>;
   typedef TinyGsmMC60::GsmClient TinyGsmClient;
 
 #elif defined(TINY_GSM_MODEM_ESP8266)
@@ -100,6 +144,7 @@
   #define TINY_GSM_MODEM_HAS_SSL
   #include <TinyGsmClientESP8266.h>
   typedef TinyGsmESP8266 TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmESP8266T<S>;
   typedef TinyGsmESP8266::GsmClient TinyGsmClient;
   typedef TinyGsmESP8266::GsmClientSecure TinyGsmClientSecure;
 
@@ -109,6 +154,7 @@
   #define TINY_GSM_MODEM_HAS_SSL
   #include <TinyGsmClientXBee.h>
   typedef TinyGsmXBee TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmXBeeT<S>;
   typedef TinyGsmXBee::GsmClient TinyGsmClient;
   typedef TinyGsmXBee::GsmClientSecure TinyGsmClientSecure;
 
@@ -117,6 +163,7 @@
   #define TINY_GSM_MODEM_HAS_SSL
   #include <TinyGsmClientSequansMonarch.h>
   typedef TinyGsmSequansMonarch TinyGsm;
+  template <class S> using TinyGsmT = TinyGsmSequansMonarchT<S>;
   typedef TinyGsmSequansMonarch::GsmClient TinyGsmClient;
   typedef TinyGsmSequansMonarch::GsmClientSecure TinyGsmClientSecure;
 
@@ -125,4 +172,41 @@
   #error "Please define GSM modem model"
 #endif
 
+// The same capabilities as constants, for code that picks a path at compile
+// time.  The HAS_* macros above remain for #if and must agree with them.
+typedef TinyGsm::Traits TinyGsmModemTraits;
+
+#if defined(TINY_GSM_MODEM_HAS_SSL)
+static_assert(TinyGsmModemTraits::has_ssl, "TINY_GSM_MODEM_HAS_SSL without has_ssl");
+#else
+static_assert(!TinyGsmModemTraits::has_ssl, "has_ssl without TINY_GSM_MODEM_HAS_SSL");
+#endif
+
+#if defined(TINY_GSM_MODEM_HAS_GPS)
+static_assert(TinyGsmModemTraits::has_gps, "TINY_GSM_MODEM_HAS_GPS without has_gps");
+#else
+static_assert(!TinyGsmModemTraits::has_gps, "has_gps without TINY_GSM_MODEM_HAS_GPS");
+#endif
+
+// RAM budgets, checked when the sketch compiles.  A compact build holds each
+// client to its receive buffer plus a few words; define either limit to
+// check it in any build.
+#if defined(TINY_GSM_COMPACT) && defined(TINY_GSM_RX_BUFFER) && !defined(TINY_GSM_CLIENT_RAM_MAX)
+  #if defined(TINY_GSM_SOCKET_STATS)
+    #define TINY_GSM_CLIENT_RAM_MAX (TINY_GSM_RX_BUFFER + sizeof(TinyGsmSocketMeter) + 5 * sizeof(void*) + 16)
+  #else
+    #define TINY_GSM_CLIENT_RAM_MAX (TINY_GSM_RX_BUFFER + 5 * sizeof(void*) + 16)
+  #endif
+#endif
+
+#if defined(TINY_GSM_CLIENT_RAM_MAX)
+static_assert(sizeof(TinyGsmClient) <= TINY_GSM_CLIENT_RAM_MAX,
+              "TinyGsmClient is larger than TINY_GSM_CLIENT_RAM_MAX");
+#endif
+
+#if defined(TINY_GSM_MODEM_RAM_MAX)
+static_assert(sizeof(TinyGsm) <= TINY_GSM_MODEM_RAM_MAX,
+              "TinyGsm is larger than TINY_GSM_MODEM_RAM_MAX");
+#endif
+
 #endif
@@ -19,6 +19,7 @@
 #define TINY_GSM_MUX_COUNT 8
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -40,80 +41,84 @@ enum RegStatus {
 };
 
 
-class TinyGsmA6
+template <class StreamT = Stream>
+class TinyGsmA6T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmA6T Modem;
+    static constexpr bool     has_modem_fifo = false;
+    static constexpr bool     reliable_urc   = true;
+    static constexpr uint16_t max_segment    = 1024;
+    static constexpr uint16_t max_read       = 1024;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = false;
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmA6;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmA6T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmA6& modem) {
+  GsmClient(TinyGsmA6T& modem) {
     init(&modem);
   }
 
-  bool init(TinyGsmA6* modem) {
+  bool init(TinyGsmA6T* modem) {
     this->at = modem;
     this->mux = -1;
-    sock_connected = false;
+    this->sock_connected = false;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
+    this->rx.clear();
     uint8_t newMux = -1;
-    sock_connected = at->modemConnect(host, port, &newMux, timeout_s);
-    if (sock_connected) {
-      mux = newMux;
-      at->sockets[mux] = this;
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, &newMux, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    if (this->sock_connected) {
+      this->mux = newMux;
+      this->at->sockets[this->mux] = this;
     }
-    return sock_connected;
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
-    at->sendAT(GF("+CIPCLOSE="), mux);
-    sock_connected = false;
-    at->waitResponse();
-    rx.clear();
+    this->at->sendAT(GF("+CIPCLOSE="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse();
+    this->rx.clear();
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_NO_MODEM_FIFO()
-
-TINY_GSM_CLIENT_READ_NO_MODEM_FIFO()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
-
-private:
-  TinyGsmA6*      at;
-  uint8_t         mux;
-  bool            sock_connected;
-  RxFifo          rx;
 };
 
 
 public:
 
-  TinyGsmA6(Stream& stream)
+  TinyGsmA6T(StreamT& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
@@ -154,12 +159,20 @@ public:
     return "AI-Thinker A6";
   }
 
+TINY_GSM_MODEM_READ_NAME_CONSTANT()
+
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_LISTEN()
 
+TINY_GSM_MODEM_POLL()
+
+TINY_GSM_MODEM_UPDATE_RTS()
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -170,7 +183,7 @@ TINY_GSM_MODEM_MAINTAIN_LISTEN()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-    return false;
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -186,6 +199,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -195,6 +210,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+CPOF"));
     return waitResponse() == 1;
   }
@@ -263,6 +280,10 @@ TINY_GSM_MODEM_GET_REGISTRATION_XREG(CREG)
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CREG, false)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     return (s == REG_OK_HOME || s == REG_OK_ROAMING);
@@ -595,15 +616,20 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    if (r1) {
+      TINY_GSM_RTS(true);  // Let the modem answer even if a fifo is full
+    }
     int index = 0;
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && modemStatusUrc(data)) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -633,6 +659,9 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           if (len_orig > sockets[mux]->available()) { // TODO
             DBG("### Fewer characters received than expected: ", sockets[mux]->available(), " vs ", len_orig);
           }
+          if (!r1) {
+            updateRts();  // Else held open until the reply is in
+          }
           data = "";
         } else if (data.endsWith(GF("+TCPCLOSED:"))) {
           int mux = stream.readStringUntil('\n').toInt();
@@ -645,6 +674,8 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
+    updateRts();
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -671,10 +702,12 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
 };
 
+typedef TinyGsmA6T<Stream> TinyGsmA6;
+
 #endif
@@ -20,6 +20,7 @@
 #define TINY_GSM_MUX_COUNT 12
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -41,88 +42,186 @@ enum RegStatus {
 };
 
 
-class TinyGsmBG96
+template <class StreamT = Stream>
+class TinyGsmBG96T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmBG96T Modem;
+    static constexpr bool     has_modem_fifo = true;
+    static constexpr bool     reliable_urc   = false;
+    static constexpr uint16_t max_segment    = 1460;
+    static constexpr uint16_t max_read       = 1500;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = false;  // TODO: For now
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmBG96;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmBG96T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmBG96& modem, uint8_t mux = 1) {
+  GsmClient(TinyGsmBG96T& modem, uint8_t mux = 1) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmBG96* modem, uint8_t mux = 1) {
+  bool init(TinyGsmBG96T* modem, uint8_t mux = 1) {
     this->at = modem;
     this->mux = mux;
-    sock_available = 0;
-    prev_check = 0;
-    sock_connected = false;
-    got_data = false;
+    this->sock_available = 0;
+    this->prev_check = 0;
+    this->sock_connected = false;
+    this->got_data = false;
 
-    at->sockets[mux] = this;
+    this->at->sockets[this->mux] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, false, timeout_s);
-    return sock_connected;
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, false, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
+
+  // Sends the open command and returns at once; connecting() stays true
+  // until the modem reports the outcome, then connected() tells which
+  virtual int connectAsync(const char *host, uint16_t port) {
+    TINY_GSM_LOCK(this->at);
+    stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    return this->at->modemConnectStart(host, port, this->mux, false);
+  }
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
     // Read and dump anything remaining in the modem's internal buffer.
     // The socket will appear open in response to connected() even after it
     // closes until all data is read from the buffer.
     // Doing it this way allows the external mcu to find and get all of the data
     // that it wants from the socket even if it was closed externally.
-    rx.clear();
-    at->maintain();
-    while (sock_available > 0) {
-      at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux);
-      rx.clear();
-      at->maintain();
+    this->rx.clear();
+    this->at->maintain();
+    while (this->sock_available > 0) {
+      this->at->modemRead(TinyGsmMin((uint16_t)this->rx.free(), this->sock_available), this->mux);
+      this->rx.clear();
+      this->at->maintain();
     }
+    this->rx.clear();  // maintain() may have read ahead into it
+    this->sock_connecting = false;
+    this->at->sendAT(GF("+QICLOSE="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse();
+  }
+
+  /*
+   * Extended API
+   */
+
+  String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
+};
+
+
+class GsmClientTransparent : public Client
+{
+  friend class TinyGsmBG96T;
+
+public:
+  GsmClientTransparent() {}
+
+  GsmClientTransparent(TinyGsmBG96T& modem, uint8_t mux = 1) {
+    init(&modem, mux);
+  }
+
+  bool init(TinyGsmBG96T* modem, uint8_t mux = 1) {
+    this->at = modem;
+    this->mux = mux;
+    sock_connected = false;
+    data_mode = false;
+
+    return true;
+  }
+
+public:
+  virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
+    stop();
+    TINY_GSM_YIELD();
+    sock_connected = at->modemConnectTransparent(host, port, mux, timeout_s);
+    data_mode = sock_connected;
+    return sock_connected;
+  }
+
+TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+
+  virtual void stop() {
+    TINY_GSM_LOCK(this->at);
+    TINY_GSM_YIELD();
+    trailerReset();
+    pause();
     at->sendAT(GF("+QICLOSE="), mux);
     sock_connected = false;
+    data_mode = false;
     at->waitResponse();
   }
 
-TINY_GSM_CLIENT_WRITE()
+TINY_GSM_CLIENT_TRANSPARENT(GSM_NL "NO CARRIER" GSM_NL)
 
-TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK()
+private:
+  TinyGsmBG96T*   at;
+  uint8_t         mux;
+  TINY_GSM_FLAG(sock_connected);
+  TINY_GSM_FLAG(data_mode);
+};
 
-TINY_GSM_CLIENT_READ_WITH_BUFFER_CHECK()
 
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
+class GsmHttp
+{
+  friend class TinyGsmBG96T;
 
-  /*
-   * Extended API
-   */
+public:
+  GsmHttp() {}
 
-  String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
+  GsmHttp(TinyGsmBG96T& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmBG96T* modem) {
+    this->at = modem;
+    status_code = 0;
+    content_length = 0;
+    read_pos = 0;
+
+    return true;
+  }
+
+public:
+TINY_GSM_HTTP_REQUESTS()
 
 private:
-  TinyGsmBG96*    at;
-  uint8_t         mux;
-  uint16_t        sock_available;
-  uint32_t        prev_check;
-  bool            sock_connected;
-  bool            got_data;
-  RxFifo          rx;
+  TinyGsmBG96T*   at;
+  int             status_code;
+  uint32_t        content_length;
+  uint32_t        read_pos;
 };
 
 
@@ -131,7 +230,7 @@ private:
 // public:
 //   GsmClientSecure() {}
 //
-//   GsmClientSecure(TinyGsmBG96& modem, uint8_t mux = 1)
+//   GsmClientSecure(TinyGsmBG96T& modem, uint8_t mux = 1)
 //     : GsmClient(modem, mux)
 //   {}
 //
@@ -148,10 +247,12 @@ private:
 
 public:
 
-  TinyGsmBG96(Stream& stream)
+  TinyGsmBG96T(StreamT& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    download_state = -1;
+    download_total = 0;
   }
 
   /*
@@ -180,12 +281,18 @@ public:
     return "Quectel BG96";
   }
 
+TINY_GSM_MODEM_READ_NAME_CONSTANT()
+
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 
+TINY_GSM_MODEM_POLL()
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -198,7 +305,7 @@ TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-    return false;  // TODO: For now
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -214,6 +321,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -226,6 +335,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+QPOWD=1"));
     waitResponse(300);  // returns OK first
     return waitResponse(300, GF("POWERED DOWN")) == 1;
@@ -288,6 +399,10 @@ TINY_GSM_MODEM_GET_OPERATOR_COPS()
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CREG, true)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     return (s == REG_OK_HOME || s == REG_OK_ROAMING);
@@ -496,6 +611,186 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
 
   float getTemperature() TINY_GSM_ATTR_NOT_AVAILABLE;
 
+  /*
+   * File system functions
+   */
+
+TINY_GSM_MODEM_FILE_ACCESS()
+
+TINY_GSM_MODEM_FILE_QUECTEL("UFS:")
+
+public:
+
+  /*
+   * File download functions
+   */
+
+TINY_GSM_MODEM_FILE_DOWNLOAD(0)
+
+  bool downloadBegin(const char* url, const char* filename) {
+    download_state = -1;
+    if (httpRequest(url, false, NULL, NULL, 0, 60000L, &download_total) != 200) {
+      return false;
+    }
+    if (download_total == 0xFFFFFFFFUL) {
+      download_total = 0;
+    }
+    fileDelete(filename);  // Don't append to an old copy
+    sendAT(GF("+QHTTPREADFILE=\"UFS:"), filename, GF("\",80"));
+    if (waitResponse() != 1) {
+      return false;
+    }
+    download_state = 0;
+    return true;
+  }
+
+  // 1 when complete, 0 while in progress, -1 on failure
+  int8_t downloadStatus(const char* filename, uint32_t* done, uint32_t* total) {
+    if (download_state == 0) {
+      waitResponse(10);  // Pick up a pending +QHTTPREADFILE
+    }
+    *total = download_total;
+    if (download_state >= 0) {
+      *done = fileSize(filename);
+    }
+    return download_state;
+  }
+
+  /*
+   * HTTP functions
+   */
+
+protected:
+
+  int httpRequest(const char* url, bool post, const char* contentType,
+                  const uint8_t* body, size_t len, uint32_t timeout_ms,
+                  uint32_t* length)
+  {
+    *length = 0;
+    uint32_t timeout_s = TinyGsmMax(timeout_ms / 1000, (uint32_t)1);
+    sendAT(GF("+QHTTPCFG=\"contextid\",1"));
+    waitResponse();
+    sendAT(GF("+QHTTPCFG=\"responseheader\",0"));
+    waitResponse();
+    if (strncmp(url, "https", 5) == 0) {
+      sendAT(GF("+QHTTPCFG=\"sslctxid\",1"));
+      waitResponse();
+#if defined(TINY_GSM_HTTP_INSECURE)
+      sendAT(GF("+QSSLCFG=\"seclevel\",1,0"));  // No certificate check
+      waitResponse();
+#endif
+    }
+    if (post && contentType) {
+      // Only these types can be selected, anything else is sent as binary
+      uint8_t type = 2;
+      if (strstr(contentType, "x-www-form-urlencoded")) type = 0;
+      else if (strstr(contentType, "text/plain")) type = 1;
+      else if (strstr(contentType, "multipart/form-data")) type = 3;
+      sendAT(GF("+QHTTPCFG=\"contenttype\","), type);
+      waitResponse();
+    }
+
+    sendAT(GF("+QHTTPURL="), strlen(url), GF(",80"));
+    if (waitResponse(GF("CONNECT" GSM_NL)) != 1) {
+      return 0;
+    }
+    stream.print(url);
+    stream.flush();
+    if (waitResponse() != 1) {
+      return 0;
+    }
+
+    if (post) {
+      sendAT(GF("+QHTTPPOST="), len, GF(",80,"), timeout_s);
+      if (waitResponse(GF("CONNECT" GSM_NL)) != 1) {
+        return 0;
+      }
+      stream.write(body, len);
+      stream.flush();
+      if (waitResponse() != 1) {
+        return 0;
+      }
+      if (waitResponse(timeout_ms, GF(GSM_NL "+QHTTPPOST:")) != 1) {
+        return 0;
+      }
+    } else {
+      sendAT(GF("+QHTTPGET="), timeout_s);
+      if (waitResponse() != 1) {
+        return 0;
+      }
+      if (waitResponse(timeout_ms, GF(GSM_NL "+QHTTPGET:")) != 1) {
+        return 0;
+      }
+    }
+    // <err>,<status>[,<length>], no length for chunked responses
+    String res = stream.readStringUntil('\n');
+    int comma1 = res.indexOf(',');
+    if (res.toInt() != 0 || comma1 < 0) {
+      DBG("### HTTP error:", res);
+      return 0;
+    }
+    int comma2 = res.indexOf(',', comma1 + 1);
+    int status = res.substring(comma1 + 1).toInt();
+    *length = (comma2 > 0) ? res.substring(comma2 + 1).toInt() : 0xFFFFFFFFUL;
+    DBG("### HTTP:", status, "length", *length);
+    return status;
+  }
+
+  // The whole body comes out in one go, there is no offset to read from
+  size_t httpRead(Print& sink, uint32_t pos, size_t len) {
+    if (pos > 0) {
+      return 0;
+    }
+    sendAT(GF("+QHTTPREAD=80"));
+    if (waitResponse(GF("CONNECT" GSM_NL)) != 1) {
+      return 0;
+    }
+    size_t copied;
+    if (len != 0xFFFFFFFFUL) {
+      copied = streamCopy(sink, len, 10000L);
+      waitResponse(GF("+QHTTPREAD:"));
+    } else {
+      copied = streamCopyUntilTrailer(sink);
+    }
+    streamSkipUntil('\n');
+    return copied;
+  }
+
+  // Copies a body of unknown length, holding back what may be the trailer
+  size_t streamCopyUntilTrailer(Print& sink) {
+    static const char trailer[] = GSM_NL "OK" GSM_NL GSM_NL "+QHTTPREAD:";
+    size_t copied = 0;
+    uint8_t matched = 0;
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < 10000L) {
+      if (!streamAvailable()) {
+        TINY_GSM_YIELD();
+        continue;
+      }
+      char c = streamRead();
+      startMillis = millis();
+      if (c == trailer[matched]) {
+        if (!trailer[++matched]) {
+          break;
+        }
+        continue;
+      }
+      sink.write((const uint8_t*)trailer, matched);
+      copied += matched;
+      matched = (c == trailer[0]);
+      if (!matched) {
+        sink.write(c);
+        copied++;
+      }
+    }
+    return copied;
+  }
+
+  bool httpEnd() {
+    // Nothing to release, every request stands on its own
+    return true;
+  }
+
   /*
    * Client related functions
    */
@@ -505,27 +800,41 @@ protected:
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
                     bool ssl = false, int timeout_s = 20)
  {
-    int rsp;
-    uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    if (!modemConnectStart(host, port, mux, ssl)) {
+      return false;
+    }
+    return modemConnectWait(mux, ((uint32_t)timeout_s)*1000);
+  }
 
+  // Sends +QIOPEN; the "+QIOPEN: <mux>,<err>" URC follows once the
+  // connection is up or has failed
+  bool modemConnectStart(const char* host, uint16_t port, uint8_t mux,
+                         bool ssl = false)
+  {
+    sockets[mux]->sock_connecting = true;
     // <PDPcontextID>(1-16), <connectID>(0-11),"TCP/UDP/TCP LISTENER/UDP SERVICE",
     // "<IP_address>/<domain_name>",<remote_port>,<local_port>,<access_mode>(0-2 0=buffer)
     sendAT(GF("+QIOPEN=1,"), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port, GF(",0,0"));
-    rsp = waitResponse();
-
-    if (waitResponse(timeout_ms, GF(GSM_NL "+QIOPEN:")) != 1) {
+    if (waitResponse() != 1) {
+      sockets[mux]->sock_connecting = false;
       return false;
     }
+    return true;
+  }
 
-    if (stream.readStringUntil(',').toInt() != mux) {
-      return false;
-    }
-    // Read status
-    rsp = stream.readStringUntil('\n').toInt();
+TINY_GSM_MODEM_CONNECT_WAIT()
 
-    return (0 == rsp);
+  bool modemConnectTransparent(const char* host, uint16_t port, uint8_t mux,
+                               int timeout_s = 20)
+  {
+    uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    // Same as modemConnect, but with <access_mode> 2 (transparent)
+    sendAT(GF("+QIOPEN=1,"), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port, GF(",0,2"));
+    return waitResponse(timeout_ms, GF(GSM_NL "CONNECT" GSM_NL)) == 1;
   }
 
+TINY_GSM_MODEM_DATA_MODE_SWITCH()
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+QISEND="), mux, ',', len);
     if (waitResponse(GF(">")) != 1) {
@@ -540,6 +849,8 @@ protected:
     return len;
   }
 
+TINY_GSM_MODEM_PREFETCH()
+
   size_t modemRead(size_t size, uint8_t mux) {
     sendAT(GF("+QIRD="), mux, ',', size);
     if (waitResponse(GF("+QIRD:")) != 1) {
@@ -616,11 +927,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && modemStatusUrc(data)) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -655,10 +968,27 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
             stream.readStringUntil('\n');
           }
           data = "";
+        } else if (data.endsWith(GF(GSM_NL "+QIOPEN:"))) {
+          int mux = stream.readStringUntil(',').toInt();
+          int err = stream.readStringUntil('\n').toInt();
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
+              sockets[mux]->sock_connecting) {
+            sockets[mux]->sock_connecting = false;
+            sockets[mux]->sock_connected = (err == 0);
+            TINY_GSM_METER(sockets[mux], connectEnd());
+          }
+          data = "";
+          DBG("### URC Open:", mux, err);
+        } else if (data.endsWith(GF(GSM_NL "+QHTTPREADFILE:"))) {
+          int err = stream.readStringUntil('\n').toInt();
+          download_state = (err == 0) ? 1 : -1;
+          data = "";
+          DBG("### URC Download:", err);
         }
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -685,10 +1015,14 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  int8_t        download_state;
+  uint32_t      download_total;
 };
 
+typedef TinyGsmBG96T<Stream> TinyGsmBG96;
+
 #endif
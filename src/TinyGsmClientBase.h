@@ -0,0 +1,326 @@
+/**
+ * @file       TinyGsmClientBase.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Socket client shared by the AT command drivers.  Each driver describes its
+ * modem in a Traits struct and derives its GsmClient from
+ * TinyGsmClientBase<GsmClient, Traits>; the read, write and available paths
+ * are then picked at compile time from the traits:
+ *
+ *   struct Traits {
+ *     typedef TinyGsmSim800 Modem;
+ *     static constexpr bool     has_modem_fifo = true;   // modem holds data until asked
+ *     static constexpr bool     reliable_urc   = false;  // data URCs can go missing
+ *     static constexpr uint16_t max_segment    = 1460;   // largest single send
+ *     static constexpr uint16_t max_read       = 1460;   // largest single read
+ *     static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+ *     static constexpr bool     has_ssl        = true;   // what the driver
+ *     static constexpr bool     has_gps        = false;  // supports, also
+ *     static constexpr bool     has_udp        = false;  // behind hasSSL()
+ *   };
+ *
+ * The Client virtuals only forward to writeImpl(), availableImpl() and
+ * readImpl(), which are inline and can be called directly on a concrete
+ * client.  A driver that needs different behaviour defines its own *Impl().
+ */
+
+#ifndef TinyGsmClientBase_h
+#define TinyGsmClientBase_h
+
+#include <TinyGsmCommon.h>
+
+template <bool B>
+struct TinyGsmBoolTag {};
+
+// Per-socket bookkeeping, only what the modem type needs
+
+// No modem side buffer: data arrives with the URC
+template <bool HasModemFifo, bool ReliableUrc>
+class TinyGsmSocketState
+{
+protected:
+  void checkMissedUrc() {}
+};
+
+// Modem side buffer, URCs always arrive
+template <>
+class TinyGsmSocketState<true, true>
+{
+protected:
+  void checkMissedUrc() {}
+
+  uint16_t        sock_available;
+  TINY_GSM_FLAG(got_data);
+};
+
+// Modem side buffer, URCs sometimes don't arrive
+template <>
+class TinyGsmSocketState<true, false>
+{
+protected:
+  // Workaround: sometimes module forgets to notify about data arrival.
+  // TODO: Currently we ping the module periodically,
+  // but maybe there's a better indicator that we need to poll
+  void checkMissedUrc() {
+    if ((TinyGsmTick)((TinyGsmTick)millis() - prev_check) > 500) {
+      got_data = true;
+      prev_check = millis();
+    }
+  }
+
+  uint16_t        sock_available;
+  TinyGsmTick     prev_check;
+  TINY_GSM_FLAG(got_data);
+};
+
+template <class Derived, class Traits>
+class TinyGsmClientBase
+  : public Client,
+    public TinyGsmSocketState<Traits::has_modem_fifo, Traits::reliable_urc>
+{
+public:
+  typedef typename Traits::Modem Modem;
+  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  typedef typename TinyGsmIndexType<Traits::mux_count>::type MuxIndex;
+
+  TinyGsmClientBase() : sock_connecting(false) {}
+
+  virtual int connect(const char *host, uint16_t port, int timeout_s) = 0;
+
+  // Connect to a IP address given as an IPAddress object by
+  // converting said IP address to text
+  virtual int connect(IPAddress ip, uint16_t port, int timeout_s) {
+    String host; host.reserve(16);
+    host += ip[0];
+    host += ".";
+    host += ip[1];
+    host += ".";
+    host += ip[2];
+    host += ".";
+    host += ip[3];
+    return connect(host.c_str(), port, timeout_s);
+  }
+  virtual int connect(const char *host, uint16_t port) {
+    return connect(host, port, 75);
+  }
+  virtual int connect(IPAddress ip, uint16_t port) {
+    return connect(ip, port, 75);
+  }
+
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    return self().writeImpl(buf, size);
+  }
+
+  virtual size_t write(uint8_t c) {
+    return self().writeImpl(&c, 1);
+  }
+
+  virtual size_t write(const char *str) {
+    if (str == NULL) return 0;
+    return self().writeImpl((const uint8_t *)str, strlen(str));
+  }
+
+  virtual int available() {
+    return self().availableImpl();
+  }
+
+  virtual int read(uint8_t *buf, size_t size) {
+    return self().readImpl(buf, size);
+  }
+
+  virtual int read() {
+    uint8_t c;
+    if (self().readImpl(&c, 1) == 1) {
+      return c;
+    }
+    return -1;
+  }
+
+  virtual int peek() { return -1; } /* TODO */
+
+  virtual void flush() { at->stream.flush(); }
+
+  virtual uint8_t connected() {
+    if (self().availableImpl()) {
+      return true;
+    }
+    return sock_connected;
+  }
+  virtual operator bool() { return connected(); }
+
+  // True while a connectAsync() waits for the modem to report the outcome
+  bool connecting() {
+    if (sock_connecting) {
+      TINY_GSM_LOCK(at);
+      at->maintain();
+    }
+    return sock_connecting;
+  }
+
+  // Writes data out on the client using the modem send functionality, in
+  // pieces the modem accepts
+  size_t writeImpl(const uint8_t *buf, size_t size) {
+    TINY_GSM_YIELD();
+    TINY_GSM_LOCK(at);
+    TINY_GSM_METER_START(start);
+    at->maintain();
+    size_t sent = 0;
+    while (sent < size) {
+      size_t chunk = TinyGsmMin(size - sent, (size_t)Traits::max_segment);
+      int n = at->modemSend(buf + sent, chunk, mux);
+      TINY_GSM_METER(this, modemSend());
+      if (n <= 0) break;
+      TINY_GSM_STATS_DATA(n, 0);
+      sent += n;
+      if ((size_t)n < chunk) break;
+    }
+    TINY_GSM_METER(this, write(sent, start));
+    return sent;
+  }
+
+  int availableImpl() {
+    TINY_GSM_LOCK(at);
+    return availableImpl(TinyGsmBoolTag<Traits::has_modem_fifo>());
+  }
+
+  int readImpl(uint8_t *buf, size_t size) {
+    TINY_GSM_LOCK(at);
+    TINY_GSM_METER_START(start);
+    int n = readImpl(buf, size, TinyGsmBoolTag<Traits::has_modem_fifo>());
+    TINY_GSM_METER(this, read(n, start));
+    return n;
+  }
+
+#if defined(TINY_GSM_SOCKET_STATS)
+  // Counters and rates of this socket since it was created or reset
+  const TinyGsmSocketStats& getStats() { return meter.get(); }
+  void resetStats() { meter.reset(); }
+#endif
+
+  // This socket's bit in the masks poll() fills in; some modems pick the
+  // socket number themselves, so take it after connect()
+  uint32_t pollMask() { return 1UL << (mux % Traits::mux_count); }
+
+  // Readiness for the modem's poll(), from the state the last maintain() left;
+  // doesn't talk to the modem
+  uint8_t pollEvents() {
+    uint8_t ev = 0;
+    if (pollReadable(TinyGsmBoolTag<Traits::has_modem_fifo>())) {
+      ev |= TINY_GSM_POLL_READ;
+    } else if (sock_connected) {
+      // Have the next maintain() ask, in case a data URC went missing
+      this->checkMissedUrc();
+    }
+    if (sock_connected) {
+      ev |= TINY_GSM_POLL_WRITE;
+    } else if (!sock_connecting) {
+      ev |= TINY_GSM_POLL_CLOSED;
+    }
+    return ev;
+  }
+
+protected:
+  Derived& self() { return static_cast<Derived&>(*this); }
+
+  bool pollReadable(TinyGsmBoolTag<true>) {
+    return rx.size() || this->sock_available;
+  }
+
+  bool pollReadable(TinyGsmBoolTag<false>) {
+    return rx.size();
+  }
+
+  // Returns the combined number of characters available in the TinyGSM fifo
+  // and the modem chips internal fifo
+  int availableImpl(TinyGsmBoolTag<true>) {
+    TINY_GSM_YIELD();
+    if (!rx.size()) {
+      this->checkMissedUrc();
+      at->maintain();
+    }
+    return rx.size() + this->sock_available;
+  }
+
+  // Returns the number of characters avaialable in the TinyGSM fifo
+  // Assumes the modem chip has no internal fifo
+  int availableImpl(TinyGsmBoolTag<false>) {
+    TINY_GSM_YIELD();
+    if (!rx.size() && sock_connected) {
+      at->updateRts();
+      at->maintain();
+    }
+    return rx.size();
+  }
+
+  // Reads characters out of the TinyGSM fifo, and from the modem chips
+  // internal fifo if avaiable
+  int readImpl(uint8_t *buf, size_t size, TinyGsmBoolTag<true>) {
+    TINY_GSM_YIELD();
+    // With read-ahead, a read the fifo can fill doesn't wait for maintain()
+    // to top up some other socket
+    if (!TINY_GSM_PREFETCH || rx.size() < size) {
+      at->maintain();
+    }
+    size_t cnt = 0;
+    while (cnt < size) {
+      size_t chunk = TinyGsmMin(size-cnt, rx.size());
+      if (chunk > 0) {
+        rx.get(buf, chunk);
+        buf += chunk;
+        cnt += chunk;
+        continue;
+      }
+      this->checkMissedUrc();
+      /* TODO: Read directly into user buffer? */
+      at->maintain();
+      if (this->sock_available > 0) {
+        uint16_t want = TinyGsmMin((uint16_t)rx.free(), this->sock_available);
+        int n = at->modemRead(TinyGsmMin(want, (uint16_t)Traits::max_read), mux);
+        TINY_GSM_STATS_DATA(0, n);
+        TINY_GSM_METER(this, modemRead());
+        if (n == 0) break;
+      } else {
+        break;
+      }
+    }
+    return cnt;
+  }
+
+  // Reads characters out of the TinyGSM fifo, waiting for any URC's from the
+  // modem for new data if there's nothing in the fifo.  This assumes the
+  // modem chip itself has no fifo.
+  int readImpl(uint8_t *buf, size_t size, TinyGsmBoolTag<false>) {
+    TINY_GSM_YIELD();
+    size_t cnt = 0;
+    uint32_t _startMillis = millis();
+    while (cnt < size && millis() - _startMillis < _timeout) {
+      size_t chunk = TinyGsmMin(size-cnt, rx.size());
+      if (chunk > 0) {
+        rx.get(buf, chunk);
+        buf += chunk;
+        cnt += chunk;
+        continue;
+      }
+      /* TODO: Read directly into user buffer? */
+      if (!rx.size() && sock_connected) {
+        at->updateRts();
+        at->maintain();
+      }
+    }
+    return cnt;
+  }
+
+  Modem*          at;
+  MuxIndex        mux;
+  TINY_GSM_FLAG(sock_connected);
+  TINY_GSM_FLAG(sock_connecting);
+  RxFifo          rx;
+#if defined(TINY_GSM_SOCKET_STATS)
+  TinyGsmSocketMeter meter;
+#endif
+};
+
+#endif
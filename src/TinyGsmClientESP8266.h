@@ -19,6 +19,7 @@
 #define TINY_GSM_MUX_COUNT 5
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -40,71 +41,75 @@ enum RegStatus {
 
 
 
-class TinyGsmESP8266
+template <class StreamT = Stream>
+class TinyGsmESP8266T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmESP8266T Modem;
+    static constexpr bool     has_modem_fifo = false;
+    static constexpr bool     reliable_urc   = true;
+    static constexpr uint16_t max_segment    = 2048;
+    static constexpr uint16_t max_read       = 2048;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = true;
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmESP8266;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmESP8266T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmESP8266& modem, uint8_t mux = 1) {
+  GsmClient(TinyGsmESP8266T& modem, uint8_t mux = 1) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmESP8266* modem, uint8_t mux = 1) {
+  bool init(TinyGsmESP8266T* modem, uint8_t mux = 1) {
     this->at = modem;
     this->mux = mux;
-    sock_connected = false;
+    this->sock_connected = false;
 
-    at->sockets[mux] = this;
+    this->at->sockets[this->mux] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, false, timeout_s);
-    return sock_connected;
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, false, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
-    at->sendAT(GF("+CIPCLOSE="), mux);
-    sock_connected = false;
-    at->waitResponse();
-    rx.clear();
+    this->at->sendAT(GF("+CIPCLOSE="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse();
+    this->rx.clear();
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_NO_MODEM_FIFO()
-
-TINY_GSM_CLIENT_READ_NO_MODEM_FIFO()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
-
-private:
-  TinyGsmESP8266* at;
-  uint8_t         mux;
-  bool            sock_connected;
-  RxFifo          rx;
 };
 
 
@@ -113,24 +118,27 @@ class GsmClientSecure : public GsmClient
 public:
   GsmClientSecure() {}
 
-  GsmClientSecure(TinyGsmESP8266& modem, uint8_t mux = 1)
+  GsmClientSecure(TinyGsmESP8266T& modem, uint8_t mux = 1)
     : GsmClient(modem, mux)
   {}
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
-    stop();
+    TINY_GSM_LOCK(this->at);
+    this->stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, true, timeout_s);
-    return sock_connected;
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, true, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 };
 
 
 public:
 
-  TinyGsmESP8266(Stream& stream)
+  TinyGsmESP8266T(StreamT& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
@@ -170,13 +178,37 @@ public:
   }
 
   void setBaud(unsigned long baud) {
-    sendAT(GF("+UART_CUR="), baud, "8,1,0,0");
+    sendAT(GF("+UART_CUR="), baud, GF(",8,1,0,0"));
+    stream.flush();  // Out before the caller changes the port speed
+  }
+
+  bool setHardwareFlowControl(bool enable = true) {
+    // UART_CUR sets baud and framing together, so keep the current baud rate
+    sendAT(GF("+UART_CUR?"));
+    if (waitResponse(GF("+UART_CUR:")) != 1) {
+      return false;
+    }
+    unsigned long baud = stream.readStringUntil(',').toInt();
+    waitResponse();
+    if (!baud) {
+      return false;
+    }
+    if (enable) {
+      TINY_GSM_RTS_BEGIN();
+    }
+    // <flow control> 3 = RTS and CTS
+    sendAT(GF("+UART_CUR="), baud, GF(",8,1,0,"), enable ? 3 : 0);
+    return waitResponse() == 1;
   }
 
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_LISTEN()
 
+TINY_GSM_MODEM_POLL()
+
+TINY_GSM_MODEM_UPDATE_RTS()
+
   bool factoryDefault() {
     sendAT(GF("+RESTORE"));
     return waitResponse() == 1;
@@ -195,7 +227,7 @@ TINY_GSM_MODEM_MAINTAIN_LISTEN()
   }
 
   bool hasSSL() {
-    return true;
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -399,14 +431,19 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    if (r1) {
+      TINY_GSM_RTS(true);  // Let the modem answer even if a fifo is full
+    }
     int index = 0;
     unsigned long startMillis = millis();
+    unsigned long lastByteMillis = startMillis;
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
+        lastByteMillis = millis();
         if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
@@ -437,6 +474,9 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           if (len_orig > sockets[mux]->available()) { // TODO
             DBG("### Fewer characters received than expected: ", sockets[mux]->available(), " vs ", len_orig);
           }
+          if (!r1) {
+            updateRts();  // Else held open until the reply is in
+          }
           data = "";
         } else if (data.endsWith(GF("CLOSED"))) {
           int muxStart = max(0,data.lastIndexOf(GSM_NL, data.length()-8));
@@ -449,8 +489,11 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           DBG("### Closed: ", mux);
         }
       }
-    } while (millis() - startMillis < timeout_ms);
+    } while (millis() - startMillis < timeout_ms ||
+             (ipdHeaderPending(data) && millis() - lastByteMillis < 20));
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
+    updateRts();
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -462,6 +505,20 @@ finish:
     return index;
   }
 
+  // True while data ends in what may be the start of a "+IPD," header.  A
+  // push that straddles the timeout would lose its header otherwise.
+  static bool ipdHeaderPending(const String& data) {
+    if (data.endsWith(GF("\r"))) {
+      return true;
+    }
+    int nl = data.lastIndexOf(GSM_NL);
+    if (nl < 0) {
+      return false;
+    }
+    size_t tail = data.length() - nl - 2;
+    return tail < 5 && !strncmp(data.c_str() + nl + 2, "+IPD,", tail);
+  }
+
   uint8_t waitResponse(uint32_t timeout_ms,
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
@@ -477,10 +534,12 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
 };
 
+typedef TinyGsmESP8266T<Stream> TinyGsmESP8266;
+
 #endif
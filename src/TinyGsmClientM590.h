@@ -19,6 +19,7 @@
 #define TINY_GSM_MUX_COUNT 2
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -40,78 +41,82 @@ enum RegStatus {
 };
 
 
-class TinyGsmM590
+template <class StreamT = Stream>
+class TinyGsmM590T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmM590T Modem;
+    static constexpr bool     has_modem_fifo = false;
+    static constexpr bool     reliable_urc   = true;
+    static constexpr uint16_t max_segment    = 1024;
+    static constexpr uint16_t max_read       = 1024;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = false;
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmM590;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmM590T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmM590& modem, uint8_t mux = 1) {
+  GsmClient(TinyGsmM590T& modem, uint8_t mux = 1) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmM590* modem, uint8_t mux = 1) {
+  bool init(TinyGsmM590T* modem, uint8_t mux = 1) {
     this->at = modem;
     this->mux = mux;
-    sock_connected = false;
+    this->sock_connected = false;
 
-    at->sockets[mux] = this;
+    this->at->sockets[this->mux] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, timeout_s);
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
 
-    return sock_connected;
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
-    at->sendAT(GF("+TCPCLOSE="), mux);
-    sock_connected = false;
-    at->waitResponse();
-    rx.clear();
+    this->at->sendAT(GF("+TCPCLOSE="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse();
+    this->rx.clear();
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_NO_MODEM_FIFO()
-
-TINY_GSM_CLIENT_READ_NO_MODEM_FIFO()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
-
-private:
-  TinyGsmM590*    at;
-  uint8_t         mux;
-  bool            sock_connected;
-  RxFifo          rx;
 };
 
 
 public:
 
-  TinyGsmM590(Stream& stream)
+  TinyGsmM590T(StreamT& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
@@ -147,12 +152,20 @@ public:
     return "Neoway M590";
   }
 
+TINY_GSM_MODEM_READ_NAME_CONSTANT()
+
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_LISTEN()
 
+TINY_GSM_MODEM_POLL()
+
+TINY_GSM_MODEM_UPDATE_RTS()
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -169,7 +182,7 @@ TINY_GSM_MODEM_MAINTAIN_LISTEN()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-    return false;
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -185,6 +198,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -198,6 +213,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+CPWROFF"));
     return waitResponse(3000L) == 1;
   }
@@ -248,6 +265,10 @@ TINY_GSM_MODEM_GET_OPERATOR_COPS()
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CREG, false)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     return (s == REG_OK_HOME || s == REG_OK_ROAMING);
@@ -489,15 +510,20 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    if (r1) {
+      TINY_GSM_RTS(true);  // Let the modem answer even if a fifo is full
+    }
     int index = 0;
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && modemStatusUrc(data)) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -527,6 +553,9 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           if (len_orig > sockets[mux]->available()) { // TODO
             DBG("### Fewer characters received than expected: ", sockets[mux]->available(), " vs ", len_orig);
           }
+          if (!r1) {
+            updateRts();  // Else held open until the reply is in
+          }
           data = "";
         } else if (data.endsWith(GF("+TCPCLOSE:"))) {
           int mux = stream.readStringUntil(',').toInt();
@@ -540,6 +569,8 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
+    updateRts();
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -566,10 +597,12 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
 };
 
+typedef TinyGsmM590T<Stream> TinyGsmM590;
+
 #endif
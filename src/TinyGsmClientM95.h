@@ -20,6 +20,7 @@
 #define TINY_GSM_MUX_COUNT 6
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -41,86 +42,88 @@ enum RegStatus {
 };
 
 
-class TinyGsmM95
+template <class StreamT = Stream>
+class TinyGsmM95T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmM95T Modem;
+    static constexpr bool     has_modem_fifo = true;
+    static constexpr bool     reliable_urc   = true;
+    static constexpr uint16_t max_segment    = 1460;
+    static constexpr uint16_t max_read       = 1500;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = false;  // TODO: For now
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmM95;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmM95T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmM95& modem, uint8_t mux = 1) {
+  GsmClient(TinyGsmM95T& modem, uint8_t mux = 1) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmM95* modem, uint8_t mux = 1) {
+  bool init(TinyGsmM95T* modem, uint8_t mux = 1) {
     this->at = modem;
     this->mux = mux;
-    sock_available = 0;
-    sock_connected = false;
-    got_data = false;
+    this->sock_available = 0;
+    this->sock_connected = false;
+    this->got_data = false;
 
-    at->sockets[mux] = this;
+    this->at->sockets[this->mux] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, false, timeout_s);
-    return sock_connected;
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, false, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
     // Read and dump anything remaining in the modem's internal buffer.
     // The socket will appear open in response to connected() even after it
     // closes until all data is read from the buffer.
     // Doing it this way allows the external mcu to find and get all of the data
     // that it wants from the socket even if it was closed externally.
-    rx.clear();
-    at->maintain();
-    while (sock_available > 0) {
-      at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux);
-      rx.clear();
-      at->maintain();
+    this->rx.clear();
+    this->at->maintain();
+    while (this->sock_available > 0) {
+      this->at->modemRead(TinyGsmMin((uint16_t)this->rx.free(), this->sock_available), this->mux);
+      this->rx.clear();
+      this->at->maintain();
     }
-    at->sendAT(GF("+QICLOSE="), mux);
-    sock_connected = false;
-    at->waitResponse(60000L, GF("CLOSED"), GF("CLOSE OK"), GF("ERROR"));
+    this->at->sendAT(GF("+QICLOSE="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse(60000L, GF("CLOSED"), GF("CLOSE OK"), GF("ERROR"));
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_NO_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_READ_NO_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
-
-private:
-  TinyGsmM95*     at;
-  uint8_t         mux;
-  uint16_t        sock_available;
-  bool            sock_connected;
-  bool            got_data;
-  RxFifo          rx;
 };
 
 
@@ -146,7 +149,7 @@ private:
 
 public:
 
-  TinyGsmM95(Stream& stream)
+  TinyGsmM95T(StreamT& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
@@ -182,12 +185,18 @@ public:
     return "Quectel M95";
   }
 
+TINY_GSM_MODEM_READ_NAME_CONSTANT()
+
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_LISTEN()
 
+TINY_GSM_MODEM_POLL()
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -200,7 +209,7 @@ TINY_GSM_MODEM_MAINTAIN_LISTEN()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-    return false;  // TODO: For now
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -216,6 +225,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -231,6 +242,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+QPOWD=1"));
     return waitResponse(300, GF("NORMAL POWER DOWN")) == 1;
   }
@@ -294,6 +307,10 @@ TINY_GSM_MODEM_GET_OPERATOR_COPS()
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CREG, true)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     return (s == REG_OK_HOME || s == REG_OK_ROAMING);
@@ -555,6 +572,14 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     return temp;
   }
 
+  /*
+   * File system functions
+   */
+
+TINY_GSM_MODEM_FILE_ACCESS()
+
+TINY_GSM_MODEM_FILE_QUECTEL("")
+
   /*
    * Client related functions
    */
@@ -675,11 +700,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && modemStatusUrc(data)) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -715,6 +742,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -741,10 +769,12 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
 };
 
+typedef TinyGsmM95T<Stream> TinyGsmM95;
+
 #endif
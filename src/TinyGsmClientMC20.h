@@ -45,7 +45,8 @@ enum RegStatus {
 //============================================================================//
 //============================================================================//
 
-class TinyGsmMC20
+template <class StreamT = Stream>
+class TinyGsmMC20T
 {
 
 //============================================================================//
@@ -57,19 +58,32 @@ class TinyGsmMC20
 
 public:
 
+  // What this modem can do; the MC20 keeps its own client
+  struct Traits {
+    typedef TinyGsmMC20T Modem;
+    static constexpr bool     has_modem_fifo = true;
+    static constexpr bool     reliable_urc   = true;
+    static constexpr uint16_t max_segment    = 1460;
+    static constexpr uint16_t max_read       = 1500;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = true;
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
 class GsmClient : public Client
 {
-  friend class TinyGsmMC20;
+  friend class TinyGsmMC20T;
   typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmMC20& modem, uint8_t mux = 0) {
+  GsmClient(TinyGsmMC20T& modem, uint8_t mux = 0) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmMC20* modem, uint8_t mux = 0) {
+  bool init(TinyGsmMC20T* modem, uint8_t mux = 0) {
     this->at = modem;
     this->mux = mux;
     sock_available = 0;
@@ -83,6 +97,7 @@ public:
 
 public:
   virtual int connect(const char *host, uint16_t port) {
+    TINY_GSM_LOCK(at);
     // stop();
     TINY_GSM_YIELD();
     rx.clear();
@@ -104,6 +119,7 @@ public:
   }
 
   virtual void stop() {
+    TINY_GSM_LOCK(at);
     TINY_GSM_YIELD();
     at->sendAT(GF("+QICLOSE="), mux);
     sock_connected = false;
@@ -112,6 +128,7 @@ public:
   }
 
   virtual size_t write(const uint8_t *buf, size_t size) {
+    TINY_GSM_LOCK(at);
     TINY_GSM_YIELD();
     at->maintain();
     return at->modemSend(buf, size, mux);
@@ -127,6 +144,7 @@ public:
   }
 
   virtual int available() {
+    TINY_GSM_LOCK(at);
     TINY_GSM_YIELD();
     if (!rx.size()) {
       at->maintain();
@@ -135,6 +153,7 @@ public:
   }
 
   virtual int read(uint8_t *buf, size_t size) {
+    TINY_GSM_LOCK(at);
     TINY_GSM_YIELD();
     at->maintain();
     size_t cnt = 0;  
@@ -184,7 +203,7 @@ public:
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
 
 private:
-  TinyGsmMC20*  at;
+  TinyGsmMC20T* at;
   uint8_t       mux;
   uint16_t      sock_available;
   bool          sock_connected;
@@ -204,47 +223,51 @@ class GsmClientSecure : public GsmClient
 public:
   GsmClientSecure() {}
 
-  GsmClientSecure(TinyGsmMC20& modem, uint8_t mux = 0)
+  GsmClientSecure(TinyGsmMC20T& modem, uint8_t mux = 0)
     : GsmClient(modem, mux)
   {}
 
 public:
   virtual int connect(const char *host, uint16_t port) {
-    stop();
+    TINY_GSM_LOCK(this->at);
+    this->stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, true);
-    return sock_connected;
+    this->rx.clear();
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, true);
+    return this->sock_connected;
   }
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
-    at->sendAT(GF("+QSSLCLOSE="), mux);
-    sock_connected = false;
-    at->waitResponse(GF("CLOSE OK"));
-    rx.clear();
+    this->at->sendAT(GF("+QSSLCLOSE="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse(GF("CLOSE OK"));
+    this->rx.clear();
   }
 
   virtual size_t write(const uint8_t *buf, size_t size) {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
-    at->maintain();
-    return at->modemSend(buf, size, mux, true);
+    this->at->maintain();
+    return this->at->modemSend(buf, size, this->mux, true);
   }
 
   virtual int read(uint8_t *buf, size_t size) {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
     size_t cnt = 0;
     while (cnt < size) {
-      size_t chunk = TinyGsmMin(size-cnt, rx.size());
+      size_t chunk = TinyGsmMin(size-cnt, this->rx.size());
       if (chunk > 0) {
-        rx.get(buf, chunk);
+        this->rx.get(buf, chunk);
         buf += chunk;
         cnt += chunk;
         continue;
       }
 
-      if (!rx.size() && sock_connected) {
-        at->maintain();
+      if (!this->rx.size() && this->sock_connected) {
+        this->at->maintain();
         //break;
       }
     }
@@ -260,11 +283,12 @@ public:
   }
 
   virtual int available() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
-    if (!rx.size() && sock_connected) {
-      at->maintain();
+    if (!this->rx.size() && this->sock_connected) {
+      this->at->maintain();
     }
-    return rx.size();
+    return this->rx.size();
   }
 };
 
@@ -277,9 +301,9 @@ public:
 public:
 
 #ifdef GSM_DEFAULT_STREAM
-  TinyGsmMC20(Stream& stream = GSM_DEFAULT_STREAM)
+  TinyGsmMC20T(StreamT& stream = GSM_DEFAULT_STREAM)
 #else
-  TinyGsmMC20(Stream& stream)
+  TinyGsmMC20T(StreamT& stream)
 #endif
     : stream(stream)
   {
@@ -314,12 +338,14 @@ public:
     if (waitResponse() != 1) return false;
 
     sendAT(GF("+QINDI=1"));
+    stream.flush();
 
     return true;
   }
 
   void setBaud(unsigned long baud) {
     sendAT(GF("+IPR="), baud);
+    stream.flush();  // Out before the caller changes the port speed
   }
 
   bool testAT(unsigned long timeout = 10000L) {
@@ -335,6 +361,7 @@ public:
   }
 
   void maintain(bool ssl = false) {
+    TINY_GSM_LOCK(this);
     if (!ssl) {
        for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
         GsmClient* sock = sockets[mux];
@@ -345,7 +372,7 @@ public:
       }
     }
 
-    while (stream.available()) {
+    while (streamAvailable()) {
       waitResponse(10, NULL, NULL);
     }
   }
@@ -359,6 +386,14 @@ public:
     return waitResponse() == 1;
   }
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
+  String getModemName() {
+    return "Quectel MC20";
+  }
+
+TINY_GSM_MODEM_READ_NAME_CONSTANT()
+
   String getModemInfo() {
     sendAT(GF("I"));
     String res;
@@ -372,7 +407,7 @@ public:
   }
 
   bool hasSSL() {
-    return true; // TODO Use an AT command to verify?
+    return Traits::has_ssl;
   }
 
   /*
@@ -380,6 +415,7 @@ public:
    */
 
   bool restart() {
+    invalidateIdentity();
     if (!testAT()) {
       TINY_GSM_DEBUG.println("Modem seems to be off. Turn on and try again.");
       return false;
@@ -393,6 +429,7 @@ public:
   }
 
   bool poweroff(bool emergency = true) {
+    invalidateIdentity();
     int rsp;
     int mode = emergency ? 0 : 1;
     sendAT(GF("+QPOWD="), mode);
@@ -440,6 +477,8 @@ public:
     return res;
   }
 
+TINY_GSM_MODEM_IDENTITY()
+
   SimStatus getSimStatus(unsigned long timeout = 10000L) {
     for (unsigned long start = millis(); millis() - start < timeout; ) {
       sendAT(GF("+CPIN?"));
@@ -749,8 +788,8 @@ protected:
     size_t len = stream.readStringUntil('\n').toInt();
 
     for (size_t i=0; i<len; i++) {
-      while (!stream.available()) { TINY_GSM_YIELD(); }
-      char c = stream.read();
+      while (!streamAvailable()) { TINY_GSM_YIELD(); }
+      char c = streamRead();
       sockets[mux]->rx.put(c);
     }
 
@@ -821,14 +860,22 @@ public:
     streamWrite(tail...);
   }
 
+  int streamAvailable() {
+    return TinyGsmPort<StreamT>::available(stream);
+  }
+
+  int streamRead() {
+    return TinyGsmPort<StreamT>::read(stream);
+  }
+
   bool streamSkipUntil(char c) {
     const unsigned long timeout = 1000L;
     unsigned long startMillis = millis();
     while (millis() - startMillis < timeout) {
-      while (millis() - startMillis < timeout && !stream.available()) {
+      while (millis() - startMillis < timeout && !streamAvailable()) {
         TINY_GSM_YIELD();
       }
-      if (stream.read() == c)
+      if (streamRead() == c)
         return true;
     }
     return false;
@@ -858,8 +905,8 @@ public:
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
         if (r1 && data.endsWith(r1)) {
@@ -960,10 +1007,13 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
+  TINY_GSM_MODEM_MUTEX()
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
 };
 
+typedef TinyGsmMC20T<Stream> TinyGsmMC20;
+
 #endif
@@ -19,6 +19,7 @@
 #define TINY_GSM_MUX_COUNT 8
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -45,88 +46,102 @@ enum TinyGSMDateTimeFormat {
   DATE_DATE = 2
 };
 
-class TinyGsmSim7000
+template <class StreamT = Stream>
+class TinyGsmSim7000T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmSim7000T Modem;
+    static constexpr bool     has_modem_fifo = true;
+    static constexpr bool     reliable_urc   = false;
+    static constexpr uint16_t max_segment    = 1460;
+    static constexpr uint16_t max_read       = 1460;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = false;  // TODO:  Module supports SSL, but not yet implemented
+    static constexpr bool     has_gps        = true;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmSim7000;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmSim7000T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmSim7000& modem, uint8_t mux = 1) {
+  GsmClient(TinyGsmSim7000T& modem, uint8_t mux = 1) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmSim7000* modem, uint8_t mux = 1) {
+  bool init(TinyGsmSim7000T* modem, uint8_t mux = 1) {
     this->at = modem;
     this->mux = mux;
-    sock_available = 0;
-    prev_check = 0;
-    sock_connected = false;
-    got_data = false;
+    this->sock_available = 0;
+    this->prev_check = 0;
+    this->sock_connected = false;
+    this->got_data = false;
 
-    at->sockets[mux] = this;
+    this->at->sockets[this->mux] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, false, timeout_s);
-    return sock_connected;
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, false, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
+
+  // Sends the open command and returns at once; connecting() stays true
+  // until the modem reports the outcome, then connected() tells which
+  virtual int connectAsync(const char *host, uint16_t port) {
+    TINY_GSM_LOCK(this->at);
+    stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    return this->at->modemConnectStart(host, port, this->mux, false);
+  }
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
     // Read and dump anything remaining in the modem's internal buffer.
     // The socket will appear open in response to connected() even after it
     // closes until all data is read from the buffer.
     // Doing it this way allows the external mcu to find and get all of the data
     // that it wants from the socket even if it was closed externally.
-    rx.clear();
-    at->maintain();
-    while (sock_available > 0) {
-      at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux);
-      rx.clear();
-      at->maintain();
-    }
-    at->sendAT(GF("+CIPCLOSE="), mux);
-    sock_connected = false;
-    at->waitResponse();
+    this->rx.clear();
+    this->at->maintain();
+    while (this->sock_available > 0) {
+      this->at->modemRead(TinyGsmMin((uint16_t)this->rx.free(), this->sock_available), this->mux);
+      this->rx.clear();
+      this->at->maintain();
+    }
+    this->rx.clear();  // maintain() may have read ahead into it
+    this->sock_connecting = false;
+    this->at->sendAT(GF("+CIPCLOSE="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse();
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_READ_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
-
-private:
-  TinyGsmSim7000* at;
-  uint8_t         mux;
-  uint16_t        sock_available;
-  uint32_t        prev_check;
-  bool            sock_connected;
-  bool            got_data;
-  RxFifo          rx;
 };
 
 
@@ -135,25 +150,121 @@ class GsmClientSecure : public GsmClient
 public:
   GsmClientSecure() {}
 
-  GsmClientSecure(TinyGsmSim7000& modem, uint8_t mux = 1)
+  GsmClientSecure(TinyGsmSim7000T& modem, uint8_t mux = 1)
     : GsmClient(modem, mux)
   {}
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
+    this->stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, true, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
+  }
+
+  // Sends the open command and returns at once; connecting() stays true
+  // until the modem reports the outcome, then connected() tells which
+  virtual int connectAsync(const char *host, uint16_t port) {
+    TINY_GSM_LOCK(this->at);
+    this->stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    return this->at->modemConnectStart(host, port, this->mux, true);
+  }
+};
+
+
+class GsmClientTransparent : public Client
+{
+  friend class TinyGsmSim7000T;
+
+public:
+  GsmClientTransparent() {}
+
+  GsmClientTransparent(TinyGsmSim7000T& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmSim7000T* modem) {
+    this->at = modem;
+    sock_connected = false;
+    data_mode = false;
+
+    return true;
+  }
+
+public:
+  virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, true, timeout_s);
+    sock_connected = at->modemConnectTransparent(host, port, timeout_s);
+    data_mode = sock_connected;
     return sock_connected;
   }
+
+TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+
+  virtual void stop() {
+    TINY_GSM_LOCK(this->at);
+    TINY_GSM_YIELD();
+    trailerReset();
+    pause();
+    at->sendAT(GF("+CIPCLOSE"));
+    sock_connected = false;
+    data_mode = false;
+    at->waitResponse();
+  }
+
+TINY_GSM_CLIENT_TRANSPARENT(GSM_NL "CLOSED" GSM_NL)
+
+private:
+  TinyGsmSim7000T* at;
+  TINY_GSM_FLAG(sock_connected);
+  TINY_GSM_FLAG(data_mode);
+};
+
+
+class GsmHttp
+{
+  friend class TinyGsmSim7000T;
+
+public:
+  GsmHttp() {}
+
+  GsmHttp(TinyGsmSim7000T& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmSim7000T* modem) {
+    this->at = modem;
+    status_code = 0;
+    content_length = 0;
+    read_pos = 0;
+
+    return true;
+  }
+
+public:
+TINY_GSM_HTTP_REQUESTS()
+
+private:
+  TinyGsmSim7000T* at;
+  int             status_code;
+  uint32_t        content_length;
+  uint32_t        read_pos;
 };
 
 
 public:
 
-  TinyGsmSim7000(Stream& stream)
-    : stream(stream)
+  TinyGsmSim7000T(StreamT& stream)
+    : stream(stream), transparentMode(false)
   {
     memset(sockets, 0, sizeof(sockets));
   }
@@ -181,12 +292,19 @@ public:
   }
 
   String getModemName() {
-    String name =  "SIMCom SIM7000";
+    String name;
+    if (!readModemName(name)) {
+      name = "SIMCom SIM7000";
+    }
+    return name;
+  }
 
+  // The +GMM answer, false if the modem gave none
+  bool readModemName(String& name) {
     sendAT(GF("+GMM"));
     String res2;
     if (waitResponse(1000L, res2) != 1) {
-      return name;
+      return false;
     }
     res2.replace(GSM_NL "OK" GSM_NL, "");
     res2.replace("_", " ");
@@ -194,15 +312,19 @@ public:
 
     name = res2;
     DBG("### Modem:", name);
-    return name;
+    return true;
   }
 
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 
+TINY_GSM_MODEM_POLL()
+
   bool factoryDefault() {  // these commands aren't supported
     return false;
   }
@@ -210,7 +332,7 @@ TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-    return false;  // TODO:  Module supports SSL, but not yet implemented
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -226,6 +348,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -248,6 +372,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+CPOWD=1"));
     return waitResponse(GF("NORMAL POWER DOWN")) == 1;
   }
@@ -311,6 +437,10 @@ TINY_GSM_MODEM_GET_OPERATOR_COPS()
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CGREG, true)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     return (s == REG_OK_HOME || s == REG_OK_ROAMING);
@@ -363,6 +493,12 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
    * GPRS functions
    */
 
+  // Select single-connection transparent mode (GsmClientTransparent) instead
+  // of multi-socket mode (GsmClient) for the next gprsConnect()
+  void setTransparentMode(bool enable) {
+    transparentMode = enable;
+  }
+
   bool gprsConnect(const char* apn, const char* user = NULL, const char* pwd = NULL) {
     gprsDisconnect();
 
@@ -405,22 +541,29 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
 
     // TODO: wait AT+CGATT?
 
-    // Set to multi-IP
-    sendAT(GF("+CIPMUX=1"));
+    // Set to multi-IP, or to a single connection for transparent mode
+    sendAT(GF("+CIPMUX="), !transparentMode);
     if (waitResponse() != 1) {
       return false;
     }
 
-    // Put in "quick send" mode (thus no extra "Send OK")
-    sendAT(GF("+CIPQSEND=1"));
+    sendAT(GF("+CIPMODE="), transparentMode);
     if (waitResponse() != 1) {
       return false;
     }
 
-    // Set to get data manually
-    sendAT(GF("+CIPRXGET=1"));
-    if (waitResponse() != 1) {
-      return false;
+    if (!transparentMode) {
+      // Put in "quick send" mode (thus no extra "Send OK")
+      sendAT(GF("+CIPQSEND=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
+
+      // Set to get data manually
+      sendAT(GF("+CIPRXGET=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
     }
 
     // Start Task and Set APN, USER NAME, PASSWORD
@@ -796,6 +939,80 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
 
   float getTemperature() TINY_GSM_ATTR_NOT_AVAILABLE;
 
+  /*
+   * HTTP functions
+   */
+
+protected:
+
+  int httpRequest(const char* url, bool post, const char* contentType,
+                  const uint8_t* body, size_t len, uint32_t timeout_ms,
+                  uint32_t* length)
+  {
+    *length = 0;
+    httpEnd();
+    sendAT(GF("+HTTPINIT"));
+    if (waitResponse() != 1) {
+      return 0;
+    }
+    sendAT(GF("+HTTPPARA=\"CID\",1"));  // The bearer opened by gprsConnect
+    waitResponse();
+    sendAT(GF("+HTTPPARA=\"URL\",\""), url, '"');
+    if (waitResponse() != 1) {
+      return 0;
+    }
+    bool https = strncmp(url, "https", 5) == 0;
+    sendAT(GF("+HTTPSSL="), https);
+    if (waitResponse() != 1 && https) {
+      return 0;
+    }
+    if (post) {
+      if (contentType) {
+        sendAT(GF("+HTTPPARA=\"CONTENT\",\""), contentType, '"');
+        waitResponse();
+      }
+      sendAT(GF("+HTTPDATA="), len, GF(",10000"));
+      if (waitResponse(GF("DOWNLOAD")) != 1) {
+        return 0;
+      }
+      stream.write(body, len);
+      stream.flush();
+      if (waitResponse(10000L) != 1) {
+        return 0;
+      }
+    }
+    sendAT(GF("+HTTPACTION="), post ? 1 : 0);
+    if (waitResponse() != 1) {
+      return 0;
+    }
+    // +HTTPACTION: <method>,<status>,<length>
+    if (waitResponse(timeout_ms, GF(GSM_NL "+HTTPACTION:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(',');  // Skip method
+    int status = stream.readStringUntil(',').toInt();
+    *length = stream.readStringUntil('\n').toInt();
+    DBG("### HTTP:", status, "length", *length);
+    return status;
+  }
+
+  size_t httpRead(Print& sink, uint32_t pos, size_t len) {
+    len = TinyGsmMin(len, (size_t)TINY_GSM_HTTP_CHUNK);
+    sendAT(GF("+HTTPREAD="), pos, ',', len);
+    if (waitResponse(GF("+HTTPREAD:")) != 1) {
+      return 0;
+    }
+    size_t n = stream.readStringUntil('\n').toInt();
+    size_t copied = streamCopy(sink, n);
+    waitResponse();
+    return copied;
+  }
+
+  bool httpEnd() {
+    sendAT(GF("+HTTPTERM"));
+    return waitResponse() == 1;
+  }
+
   /*
    * Client related functions
    */
@@ -805,19 +1022,44 @@ protected:
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
                     bool ssl = false, int timeout_s = 75)
  {
-    int rsp;
-    uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    if (!modemConnectStart(host, port, mux, ssl)) {
+      return false;
+    }
+    return modemConnectWait(mux, ((uint32_t)timeout_s)*1000);
+  }
+
+  // Sends +CIPSTART; "<mux>, CONNECT OK" or "<mux>, CONNECT FAIL" follows
+  // once the connection is up or has failed
+  bool modemConnectStart(const char* host, uint16_t port, uint8_t mux,
+                         bool ssl = false)
+  {
+    sockets[mux]->sock_connecting = true;
     sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port);
-    rsp = waitResponse(timeout_ms,
-                       GF("CONNECT OK" GSM_NL),
-                       GF("CONNECT FAIL" GSM_NL),
-                       GF("ALREADY CONNECT" GSM_NL),
-                       GF("ERROR" GSM_NL),
-                       GF("CLOSE OK" GSM_NL)   // Happens when HTTPS handshake fails
-                      );
+    if (waitResponse() != 1) {
+      sockets[mux]->sock_connecting = false;
+      return false;
+    }
+    return true;
+  }
+
+TINY_GSM_MODEM_CONNECT_WAIT()
+
+TINY_GSM_MODEM_CONNECT_RESULT_CIPSTART()
+
+  bool modemConnectTransparent(const char* host, uint16_t port, int timeout_s = 75) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    sendAT(GF("+CIPSTART="), GF("\"TCP"), GF("\",\""), host, GF("\","), port);
+    int rsp = waitResponse(timeout_ms,
+                           GF(GSM_NL "CONNECT" GSM_NL),
+                           GF("CONNECT FAIL" GSM_NL),
+                           GF("ALREADY CONNECT" GSM_NL),
+                           GF("ERROR" GSM_NL)
+                          );
     return (1 == rsp);
   }
 
+TINY_GSM_MODEM_DATA_MODE_SWITCH()
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', len);
     if (waitResponse(GF(">")) != 1) {
@@ -832,6 +1074,8 @@ protected:
     return stream.readStringUntil('\n').toInt();
   }
 
+TINY_GSM_MODEM_PREFETCH()
+
   size_t modemRead(size_t size, uint8_t mux) {
 #ifdef TINY_GSM_USE_HEX
     sendAT(GF("+CIPRXGET=3,"), mux, ',', size);
@@ -855,14 +1099,14 @@ protected:
     for (size_t i=0; i<len_requested; i++) {
       uint32_t startMillis = millis();
 #ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
+      while (streamAvailable() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
       char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
+      buf[0] = streamRead();
+      buf[1] = streamRead();
       char c = strtol(buf, NULL, 16);
 #else
-      while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char c = stream.read();
+      while (!streamAvailable() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
+      char c = streamRead();
 #endif
       sockets[mux]->rx.put(c);
     }
@@ -920,11 +1164,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && (modemConnectResult(data) || modemStatusUrc(data))) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -973,6 +1219,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -999,10 +1246,13 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  bool          transparentMode;
 };
 
+typedef TinyGsmSim7000T<Stream> TinyGsmSim7000;
+
 #endif
@@ -20,6 +20,7 @@
 #define TINY_GSM_MUX_COUNT 5
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -46,88 +47,106 @@ enum TinyGSMDateTimeFormat {
   DATE_DATE = 2
 };
 
-class TinyGsmSim800
+template <class StreamT = Stream>
+class TinyGsmSim800T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmSim800T Modem;
+    static constexpr bool     has_modem_fifo = true;
+    static constexpr bool     reliable_urc   = false;
+    static constexpr uint16_t max_segment    = 1460;
+    static constexpr uint16_t max_read       = 1460;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+#if defined(TINY_GSM_MODEM_SIM900)
+    static constexpr bool     has_ssl        = false;
+#else
+    static constexpr bool     has_ssl        = true;
+#endif
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmSim800;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmSim800T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmSim800& modem, uint8_t mux = 1) {
+  GsmClient(TinyGsmSim800T& modem, uint8_t mux = 1) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmSim800* modem, uint8_t mux = 1) {
+  bool init(TinyGsmSim800T* modem, uint8_t mux = 1) {
     this->at = modem;
     this->mux = mux;
-    sock_available = 0;
-    prev_check = 0;
-    sock_connected = false;
-    got_data = false;
+    this->sock_available = 0;
+    this->prev_check = 0;
+    this->sock_connected = false;
+    this->got_data = false;
 
-    at->sockets[mux] = this;
+    this->at->sockets[this->mux] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, false, timeout_s);
-    return sock_connected;
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, false, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
+
+  // Sends the open command and returns at once; connecting() stays true
+  // until the modem reports the outcome, then connected() tells which
+  virtual int connectAsync(const char *host, uint16_t port) {
+    TINY_GSM_LOCK(this->at);
+    stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    return this->at->modemConnectStart(host, port, this->mux, false);
+  }
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
     // Read and dump anything remaining in the modem's internal buffer.
     // The socket will appear open in response to connected() even after it
     // closes until all data is read from the buffer.
     // Doing it this way allows the external mcu to find and get all of the data
     // that it wants from the socket even if it was closed externally.
-    rx.clear();
-    at->maintain();
-    while (sock_available > 0) {
-      at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux);
-      rx.clear();
-      at->maintain();
-    }
-    at->sendAT(GF("+CIPCLOSE="), mux, GF(",1"));  // Quick close
-    sock_connected = false;
-    at->waitResponse();
+    this->rx.clear();
+    this->at->maintain();
+    while (this->sock_available > 0) {
+      this->at->modemRead(TinyGsmMin((uint16_t)this->rx.free(), this->sock_available), this->mux);
+      this->rx.clear();
+      this->at->maintain();
+    }
+    this->rx.clear();  // maintain() may have read ahead into it
+    this->sock_connecting = false;
+    this->at->sendAT(GF("+CIPCLOSE="), this->mux, GF(",1"));  // Quick close
+    this->sock_connected = false;
+    this->at->waitResponse();
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_READ_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
-
-private:
-  TinyGsmSim800*  at;
-  uint8_t         mux;
-  uint16_t        sock_available;
-  uint32_t        prev_check;
-  bool            sock_connected;
-  bool            got_data;
-  RxFifo          rx;
 };
 
 
@@ -136,25 +155,121 @@ class GsmClientSecure : public GsmClient
 public:
   GsmClientSecure() {}
 
-  GsmClientSecure(TinyGsmSim800& modem, uint8_t mux = 1)
+  GsmClientSecure(TinyGsmSim800T& modem, uint8_t mux = 1)
     : GsmClient(modem, mux)
   {}
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
+    this->stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, true, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
+  }
+
+  // Sends the open command and returns at once; connecting() stays true
+  // until the modem reports the outcome, then connected() tells which
+  virtual int connectAsync(const char *host, uint16_t port) {
+    TINY_GSM_LOCK(this->at);
+    this->stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    return this->at->modemConnectStart(host, port, this->mux, true);
+  }
+};
+
+
+class GsmClientTransparent : public Client
+{
+  friend class TinyGsmSim800T;
+
+public:
+  GsmClientTransparent() {}
+
+  GsmClientTransparent(TinyGsmSim800T& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmSim800T* modem) {
+    this->at = modem;
+    sock_connected = false;
+    data_mode = false;
+
+    return true;
+  }
+
+public:
+  virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, true, timeout_s);
+    sock_connected = at->modemConnectTransparent(host, port, timeout_s);
+    data_mode = sock_connected;
     return sock_connected;
   }
+
+TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+
+  virtual void stop() {
+    TINY_GSM_LOCK(this->at);
+    TINY_GSM_YIELD();
+    trailerReset();
+    pause();
+    at->sendAT(GF("+CIPCLOSE=1"));  // Quick close
+    sock_connected = false;
+    data_mode = false;
+    at->waitResponse();
+  }
+
+TINY_GSM_CLIENT_TRANSPARENT(GSM_NL "CLOSED" GSM_NL)
+
+private:
+  TinyGsmSim800T* at;
+  TINY_GSM_FLAG(sock_connected);
+  TINY_GSM_FLAG(data_mode);
 };
 
 
+class GsmHttp
+{
+  friend class TinyGsmSim800T;
+
+public:
+  GsmHttp() {}
+
+  GsmHttp(TinyGsmSim800T& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmSim800T* modem) {
+    this->at = modem;
+    status_code = 0;
+    content_length = 0;
+    read_pos = 0;
+
+    return true;
+  }
+
 public:
+TINY_GSM_HTTP_REQUESTS()
+
+private:
+  TinyGsmSim800T* at;
+  int             status_code;
+  uint32_t        content_length;
+  uint32_t        read_pos;
+};
+
 
-  TinyGsmSim800(Stream& stream)
-    : stream(stream)
+public:
+
+  TinyGsmSim800T(StreamT& stream)
+    : stream(stream), transparentMode(false), download_state(-1)
   {
     memset(sockets, 0, sizeof(sockets));
   }
@@ -185,6 +300,9 @@ public:
 
   String getModemName() {
     String name = "";
+    if (readModemName(name)) {
+      return name;
+    }
     #if defined(TINY_GSM_MODEM_SIM800)
       name = "SIMCom SIM800";
     #elif defined(TINY_GSM_MODEM_SIM808)
@@ -194,11 +312,15 @@ public:
     #elif defined(TINY_GSM_MODEM_SIM900)
       name = "SIMCom SIM900";
     #endif
+    return name;
+  }
 
+  // The +GMM answer, false if the modem gave none
+  bool readModemName(String& name) {
     sendAT(GF("+GMM"));
     String res2;
     if (waitResponse(1000L, res2) != 1) {
-      return name;
+      return false;
     }
     res2.replace(GSM_NL "OK" GSM_NL, "");
     res2.replace("_", " ");
@@ -206,15 +328,19 @@ public:
 
     name = res2;
     DBG("### Modem:", name);
-    return name;
+    return true;
   }
 
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 
+TINY_GSM_MODEM_POLL()
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -233,15 +359,7 @@ TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-#if defined(TINY_GSM_MODEM_SIM900)
-    return false;
-#else
-    sendAT(GF("+CIPSSL=?"));
-    if (waitResponse(GF(GSM_NL "+CIPSSL:")) != 1) {
-      return false;
-    }
-    return waitResponse() == 1;
-#endif
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -257,6 +375,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -281,6 +401,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+CPOWD=1"));
     return waitResponse(10000L, GF("NORMAL POWER DOWN")) == 1;
   }
@@ -343,6 +465,10 @@ TINY_GSM_MODEM_GET_OPERATOR_COPS()
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CREG, true)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     return (s == REG_OK_HOME || s == REG_OK_ROAMING);
@@ -354,6 +480,12 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
    * GPRS functions
    */
 
+  // Select single-connection transparent mode (GsmClientTransparent) instead
+  // of multi-socket mode (GsmClient) for the next gprsConnect()
+  void setTransparentMode(bool enable) {
+    transparentMode = enable;
+  }
+
   bool gprsConnect(const char* apn, const char* user = NULL, const char* pwd = NULL) {
     gprsDisconnect();
 
@@ -396,22 +528,29 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
 
     // TODO: wait AT+CGATT?
 
-    // Set to multi-IP
-    sendAT(GF("+CIPMUX=1"));
+    // Set to multi-IP, or to a single connection for transparent mode
+    sendAT(GF("+CIPMUX="), !transparentMode);
     if (waitResponse() != 1) {
       return false;
     }
 
-    // Put in "quick send" mode (thus no extra "Send OK")
-    sendAT(GF("+CIPQSEND=1"));
+    sendAT(GF("+CIPMODE="), transparentMode);
     if (waitResponse() != 1) {
       return false;
     }
 
-    // Set to get data manually
-    sendAT(GF("+CIPRXGET=1"));
-    if (waitResponse() != 1) {
-      return false;
+    if (!transparentMode) {
+      // Put in "quick send" mode (thus no extra "Send OK")
+      sendAT(GF("+CIPQSEND=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
+
+      // Set to get data manually
+      sendAT(GF("+CIPRXGET=1"));
+      if (waitResponse() != 1) {
+        return false;
+      }
     }
 
     // Start Task and Set APN, USER NAME, PASSWORD
@@ -717,6 +856,219 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
 
   float getTemperature() TINY_GSM_ATTR_NOT_AVAILABLE;
 
+#if !defined(TINY_GSM_MODEM_SIM900)
+
+  /*
+   * File system functions
+   */
+
+TINY_GSM_MODEM_FILE_ACCESS()
+
+  // Files live in C:\User\, one name per line
+  String fileList() {
+    sendAT(GF("+FSLS=C:\\User\\"));
+    String res;
+    if (waitResponse(5000L, res) != 1) {
+      return "";
+    }
+    res.replace(GSM_NL "OK" GSM_NL, "");
+    res.trim();
+    res.replace(GSM_NL, "\n");
+    return res;
+  }
+
+  uint32_t fileSize(const char* filename) {
+    sendAT(GF("+FSFLSIZE=C:\\User\\"), filename);
+    if (waitResponse(GF(GSM_NL "+FSFLSIZE:")) != 1) {
+      return 0;
+    }
+    uint32_t size = stream.readStringUntil('\n').toInt();
+    waitResponse();
+    return size;
+  }
+
+  // len must not run past the end of the file, the modem would pad it
+  size_t fileReadBlock(const char* filename, Print& sink, uint32_t offset, size_t len) {
+    len = TinyGsmMin(len, (size_t)10240);  // Largest single FSREAD
+    // Mode 1 reads from <position>
+    sendAT(GF("+FSREAD=C:\\User\\"), filename, GF(",1,"), len, ',', offset);
+    if (!streamSkipUntil('\n')) {
+      return 0;
+    }
+    // A missing file or bad offset answers ERROR instead of the data, so
+    // hold back the first bytes while they still look like one (a short
+    // block may take one byte of the line end along, which isn't data)
+    char head[11];
+    size_t held = 0;
+    while (held < sizeof(head)) {
+      if (stream.readBytes(head + held, 1) != 1) {
+        break;
+      }
+      held++;
+      bool error = held <= 6 && !memcmp(head, "ERROR\r", held);
+      bool cme = !memcmp(head, "+CME ERROR:", held);
+      if ((error && held == 6) || (cme && held == 11)) {
+        streamSkipUntil('\n');
+        DBG("### FSREAD failed:", filename, offset);
+        return 0;
+      }
+      if (!error && !cme) {
+        break;
+      }
+    }
+    held = TinyGsmMin(held, len);
+    sink.write((const uint8_t*)head, held);
+    size_t copied = held + streamCopy(sink, len - held, 10000L);
+    waitResponse();
+    return copied;
+  }
+
+  size_t fileWriteBlock(const char* filename, const uint8_t* data, size_t len, bool append) {
+    len = TinyGsmMin(len, (size_t)10240);  // Largest single FSWRITE
+    if (!append) {
+      fileDelete(filename);
+    }
+    sendAT(GF("+FSCREATE=C:\\User\\"), filename);  // Fails if it already exists
+    waitResponse();
+    // Mode 1 appends, the modem waits up to 10s for the data
+    sendAT(GF("+FSWRITE=C:\\User\\"), filename, GF(",1,"), len, GF(",10"));
+    if (waitResponse(GF(">")) != 1) {
+      return 0;
+    }
+    stream.write(data, len);
+    stream.flush();
+    return (waitResponse(10000L) == 1) ? len : 0;
+  }
+
+  bool fileDelete(const char* filename) {
+    sendAT(GF("+FSDEL=C:\\User\\"), filename);
+    return waitResponse() == 1;
+  }
+
+  /*
+   * File download functions
+   */
+
+TINY_GSM_MODEM_FILE_DOWNLOAD(0)
+
+  bool downloadBegin(const char* url, const char* filename) {
+    download_state = -1;
+    httpEnd();
+    sendAT(GF("+HTTPINIT"));
+    if (waitResponse() != 1) {
+      return false;
+    }
+    sendAT(GF("+HTTPPARA=\"CID\",1"));
+    waitResponse();
+    bool https = strncmp(url, "https", 5) == 0;
+    sendAT(GF("+HTTPSSL="), https);
+    if (waitResponse() != 1 && https) {
+      return false;
+    }
+    fileDelete(filename);  // Don't append to an old copy
+    sendAT(GF("+HTTPTOFS=\""), url, GF("\",\"C:\\User\\"), filename, '"');
+    if (waitResponse() != 1) {
+      return false;
+    }
+    download_state = 0;
+    return true;
+  }
+
+  // 1 when complete, 0 while in progress, -1 on failure
+  int8_t downloadStatus(const char* filename, uint32_t* done, uint32_t* total) {
+    if (download_state != 0) {
+      *done = *total = (download_state > 0) ? fileSize(filename) : 0;
+      return download_state;
+    }
+    // +HTTPTOFSRL: <state>,<current length>,<total length>
+    sendAT(GF("+HTTPTOFSRL?"));
+    if (waitResponse(GF(GSM_NL "+HTTPTOFSRL:")) == 1) {
+      streamSkipUntil(',');
+      *done = stream.readStringUntil(',').toInt();
+      *total = stream.readStringUntil('\n').toInt();
+      waitResponse();
+    }
+    return download_state;
+  }
+
+#endif
+
+  /*
+   * HTTP functions
+   */
+
+protected:
+
+  int httpRequest(const char* url, bool post, const char* contentType,
+                  const uint8_t* body, size_t len, uint32_t timeout_ms,
+                  uint32_t* length)
+  {
+    *length = 0;
+    httpEnd();
+    sendAT(GF("+HTTPINIT"));
+    if (waitResponse() != 1) {
+      return 0;
+    }
+    sendAT(GF("+HTTPPARA=\"CID\",1"));  // The bearer opened by gprsConnect
+    waitResponse();
+    sendAT(GF("+HTTPPARA=\"URL\",\""), url, '"');
+    if (waitResponse() != 1) {
+      return 0;
+    }
+#if !defined(TINY_GSM_MODEM_SIM900)
+    bool https = strncmp(url, "https", 5) == 0;
+    sendAT(GF("+HTTPSSL="), https);
+    if (waitResponse() != 1 && https) {
+      return 0;
+    }
+#endif
+    if (post) {
+      if (contentType) {
+        sendAT(GF("+HTTPPARA=\"CONTENT\",\""), contentType, '"');
+        waitResponse();
+      }
+      sendAT(GF("+HTTPDATA="), len, GF(",10000"));
+      if (waitResponse(GF("DOWNLOAD")) != 1) {
+        return 0;
+      }
+      stream.write(body, len);
+      stream.flush();
+      if (waitResponse(10000L) != 1) {
+        return 0;
+      }
+    }
+    sendAT(GF("+HTTPACTION="), post ? 1 : 0);
+    if (waitResponse() != 1) {
+      return 0;
+    }
+    // +HTTPACTION: <method>,<status>,<length>
+    if (waitResponse(timeout_ms, GF(GSM_NL "+HTTPACTION:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(',');  // Skip method
+    int status = stream.readStringUntil(',').toInt();
+    *length = stream.readStringUntil('\n').toInt();
+    DBG("### HTTP:", status, "length", *length);
+    return status;
+  }
+
+  size_t httpRead(Print& sink, uint32_t pos, size_t len) {
+    len = TinyGsmMin(len, (size_t)TINY_GSM_HTTP_CHUNK);
+    sendAT(GF("+HTTPREAD="), pos, ',', len);
+    if (waitResponse(GF("+HTTPREAD:")) != 1) {
+      return 0;
+    }
+    size_t n = stream.readStringUntil('\n').toInt();
+    size_t copied = streamCopy(sink, n);
+    waitResponse();
+    return copied;
+  }
+
+  bool httpEnd() {
+    sendAT(GF("+HTTPTERM"));
+    return waitResponse() == 1;
+  }
+
   /*
    * Client related functions
    */
@@ -726,26 +1078,51 @@ protected:
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
                     bool ssl = false, int timeout_s = 75)
  {
-    int rsp;
-    uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    if (!modemConnectStart(host, port, mux, ssl)) {
+      return false;
+    }
+    return modemConnectWait(mux, ((uint32_t)timeout_s)*1000);
+  }
+
+  // Sends +CIPSTART; "<mux>, CONNECT OK" or "<mux>, CONNECT FAIL" follows
+  // once the connection is up or has failed
+  bool modemConnectStart(const char* host, uint16_t port, uint8_t mux,
+                         bool ssl = false)
+  {
 #if !defined(TINY_GSM_MODEM_SIM900)
     sendAT(GF("+CIPSSL="), ssl);
-    rsp = waitResponse();
+    int rsp = waitResponse();
     if (ssl && rsp != 1) {
       return false;
     }
 #endif
+    sockets[mux]->sock_connecting = true;
     sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port);
-    rsp = waitResponse(timeout_ms,
-                       GF("CONNECT OK" GSM_NL),
-                       GF("CONNECT FAIL" GSM_NL),
-                       GF("ALREADY CONNECT" GSM_NL),
-                       GF("ERROR" GSM_NL),
-                       GF("CLOSE OK" GSM_NL)   // Happens when HTTPS handshake fails
-                      );
+    if (waitResponse() != 1) {
+      sockets[mux]->sock_connecting = false;
+      return false;
+    }
+    return true;
+  }
+
+TINY_GSM_MODEM_CONNECT_WAIT()
+
+TINY_GSM_MODEM_CONNECT_RESULT_CIPSTART()
+
+  bool modemConnectTransparent(const char* host, uint16_t port, int timeout_s = 75) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    sendAT(GF("+CIPSTART="), GF("\"TCP"), GF("\",\""), host, GF("\","), port);
+    int rsp = waitResponse(timeout_ms,
+                           GF(GSM_NL "CONNECT" GSM_NL),
+                           GF("CONNECT FAIL" GSM_NL),
+                           GF("ALREADY CONNECT" GSM_NL),
+                           GF("ERROR" GSM_NL)
+                          );
     return (1 == rsp);
   }
 
+TINY_GSM_MODEM_DATA_MODE_SWITCH()
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', len);
     if (waitResponse(GF(">")) != 1) {
@@ -760,6 +1137,8 @@ protected:
     return stream.readStringUntil('\n').toInt();
   }
 
+TINY_GSM_MODEM_PREFETCH()
+
   size_t modemRead(size_t size, uint8_t mux) {
 #ifdef TINY_GSM_USE_HEX
     sendAT(GF("+CIPRXGET=3,"), mux, ',', size);
@@ -783,14 +1162,14 @@ protected:
     for (size_t i=0; i<len_requested; i++) {
       uint32_t startMillis = millis();
 #ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
+      while (streamAvailable() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
       char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
+      buf[0] = streamRead();
+      buf[1] = streamRead();
       char c = strtol(buf, NULL, 16);
 #else
-      while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char c = stream.read();
+      while (!streamAvailable() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
+      char c = streamRead();
 #endif
       sockets[mux]->rx.put(c);
     }
@@ -850,11 +1229,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && (modemConnectResult(data) || modemStatusUrc(data))) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -899,10 +1280,17 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           }
           data = "";
           DBG("### Closed: ", mux);
+        } else if (data.endsWith(GF(GSM_NL "+HTTPTOFS:"))) {
+          int status = stream.readStringUntil(',').toInt();
+          streamSkipUntil('\n');
+          download_state = (status == 200) ? 1 : -1;
+          data = "";
+          DBG("### Download:", status);
         }
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -929,10 +1317,14 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  bool          transparentMode;
+  int8_t        download_state;
 };
 
+typedef TinyGsmSim800T<Stream> TinyGsmSim800;
+
 #endif
@@ -13,13 +13,18 @@
 #include <TinyGsmClientSIM800.h>
 
 
-class TinyGsmSim808: public TinyGsmSim800
+template <class StreamT = Stream>
+class TinyGsmSim808T: public TinyGsmSim800T<StreamT>
 {
 
 public:
 
-  TinyGsmSim808(Stream& stream)
-    : TinyGsmSim800(stream)
+  struct Traits : TinyGsmSim800T<StreamT>::Traits {
+    static constexpr bool     has_gps        = true;
+  };
+
+  TinyGsmSim808T(StreamT& stream)
+    : TinyGsmSim800T<StreamT>(stream)
   {}
 
   /*
@@ -30,8 +35,8 @@ public:
   bool enableGPS() {
     // uint16_t state;
 
-    sendAT(GF("+CGNSPWR=1"));
-    if (waitResponse() != 1) {
+    this->sendAT(GF("+CGNSPWR=1"));
+    if (this->waitResponse() != 1) {
       return false;
     }
 
@@ -41,8 +46,8 @@ public:
   bool disableGPS() {
     // uint16_t state;
 
-    sendAT(GF("+CGNSPWR=0"));
-    if (waitResponse() != 1) {
+    this->sendAT(GF("+CGNSPWR=0"));
+    if (this->waitResponse() != 1) {
       return false;
     }
 
@@ -52,12 +57,12 @@ public:
   // get the RAW GPS output
   // works only with ans SIM808 V2
   String getGPSraw() {
-    sendAT(GF("+CGNSINF"));
-    if (waitResponse(GF(GSM_NL "+CGNSINF:")) != 1) {
+    this->sendAT(GF("+CGNSINF"));
+    if (this->waitResponse(GF(GSM_NL "+CGNSINF:")) != 1) {
       return "";
     }
-    String res = stream.readStringUntil('\n');
-    waitResponse();
+    String res = this->stream.readStringUntil('\n');
+    this->waitResponse();
     res.trim();
     return res;
   }
@@ -69,30 +74,30 @@ public:
     // char chr_buffer[12];
     bool fix = false;
 
-    sendAT(GF("+CGNSINF"));
-    if (waitResponse(GF(GSM_NL "+CGNSINF:")) != 1) {
+    this->sendAT(GF("+CGNSINF"));
+    if (this->waitResponse(GF(GSM_NL "+CGNSINF:")) != 1) {
       return false;
     }
 
-    stream.readStringUntil(','); // mode
-    if ( stream.readStringUntil(',').toInt() == 1 ) fix = true;
-    stream.readStringUntil(','); //utctime
-    *lat =  stream.readStringUntil(',').toFloat(); //lat
-    *lon =  stream.readStringUntil(',').toFloat(); //lon
-    if (alt != NULL) *alt =  stream.readStringUntil(',').toFloat(); //lon
-    if (speed != NULL) *speed = stream.readStringUntil(',').toFloat(); //speed
-    stream.readStringUntil(',');
-    stream.readStringUntil(',');
-    stream.readStringUntil(',');
-    stream.readStringUntil(',');
-    stream.readStringUntil(',');
-    stream.readStringUntil(',');
-    stream.readStringUntil(',');
-    if (vsat != NULL) *vsat = stream.readStringUntil(',').toInt(); //viewed satelites
-    if (usat != NULL) *usat = stream.readStringUntil(',').toInt(); //used satelites
-    stream.readStringUntil('\n');
-
-    waitResponse();
+    this->stream.readStringUntil(','); // mode
+    if ( this->stream.readStringUntil(',').toInt() == 1 ) fix = true;
+    this->stream.readStringUntil(','); //utctime
+    *lat =  this->stream.readStringUntil(',').toFloat(); //lat
+    *lon =  this->stream.readStringUntil(',').toFloat(); //lon
+    if (alt != NULL) *alt =  this->stream.readStringUntil(',').toFloat(); //lon
+    if (speed != NULL) *speed = this->stream.readStringUntil(',').toFloat(); //speed
+    this->stream.readStringUntil(',');
+    this->stream.readStringUntil(',');
+    this->stream.readStringUntil(',');
+    this->stream.readStringUntil(',');
+    this->stream.readStringUntil(',');
+    this->stream.readStringUntil(',');
+    this->stream.readStringUntil(',');
+    if (vsat != NULL) *vsat = this->stream.readStringUntil(',').toInt(); //viewed satelites
+    if (usat != NULL) *usat = this->stream.readStringUntil(',').toInt(); //used satelites
+    this->stream.readStringUntil('\n');
+
+    this->waitResponse();
 
     return fix;
   }
@@ -102,13 +107,13 @@ public:
   bool getGPSTime(int *year, int *month, int *day, int *hour, int *minute, int *second) {
     bool fix = false;
     char chr_buffer[12];
-    sendAT(GF("+CGNSINF"));
-    if (waitResponse(GF(GSM_NL "+CGNSINF:")) != 1) {
+    this->sendAT(GF("+CGNSINF"));
+    if (this->waitResponse(GF(GSM_NL "+CGNSINF:")) != 1) {
       return false;
     }
 
     for (int i = 0; i < 3; i++) {
-      String buffer = stream.readStringUntil(',');
+      String buffer = this->stream.readStringUntil(',');
       buffer.toCharArray(chr_buffer, sizeof(chr_buffer));
       switch (i) {
         case 0:
@@ -135,8 +140,8 @@ public:
           break;
       }
     }
-    String res = stream.readStringUntil('\n');
-    waitResponse();
+    String res = this->stream.readStringUntil('\n');
+    this->waitResponse();
 
     if (fix) {
       return true;
@@ -147,4 +152,6 @@ public:
 
 };
 
+typedef TinyGsmSim808T<Stream> TinyGsmSim808;
+
 #endif
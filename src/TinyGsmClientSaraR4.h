@@ -19,6 +19,7 @@
 #define TINY_GSM_MUX_COUNT 7
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -41,95 +42,128 @@ enum RegStatus {
 };
 
 
-class TinyGsmSaraR4
+template <class StreamT = Stream>
+class TinyGsmSaraR4T
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmSaraR4T Modem;
+    static constexpr bool     has_modem_fifo = true;
+    static constexpr bool     reliable_urc   = false;
+    static constexpr uint16_t max_segment    = 1024;
+    static constexpr uint16_t max_read       = 1024;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = true;
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmSaraR4;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmSaraR4T;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmSaraR4& modem, uint8_t mux = 0) {
+  GsmClient(TinyGsmSaraR4T& modem, uint8_t mux = 0) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmSaraR4* modem, uint8_t mux = 0) {
+  bool init(TinyGsmSaraR4T* modem, uint8_t mux = 0) {
     this->at = modem;
     this->mux = mux;
-    sock_available = 0;
-    prev_check = 0;
-    sock_connected = false;
-    got_data = false;
+    this->sock_available = 0;
+    this->prev_check = 0;
+    this->sock_connected = false;
+    this->got_data = false;
 
-    at->sockets[mux] = this;
+    this->at->sockets[this->mux] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     stop();
     TINY_GSM_YIELD();
-    rx.clear();
+    this->rx.clear();
 
-    uint8_t oldMux = mux;
-    sock_connected = at->modemConnect(host, port, &mux, false, timeout_s);
-    if (mux != oldMux) {
-        DBG("WARNING:  Mux number changed from", oldMux, "to", mux);
-        at->sockets[oldMux] = NULL;
+    uint8_t oldMux = this->mux;
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, &this->mux, false, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    if (this->mux != oldMux) {
+        DBG("WARNING:  Mux number changed from", oldMux, "to", this->mux);
+        this->at->sockets[oldMux] = NULL;
     }
-    at->sockets[mux] = this;
-    at->maintain();
+    this->at->sockets[this->mux] = this;
+    this->at->maintain();
 
-    return sock_connected;
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
+
+  // Sends the open command and returns at once; connecting() stays true
+  // until the modem reports the outcome, then connected() tells which
+  virtual int connectAsync(const char *host, uint16_t port) {
+    return startConnect(host, port, false);
+  }
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
     // Read and dump anything remaining in the modem's internal buffer.
     // The socket will appear open in response to connected() even after it
     // closes until all data is read from the buffer.
     // Doing it this way allows the external mcu to find and get all of the data
     // that it wants from the socket even if it was closed externally.
-    rx.clear();
-    at->maintain();
-    while (sock_connected && sock_available > 0) {
-      at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux);
-      rx.clear();
-      at->maintain();
+    this->rx.clear();
+    this->at->maintain();
+    while (this->sock_connected && this->sock_available > 0) {
+      this->at->modemRead(TinyGsmMin((uint16_t)this->rx.free(), this->sock_available), this->mux);
+      this->rx.clear();
+      this->at->maintain();
     }
-    at->modemDisconnect(mux);
+    this->rx.clear();  // maintain() may have read ahead into it
+    this->sock_connecting = false;
+    this->at->modemDisconnect(this->mux);
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_READ_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
 
-private:
-  TinyGsmSaraR4*   at;
-  uint8_t         mux;
-  uint16_t        sock_available;
-  uint32_t        prev_check;
-  bool            sock_connected;
-  bool            got_data;
-  RxFifo          rx;
+protected:
+  int startConnect(const char *host, uint16_t port, bool ssl) {
+    TINY_GSM_LOCK(this->at);
+    stop();
+    TINY_GSM_YIELD();
+    this->rx.clear();
+    uint8_t oldMux = this->mux;
+    if (!this->at->modemCreateSocket(&this->mux, ssl)) {
+      return false;
+    }
+    if (this->mux != oldMux) {
+        DBG("WARNING:  Mux number changed from", oldMux, "to", this->mux);
+        this->at->sockets[oldMux] = NULL;
+    }
+    this->at->sockets[this->mux] = this;
+    this->sock_connecting = true;
+    TINY_GSM_METER(this, connectBegin());
+    if (!this->at->modemConnectStart(host, port, this->mux)) {
+      this->sock_connecting = false;
+      return false;
+    }
+    return true;
+  }
 };
 
 
@@ -138,32 +172,41 @@ class GsmClientSecure : public GsmClient
 public:
   GsmClientSecure() {}
 
-  GsmClientSecure(TinyGsmSaraR4& modem, uint8_t mux = 1)
+  GsmClientSecure(TinyGsmSaraR4T& modem, uint8_t mux = 1)
     : GsmClient(modem, mux)
   {}
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
-    stop();
+    TINY_GSM_LOCK(this->at);
+    this->stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    uint8_t oldMux = mux;
-    sock_connected = at->modemConnect(host, port, &mux, true, timeout_s);
-    if (mux != oldMux) {
-        DBG("WARNING:  Mux number changed from", oldMux, "to", mux);
-        at->sockets[oldMux] = NULL;
+    this->rx.clear();
+    uint8_t oldMux = this->mux;
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, &this->mux, true, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    if (this->mux != oldMux) {
+        DBG("WARNING:  Mux number changed from", oldMux, "to", this->mux);
+        this->at->sockets[oldMux] = NULL;
     }
-    at->sockets[mux] = this;
-    at->maintain();
-    return sock_connected;
+    this->at->sockets[this->mux] = this;
+    this->at->maintain();
+    return this->sock_connected;
+  }
+
+  // Sends the open command and returns at once; connecting() stays true
+  // until the modem reports the outcome, then connected() tells which
+  virtual int connectAsync(const char *host, uint16_t port) {
+    return this->startConnect(host, port, true);
   }
 };
 
 
 public:
 
-  TinyGsmSaraR4(Stream& stream)
-    : stream(stream)
+  TinyGsmSaraR4T(StreamT& stream)
+    : stream(stream), download_state(-1), download_body(0)
   {
     memset(sockets, 0, sizeof(sockets));
   }
@@ -193,7 +236,12 @@ public:
 #endif
     waitResponse();
 
+    // Only asked here to warn about the wrong driver
+#if TINY_GSM_IDENTITY_CACHE
+    getCachedModemName();
+#elif defined(TINY_GSM_DEBUG)
     getModemName();
+#endif
 
     int ret = getSimStatus();
     // if the sim isn't ready and a pin has been provided, try to unlock the sim
@@ -208,10 +256,19 @@ public:
   }
 
   String getModemName() {
+    String name;
+    if (!readModemName(name)) {
+      name = "u-blox Cellular Modem";
+    }
+    return name;
+  }
+
+  // Manufacturer and model, false if the modem didn't give both
+  bool readModemName(String& name) {
     sendAT(GF("+CGMI"));
     String res1;
     if (waitResponse(1000L, res1) != 1) {
-      return "u-blox Cellular Modem";
+      return false;
     }
     res1.replace(GSM_NL "OK" GSM_NL, "");
     res1.trim();
@@ -219,26 +276,30 @@ public:
     sendAT(GF("+GMM"));
     String res2;
     if (waitResponse(1000L, res2) != 1) {
-      return "u-blox Cellular Modem";
+      return false;
     }
     res2.replace(GSM_NL "OK" GSM_NL, "");
     res2.trim();
 
-    String name = res1 + String(' ') + res2;
+    name = res1 + String(' ') + res2;
     DBG("### Modem:", name);
     if (!name.startsWith("u-blox SARA-R4") && !name.startsWith("u-blox SARA-N4")) {
       DBG("### WARNING:  You are using the wrong TinyGSM modem!");
     }
 
-    return name;
+    return true;
   }
 
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
 TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 
+TINY_GSM_MODEM_POLL()
+
   bool factoryDefault() {
     sendAT(GF("&F"));  // Resets the current profile, other NVM not affected
     return waitResponse() == 1;
@@ -247,7 +308,7 @@ TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-    return true;
+    return Traits::has_ssl;
   }
 
   bool hasWifi() {
@@ -263,6 +324,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -275,6 +338,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+CPWROFF"));
     return waitResponse(40000L) == 1;
   }
@@ -339,6 +404,10 @@ TINY_GSM_MODEM_GET_OPERATOR_COPS()
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CEREG, false)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     if (s == REG_OK_HOME || s == REG_OK_ROAMING)
@@ -534,6 +603,22 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
     return temp;
   }
 
+  /*
+   * File system functions
+   */
+
+TINY_GSM_MODEM_FILE_ACCESS()
+
+TINY_GSM_MODEM_FILE_UBLOX()
+
+  /*
+   * File download functions
+   */
+
+TINY_GSM_MODEM_FILE_DOWNLOAD(download_body)
+
+TINY_GSM_MODEM_DOWNLOAD_UBLOX()
+
   /*
    * Client related functions
    */
@@ -544,6 +629,25 @@ protected:
                     bool ssl = false, int timeout_s = 120)
   {
     uint32_t timeout_ms = ((uint32_t)timeout_s)*1000;
+    if (!modemCreateSocket(mux, ssl)) {
+      return false;
+    }
+    // connect on the allocated socket
+    sendAT(GF("+USOCO="), *mux, ",\"", host, "\",", port);
+    int rsp = waitResponse(timeout_ms);
+    return (1 == rsp);
+  }
+
+  // Asynchronous +USOCO; the "+UUSOCO: <mux>,<err>" URC follows once the
+  // connection is up or has failed
+  bool modemConnectStart(const char* host, uint16_t port, uint8_t mux) {
+    sendAT(GF("+USOCO="), mux, ",\"", host, "\",", port, GF(",1"));
+    return waitResponse() == 1;
+  }
+
+  // Opens a socket for modemConnect() or modemConnectStart(); the modem picks
+  // its number
+  bool modemCreateSocket(uint8_t* mux, bool ssl) {
     sendAT(GF("+USOCR=6"));  // create a socket
     if (waitResponse(GF(GSM_NL "+USOCR:")) != 1) {  // reply is +USOCR: ## of socket created
       return false;
@@ -563,11 +667,7 @@ protected:
     // Enable KEEPALIVE, 30 sec
     //sendAT(GF("+USOSO="), *mux, GF(",6,2,30000"));
     //waitResponse();
-
-    // connect on the allocated socket
-    sendAT(GF("+USOCO="), *mux, ",\"", host, "\",", port);
-    int rsp = waitResponse(timeout_ms);
-    return (1 == rsp);
+    return true;
   }
 
   bool modemDisconnect(uint8_t mux) {
@@ -598,6 +698,8 @@ protected:
     return sent;
   }
 
+TINY_GSM_MODEM_PREFETCH()
+
   size_t modemRead(size_t size, uint8_t mux) {
     sendAT(GF("+USORD="), mux, ',', size);
     if (waitResponse(GF(GSM_NL "+USORD:")) != 1) {
@@ -688,11 +790,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && modemStatusUrc(data)) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -723,10 +827,29 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           }
           data = "";
           DBG("### URC Sock Closed:", mux);
+        } else if (data.endsWith(GF(GSM_NL "+UUSOCO:"))) {
+          int mux = stream.readStringUntil(',').toInt();
+          int err = stream.readStringUntil('\n').toInt();
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
+              sockets[mux]->sock_connecting) {
+            sockets[mux]->sock_connecting = false;
+            sockets[mux]->sock_connected = (err == 0);
+            TINY_GSM_METER(sockets[mux], connectEnd());
+          }
+          data = "";
+          DBG("### URC Sock Connect:", mux, err);
+        } else if (data.endsWith(GF(GSM_NL "+UUHTTPCR:"))) {
+          streamSkipUntil(',');  // Profile
+          streamSkipUntil(',');  // Command
+          int result = stream.readStringUntil('\n').toInt();
+          download_state = (result == 1) ? 1 : -1;
+          data = "";
+          DBG("### URC Download:", result);
         }
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -753,10 +876,14 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  int8_t        download_state;
+  uint32_t      download_body;
 };
 
+typedef TinyGsmSaraR4T<Stream> TinyGsmSaraR4;
+
 #endif
@@ -19,6 +19,7 @@
 #define TINY_GSM_MUX_COUNT 6
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmClientBase.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -50,90 +51,92 @@ enum SocketStatus {
 };
 
 
-class TinyGsmSequansMonarch
+template <class StreamT = Stream>
+class TinyGsmSequansMonarchT
 {
+  template <class, class> friend class TinyGsmClientBase;
 
 public:
 
-class GsmClient : public Client
+  // What the shared client code needs to know about this modem
+  struct Traits {
+    typedef TinyGsmSequansMonarchT Modem;
+    static constexpr bool     has_modem_fifo = true;
+    static constexpr bool     reliable_urc   = false;
+    static constexpr uint16_t max_segment    = 1500;
+    static constexpr uint16_t max_read       = 1500;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = true;
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
+class GsmClient : public TinyGsmClientBase<GsmClient, Traits>
 {
-  friend class TinyGsmSequansMonarch;
-  typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+  friend class TinyGsmSequansMonarchT;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmSequansMonarch& modem, uint8_t mux = 1) {
+  GsmClient(TinyGsmSequansMonarchT& modem, uint8_t mux = 1) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmSequansMonarch* modem, uint8_t mux = 1) {
+  bool init(TinyGsmSequansMonarchT* modem, uint8_t mux = 1) {
     this->at = modem;
     this->mux = mux;
-    sock_available = 0;
-    prev_check = 0;
-    sock_connected = false;
-    got_data = false;
+    this->sock_available = 0;
+    this->prev_check = 0;
+    this->sock_connected = false;
+    this->got_data = false;
 
-    // adjust for zero indexed socket array vs Sequans' 1 indexed mux numbers
+    // adjust for zero indexed socket array vs Sequans' 1 indexed this->mux numbers
     // using modulus will force 6 back to 0
-    at->sockets[mux % TINY_GSM_MUX_COUNT] = this;
+    this->at->sockets[this->mux % TINY_GSM_MUX_COUNT] = this;
 
     return true;
   }
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
-    if (sock_connected) stop();
+    TINY_GSM_LOCK(this->at);
+    if (this->sock_connected) stop();
     TINY_GSM_YIELD();
-    rx.clear();
-    sock_connected = at->modemConnect(host, port, mux, false, timeout_s);
-    return sock_connected;
+    this->rx.clear();
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, false, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 
-TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+  using TinyGsmClientBase<GsmClient, Traits>::connect;
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     TINY_GSM_YIELD();
     // Read and dump anything remaining in the modem's internal buffer.
     // The socket will appear open in response to connected() even after it
     // closes until all data is read from the buffer.
     // Doing it this way allows the external mcu to find and get all of the data
     // that it wants from the socket even if it was closed externally.
-    rx.clear();
-    at->maintain();
-    while (sock_available > 0) {
-      at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux);
-      rx.clear();
-      at->maintain();
+    this->rx.clear();
+    this->at->maintain();
+    while (this->sock_available > 0) {
+      this->at->modemRead(TinyGsmMin((uint16_t)this->rx.free(), this->sock_available), this->mux);
+      this->rx.clear();
+      this->at->maintain();
     }
-    at->sendAT(GF("+SQNSH="), mux);
-    sock_connected = false;
-    at->waitResponse();
+    this->rx.clear();  // maintain() may have read ahead into it
+    this->at->sendAT(GF("+SQNSH="), this->mux);
+    this->sock_connected = false;
+    this->at->waitResponse();
   }
 
-TINY_GSM_CLIENT_WRITE()
-
-TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_READ_WITH_BUFFER_CHECK()
-
-TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED()
-
   /*
    * Extended API
    */
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
-
-private:
-  TinyGsmSequansMonarch* at;
-  uint8_t         mux;
-  uint16_t        sock_available;
-  uint32_t        prev_check;
-  bool            sock_connected;
-  bool            got_data;
-  RxFifo          rx;
 };
 
 
@@ -142,7 +145,7 @@ class GsmClientSecure : public GsmClient
 public:
   GsmClientSecure() {}
 
-  GsmClientSecure(TinyGsmSequansMonarch& modem, uint8_t mux = 1)
+  GsmClientSecure(TinyGsmSequansMonarchT& modem, uint8_t mux = 1)
     : GsmClient(modem, mux)
   {}
 
@@ -151,29 +154,32 @@ protected:
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
-    stop();
+    TINY_GSM_LOCK(this->at);
+    this->stop();
     TINY_GSM_YIELD();
-    rx.clear();
+    this->rx.clear();
 
     // configure security profile 1 with parameters:
     if (strictSSL) {
       // require minimum of TLS 1.2 (3)
       // only support cipher suite 0x3D: TLS_RSA_WITH_AES_256_CBC_SHA256
       // verify server certificate against imported CA certs 0 and enforce validity period (3)
-      at->sendAT(GF("+SQNSPCFG=1,3,\"0x3D\",3,0,,,\"\",\"\""));
+      this->at->sendAT(GF("+SQNSPCFG=1,3,\"0x3D\",3,0,,,\"\",\"\""));
     } else {
       // use TLS 1.0 or higher (1)
       // support wider variety of cipher suites
       // do not verify server certificate (0)
-      at->sendAT(GF("+SQNSPCFG=1,1,\"0x2F;0x35;0x3C;0x3D\",0,,,,\"\",\"\""));
+      this->at->sendAT(GF("+SQNSPCFG=1,1,\"0x2F;0x35;0x3C;0x3D\",0,,,,\"\",\"\""));
     }
-    if (at->waitResponse() != 1) {
+    if (this->at->waitResponse() != 1) {
       DBG("failed to configure security profile");
       return false;
     }
 
-    sock_connected = at->modemConnect(host, port, mux, true, timeout_s);
-    return sock_connected;
+    TINY_GSM_METER(this, connectBegin());
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, true, timeout_s);
+    TINY_GSM_METER(this, connectEnd());
+    return this->sock_connected;
   }
 
   void setStrictSSL(bool strict) {
@@ -184,7 +190,7 @@ public:
 
 public:
 
-  TinyGsmSequansMonarch(Stream& stream)
+  TinyGsmSequansMonarchT(StreamT& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
@@ -215,11 +221,16 @@ public:
     return "Sequans Monarch";
   }
 
+TINY_GSM_MODEM_READ_NAME_CONSTANT()
+
 TINY_GSM_MODEM_SET_BAUD_IPR()
 
+TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC()
+
 TINY_GSM_MODEM_TEST_AT()
 
   void maintain() {
+    TINY_GSM_LOCK(this);
     for (int mux = 1; mux <= TINY_GSM_MUX_COUNT; mux++) {
       GsmClient* sock = sockets[mux % TINY_GSM_MUX_COUNT];
       if (sock && sock->got_data) {
@@ -229,11 +240,14 @@ TINY_GSM_MODEM_TEST_AT()
         modemGetConnected();
       }
     }
-    while (stream.available()) {
+    while (streamAvailable()) {
       waitResponse(15, NULL, NULL);
   }
+    prefetch();
   }
 
+TINY_GSM_MODEM_POLL()
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -252,7 +266,7 @@ TINY_GSM_MODEM_TEST_AT()
 TINY_GSM_MODEM_GET_INFO_ATI()
 
   bool hasSSL() {
-    return true;
+    return Traits::has_ssl;
   }
 
   /*
@@ -260,6 +274,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
    */
 
   bool restart() {
+    invalidateStatus();
+    invalidateIdentity();
     if (!testAT()) {
       return false;
     }
@@ -280,6 +296,8 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    invalidateStatus();
+    invalidateIdentity();
     sendAT(GF("+SQNSSHDN"));
     return waitResponse();
   }
@@ -353,6 +371,10 @@ TINY_GSM_MODEM_GET_OPERATOR_COPS()
 
 TINY_GSM_MODEM_GET_CSQ()
 
+TINY_GSM_MODEM_STATUS(CEREG, false)
+
+TINY_GSM_MODEM_IDENTITY()
+
   bool isNetworkConnected() {
     RegStatus s = getRegistrationStatus();
     if (s == REG_OK_HOME || s == REG_OK_ROAMING) {
@@ -609,6 +631,8 @@ protected:
   }
 
 
+TINY_GSM_MODEM_PREFETCH()
+
   size_t modemRead(size_t size, uint8_t mux) {
     sendAT(GF("+SQNSRECV="), mux, ',', size);
     if (waitResponse(GF("+SQNSRECV: ")) != 1) {
@@ -618,8 +642,8 @@ protected:
     size_t len = stream.readStringUntil('\n').toInt();
     for (size_t i=0; i<len; i++) {
       uint32_t startMillis = millis(); \
-      while (!stream.available() && ((millis() - startMillis) < sockets[mux % TINY_GSM_MUX_COUNT]->_timeout)) { TINY_GSM_YIELD(); } \
-      char c = stream.read(); \
+      while (!streamAvailable() && ((millis() - startMillis) < sockets[mux % TINY_GSM_MUX_COUNT]->_timeout)) { TINY_GSM_YIELD(); } \
+      char c = streamRead(); \
       sockets[mux % TINY_GSM_MUX_COUNT]->rx.put(c);
     }
     DBG("### Read:", len, "from", mux);
@@ -646,8 +670,11 @@ protected:
     // This single command always returns the connection status of all
     // six possible sockets.
     sendAT(GF("+SQNSS"));
+    bool gotOk = false;
     for (int muxNo = 1; muxNo <= TINY_GSM_MUX_COUNT; muxNo++) {
-      if (waitResponse(GFP(GSM_OK), GF(GSM_NL "+SQNSS: ")) != 2) {
+      int8_t res = waitResponse(GFP(GSM_OK), GF(GSM_NL "+SQNSS: "));
+      if (res != 2) {
+        gotOk = (res == 1);
         break;
       };
       uint8_t status = 0;
@@ -666,10 +693,14 @@ protected:
       // SOCK_LISTENING              = 4,
       // SOCK_INCOMING               = 5,
       // SOCK_OPENING                = 6,
-      sockets[muxNo % TINY_GSM_MUX_COUNT]->sock_connected = \
-        ((status != SOCK_CLOSED) && (status != SOCK_INCOMING) && (status != SOCK_OPENING));
+      if (sockets[muxNo % TINY_GSM_MUX_COUNT]) {
+        sockets[muxNo % TINY_GSM_MUX_COUNT]->sock_connected = \
+          ((status != SOCK_CLOSED) && (status != SOCK_INCOMING) && (status != SOCK_OPENING));
+      }
+    }
+    if (!gotOk) {
+      waitResponse();  // Should be an OK at the end
     }
-    waitResponse();  // Should be an OK at the end
     return sockets[mux % TINY_GSM_MUX_COUNT]->sock_connected;
   }
 
@@ -697,11 +728,13 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
-        if (r1 && data.endsWith(r1)) {
+        if (a == '\n' && modemStatusUrc(data)) {
+          data = "";
+        } else if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
         } else if (r2 && data.endsWith(r2)) {
@@ -736,6 +769,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
     if (!index) {
       data.trim();
       if (data.length()) {
@@ -761,10 +795,12 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
 };
 
+typedef TinyGsmSequansMonarchT<Stream> TinyGsmSequansMonarch;
+
 #endif
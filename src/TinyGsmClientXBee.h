@@ -63,24 +63,38 @@ enum XBeeType {
 };
 
 
-class TinyGsmXBee
+template <class StreamT = Stream>
+class TinyGsmXBeeT
 {
 
 public:
 
+  // What this modem can do; the XBee keeps its own client
+  struct Traits {
+    typedef TinyGsmXBeeT Modem;
+    static constexpr bool     has_modem_fifo = false;
+    static constexpr bool     reliable_urc   = true;
+    static constexpr uint16_t max_segment    = 1500;
+    static constexpr uint16_t max_read       = 1500;
+    static constexpr uint8_t  mux_count      = TINY_GSM_MUX_COUNT;
+    static constexpr bool     has_ssl        = true;   // not on the Wi-Fi model
+    static constexpr bool     has_gps        = false;
+    static constexpr bool     has_udp        = false;
+  };
+
 class GsmClient : public Client
 {
-  friend class TinyGsmXBee;
+  friend class TinyGsmXBeeT;
   // typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
 
 public:
   GsmClient() {}
 
-  GsmClient(TinyGsmXBee& modem, uint8_t mux = 0) {
+  GsmClient(TinyGsmXBeeT& modem, uint8_t mux = 0) {
     init(&modem, mux);
   }
 
-  bool init(TinyGsmXBee* modem, uint8_t mux = 0) {
+  bool init(TinyGsmXBeeT* modem, uint8_t mux = 0) {
     this->at = modem;
     this->mux = mux;
     sock_connected = false;
@@ -97,6 +111,7 @@ public:
   // Because all settings are saved to flash, it is possible (or likely) that
   // you could send data even if you haven't "made" any connection.
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     // NOTE:  Not caling stop() or yeild() here
     at->streamClear();  // Empty anything in the buffer before starting
     sock_connected = at->modemConnect(host, port, mux, false, timeout_s);
@@ -107,6 +122,7 @@ public:
   }
 
   virtual int connect(IPAddress ip, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     // NOTE:  Not caling stop() or yeild() here
     at->streamClear();  // Empty anything in the buffer before starting
     sock_connected = at->modemConnect(ip, port, mux, false, timeout_s);
@@ -117,6 +133,7 @@ public:
   }
 
   virtual void stop() {
+    TINY_GSM_LOCK(this->at);
     at->streamClear();  // Empty anything in the buffer
     at->commandMode();
     // For WiFi models, there's no direct way to close the socket.  This is a
@@ -144,6 +161,7 @@ public:
 
   virtual size_t write(const uint8_t *buf, size_t size) {
     TINY_GSM_YIELD();
+    TINY_GSM_LOCK(this->at);
     return at->modemSend(buf, size, mux);
   }
 
@@ -158,7 +176,8 @@ public:
 
   virtual int available() {
     TINY_GSM_YIELD();
-    return at->stream.available();
+    TINY_GSM_LOCK(this->at);
+    return at->streamAvailable();
     /*
     if (!rx.size() || at->stream.available()) {
       at->maintain();
@@ -169,6 +188,7 @@ public:
 
   virtual int read(uint8_t *buf, size_t size) {
     TINY_GSM_YIELD();
+    TINY_GSM_LOCK(this->at);
     return at->stream.readBytes((char *)buf, size);
     /*
     size_t cnt = 0;
@@ -182,7 +202,7 @@ public:
         continue;
       }
       // TODO: Read directly into user buffer?
-      if (!rx.size() || at->stream.available()) {
+      if (!rx.size() || at->streamAvailable()) {
         at->maintain();
       }
     }
@@ -192,7 +212,8 @@ public:
 
   virtual int read() {
     TINY_GSM_YIELD();
-    return at->stream.read();
+    TINY_GSM_LOCK(this->at);
+    return at->streamRead();
     /*
     uint8_t c;
     if (read(&c, 1) == 1) {
@@ -213,6 +234,15 @@ public:
   }
   virtual operator bool() { return connected(); }
 
+  uint32_t pollMask() { return 1UL << mux; }
+
+  // Readiness for the modem's poll(); data comes straight off the stream
+  uint8_t pollEvents() {
+    uint8_t ev = at->streamAvailable() ? TINY_GSM_POLL_READ : 0;
+    ev |= sock_connected ? TINY_GSM_POLL_WRITE : TINY_GSM_POLL_CLOSED;
+    return ev;
+  }
+
   /*
    * Extended API
    */
@@ -220,7 +250,7 @@ public:
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
 
 private:
-  TinyGsmXBee*    at;
+  TinyGsmXBeeT*   at;
   uint8_t         mux;
   bool            sock_connected;
   // RxFifo          rx;
@@ -232,30 +262,32 @@ class GsmClientSecure : public GsmClient
 public:
   GsmClientSecure() {}
 
-  GsmClientSecure(TinyGsmXBee& modem, uint8_t mux = 0)
+  GsmClientSecure(TinyGsmXBeeT& modem, uint8_t mux = 0)
     : GsmClient(modem, mux)
   {}
 
 public:
   virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     // NOTE:  Not caling stop() or yeild() here
-    at->streamClear();  // Empty anything in the buffer before starting
-    sock_connected = at->modemConnect(host, port, mux, true, timeout_s);
-    return sock_connected;
+    this->at->streamClear();  // Empty anything in the buffer before starting
+    this->sock_connected = this->at->modemConnect(host, port, this->mux, true, timeout_s);
+    return this->sock_connected;
   }
 
   virtual int connect(IPAddress ip, uint16_t port, int timeout_s) {
+    TINY_GSM_LOCK(this->at);
     // NOTE:  Not caling stop() or yeild() here
-    at->streamClear();  // Empty anything in the buffer before starting
-    sock_connected = at->modemConnect(ip, port, mux, true, timeout_s);
-    return sock_connected;
+    this->at->streamClear();  // Empty anything in the buffer before starting
+    this->sock_connected = this->at->modemConnect(ip, port, this->mux, true, timeout_s);
+    return this->sock_connected;
   }
 };
 
 
 public:
 
-  TinyGsmXBee(Stream& stream)
+  TinyGsmXBeeT(StreamT& stream)
     : stream(stream)
   {
       beeType = XBEE_UNKNOWN;  // Start not knowing what kind of bee it is
@@ -267,7 +299,7 @@ public:
       memset(sockets, 0, sizeof(sockets));
   }
 
-  TinyGsmXBee(Stream& stream, int8_t resetPin)
+  TinyGsmXBeeT(StreamT& stream, int8_t resetPin)
     : stream(stream)
   {
       beeType = XBEE_UNKNOWN;  // Start not knowing what kind of bee it is
@@ -322,6 +354,8 @@ public:
     return getBeeName();
   }
 
+TINY_GSM_MODEM_READ_NAME_CONSTANT()
+
   void setBaud(unsigned long baud) {
     XBEE_COMMAND_START_DECORATOR(5, )
     switch(baud)
@@ -347,6 +381,20 @@ public:
     XBEE_COMMAND_END_DECORATOR
   }
 
+  bool setHardwareFlowControl(bool enable = true) {
+    if (enable) {
+      TINY_GSM_RTS_BEGIN();
+    }
+    XBEE_COMMAND_START_DECORATOR(5, false)
+    sendAT(GF("D6"), enable ? 1 : 0);  // RTS flow control on DIO6
+    bool ret_val = waitResponse() == 1;
+    sendAT(GF("D7"), enable ? 1 : 0);  // CTS flow control on DIO7
+    ret_val &= waitResponse() == 1;
+    ret_val &= writeChanges();
+    XBEE_COMMAND_END_DECORATOR
+    return ret_val;
+  }
+
   bool testAT(unsigned long timeout_ms = 10000L) {
     unsigned long start = millis();
     bool success = false;
@@ -369,6 +417,7 @@ public:
   }
 
   void maintain() {
+    TINY_GSM_LOCK(this);
     // this only happens OUTSIDE command mode, so if we're getting characters
     // they should be data received from the TCP connection
     // TINY_GSM_YIELD();
@@ -380,6 +429,8 @@ public:
     // }
   }
 
+TINY_GSM_MODEM_POLL()
+
   bool factoryDefault() {
     XBEE_COMMAND_START_DECORATOR(5, false)
     sendAT(GF("RE"));
@@ -443,6 +494,7 @@ public:
 
   bool restart() {
 
+    invalidateIdentity();
     if (!commandMode()) return false;  // Return immediately
 
     if (beeType == XBEE_UNKNOWN) getSeries();  // how we restart depends on this
@@ -525,6 +577,8 @@ public:
     return sendATGetString(GF("IM"));
   }
 
+TINY_GSM_MODEM_IDENTITY()
+
   SimStatus getSimStatus(unsigned long timeout_ms = 10000L) {
     return SIM_READY;  // unsupported
   }
@@ -819,7 +873,7 @@ protected:
     while ((millis() - startMillis) < timeout_ms)  // the lookup can take a while
     {
       sendAT(GF("LA"), host);
-      while (stream.available() < 4 && (millis() - startMillis < timeout_ms)) {TINY_GSM_YIELD()};
+      while (streamAvailable() < 4 && (millis() - startMillis < timeout_ms)) {TINY_GSM_YIELD()};
       strIP = stream.readStringUntil('\r');  // read result
       strIP.trim();
       if (strIP != "" && strIP != GF("ERROR")) {
@@ -965,8 +1019,8 @@ public:
    */
 
   void streamClear(void) {
-    while (stream.available()) {
-      stream.read();
+    while (streamAvailable()) {
+      streamRead();
       TINY_GSM_YIELD();
     }
   }
@@ -992,8 +1046,8 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        int a = stream.read();
+      while (streamAvailable() > 0) {
+        int a = streamRead();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
         if (r1 && data.endsWith(r1)) {
@@ -1015,6 +1069,7 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
       }
     } while (millis() - startMillis < timeout_ms);
 finish:
+    TINY_GSM_STATS_RESPONSE(index, r1, data.length());
     if (!index) {
       data.trim();
       data.replace(GSM_NL GSM_NL, GSM_NL);
@@ -1116,7 +1171,7 @@ finish:
   String readResponseString(uint32_t timeout_ms = 1000) {
     TINY_GSM_YIELD();
     unsigned long startMillis = millis();
-    while (!stream.available() && millis() - startMillis < timeout_ms) {};
+    while (!streamAvailable() && millis() - startMillis < timeout_ms) {};
     String res = stream.readStringUntil('\r');  // lines end with carriage returns
     res.trim();
     return res;
@@ -1145,7 +1200,7 @@ finish:
   }
 
 public:
-  Stream&       stream;
+  StreamT&      stream;
 
 protected:
   int16_t       guardTime;
@@ -1158,4 +1213,6 @@ protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
 };
 
+typedef TinyGsmXBeeT<Stream> TinyGsmXBee;
+
 #endif
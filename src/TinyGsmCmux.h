@@ -0,0 +1,578 @@
+/**
+ * @file       TinyGsmCmux.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmCmux_h
+#define TinyGsmCmux_h
+//#pragma message("TinyGSM:  TinyGsmCmux")
+
+/*
+ * 3GPP TS 27.010 multiplexer, basic option.
+ *
+ * Splits one serial port into several virtual serial ports (DLCs), each with
+ * its own AT command parser on the modem side.  Every channel is a Stream,
+ * so a modem object can be created on top of each of them:
+ *
+ *   TinyGsmCmux cmux(SerialAT);
+ *   TinyGsm modem(cmux.channel(1));      // control and status
+ *   TinyGsm dataModem(cmux.channel(2));  // sockets
+ *
+ *   cmux.begin();          // AT+CMUX and open the control channel
+ *   cmux.openChannel(1);
+ *   cmux.openChannel(2);
+ *
+ * Frames for every channel are read whenever any channel is polled, so a long
+ * socket read on one channel no longer holds up the responses on another.
+ * Supported by SIM800, SIM7000, BG96, u-blox and SARA-R4 modems.
+ */
+
+#include <TinyGsmCommon.h>
+
+// Number of virtual channels (DLCI 1..N), the control channel is extra
+#if !defined(TINY_GSM_CMUX_CHANNELS)
+  #define TINY_GSM_CMUX_CHANNELS 2
+#endif
+
+// Receive buffer of each channel
+#if !defined(TINY_GSM_CMUX_RX_BUFFER)
+  #define TINY_GSM_CMUX_RX_BUFFER 256
+#endif
+
+// Maximum information field length (N1), 31 is the 27.010 default.
+// begin() sends it to the modem in AT+CMUX, so both sides frame alike
+// (left alone, SIMCom and Quectel modems send up to 127 bytes per frame).
+#if !defined(TINY_GSM_CMUX_FRAME_SIZE)
+  #define TINY_GSM_CMUX_FRAME_SIZE 31
+#endif
+
+// <port_speed> of AT+CMUX, the rate the port already runs at:
+// 1 9600, 2 19200, 3 38400, 4 57600, 5 115200, 6 230400, 7 460800
+#if !defined(TINY_GSM_CMUX_PORT_SPEED)
+  #define TINY_GSM_CMUX_PORT_SPEED 5
+#endif
+
+#define TINY_GSM_CMUX_FLAG      0xF9
+#define TINY_GSM_CMUX_EA        0x01
+#define TINY_GSM_CMUX_CR        0x02
+#define TINY_GSM_CMUX_PF        0x10
+
+// Frame types (control field, P/F bit cleared)
+#define TINY_GSM_CMUX_SABM      0x2F
+#define TINY_GSM_CMUX_UA        0x63
+#define TINY_GSM_CMUX_DM        0x0F
+#define TINY_GSM_CMUX_DISC      0x43
+#define TINY_GSM_CMUX_UIH       0xEF
+
+// Control channel messages (type field, C/R bit cleared)
+#define TINY_GSM_CMUX_MSG_PN    0x81
+#define TINY_GSM_CMUX_MSG_CLD   0xC1
+#define TINY_GSM_CMUX_MSG_TEST  0x21
+#define TINY_GSM_CMUX_MSG_FCON  0xA1
+#define TINY_GSM_CMUX_MSG_FCOFF 0x61
+#define TINY_GSM_CMUX_MSG_MSC   0xE1
+#define TINY_GSM_CMUX_MSG_NSC   0x11
+
+// V.24 signals in MSC: EA, RTC, RTR and DV set; FC is the flow control bit
+#define TINY_GSM_CMUX_V24       0x8D
+#define TINY_GSM_CMUX_V24_FC    0x02
+
+class TinyGsmCmux
+{
+
+public:
+
+class Channel : public Stream
+{
+  friend class TinyGsmCmux;
+  typedef TinyGsmFifo<uint8_t, TINY_GSM_CMUX_RX_BUFFER> RxFifo;
+
+public:
+  Channel() {}
+
+  bool isOpen() {
+    return open;
+  }
+
+  virtual int available() {
+    sendPending();
+    mux->poll();
+    return rx.size();
+  }
+
+  virtual int read() {
+    uint8_t c;
+    if (!rx.size()) {
+      sendPending();
+      mux->poll();
+    }
+    if (!rx.get(&c)) {
+      return -1;
+    }
+    if (flow_off && rx.size() < TINY_GSM_CMUX_RX_BUFFER/4) {
+      mux->sendFlowControl(dlci, false);
+    }
+    return c;
+  }
+
+  virtual int peek() {
+    if (!rx.size()) {
+      sendPending();
+      mux->poll();
+    }
+    uint8_t c;
+    if (!rx.peek(&c)) {
+      return -1;
+    }
+    return c;
+  }
+
+  // Small writes (as sendAT does them) are collected into one frame, which
+  // goes out when it is full, on flush(), or before we look for a reply.
+  // Returns short if the frame is still full because the modem holds us off.
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+      if (tx_len == TINY_GSM_CMUX_FRAME_SIZE && !sendPending()) {
+        break;
+      }
+      size_t chunk = TinyGsmMin(size - written, (size_t)(TINY_GSM_CMUX_FRAME_SIZE - tx_len));
+      memcpy(tx + tx_len, buf + written, chunk);
+      tx_len += chunk;
+      written += chunk;
+    }
+    return written;
+  }
+
+  virtual size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+
+  virtual void flush() {
+    sendPending();
+    mux->stream.flush();
+  }
+
+private:
+  bool sendPending() {
+    if (!tx_len) {
+      return true;
+    }
+    if (!open) {
+      tx_len = 0;
+      return false;
+    }
+    // If the modem held flow control past the timeout, keep what didn't go
+    // out so the next write or flush() can retry it
+    size_t sent = mux->writeData(dlci, tx, tx_len);
+    if (sent < tx_len) {
+      memmove(tx, tx + sent, tx_len - sent);
+    }
+    tx_len -= sent;
+    return tx_len == 0;
+  }
+
+  TinyGsmCmux*  mux;
+  uint8_t       dlci;
+  bool          open;
+  bool          tx_stopped;   // modem asked us to stop sending (MSC FC)
+  bool          flow_off;     // we asked the modem to stop sending
+  uint16_t      tx_len;
+  uint8_t       tx[TINY_GSM_CMUX_FRAME_SIZE];
+  RxFifo        rx;
+};
+
+
+public:
+
+  TinyGsmCmux(Stream& stream)
+    : stream(stream)
+  {
+    for (uint8_t i = 0; i < TINY_GSM_CMUX_CHANNELS; i++) {
+      channels[i].mux = this;
+      channels[i].dlci = i + 1;
+    }
+    reset();
+  }
+
+  /*
+   * Basic functions
+   */
+
+  // Switches the modem into multiplexer mode and opens the control channel.
+  // Pass false if the modem was already set up with a matching AT+CMUX.
+  bool begin(bool sendCmux = true, uint32_t timeout_ms = 3000L) {
+    reset();
+    if (sendCmux) {
+      // Basic option, UIH frames, our port speed and N1
+      stream.print(GF("AT+CMUX=0,0,"));
+      stream.print(TINY_GSM_CMUX_PORT_SPEED);
+      stream.print(',');
+      stream.print(TINY_GSM_CMUX_FRAME_SIZE);
+      stream.print(GF("\r\n"));
+      stream.flush();
+      if (!waitForOk(timeout_ms)) {
+        DBG(GF("### CMUX: modem refused AT+CMUX"));
+        return false;
+      }
+    }
+    return openDlc(0, timeout_ms);
+  }
+
+  bool openChannel(uint8_t dlci, uint32_t timeout_ms = 3000L) {
+    if (dlci < 1 || dlci > TINY_GSM_CMUX_CHANNELS) {
+      return false;
+    }
+    if (!openDlc(dlci, timeout_ms)) {
+      return false;
+    }
+    // Tell the modem we're ready to receive on this channel
+    sendMsc(dlci, TINY_GSM_CMUX_V24);
+    return true;
+  }
+
+  bool closeChannel(uint8_t dlci, uint32_t timeout_ms = 3000L) {
+    if (dlci < 1 || dlci > TINY_GSM_CMUX_CHANNELS) {
+      return false;
+    }
+    waitReply = dlci;
+    gotReply = 0;
+    sendFrame(dlci, TINY_GSM_CMUX_DISC | TINY_GSM_CMUX_PF, NULL, 0);
+    bool ok = waitFrameReply(timeout_ms) == TINY_GSM_CMUX_UA;
+    channels[dlci-1].open = false;
+    return ok;
+  }
+
+  // Leaves multiplexer mode, the modem goes back to plain AT commands
+  bool end(uint32_t timeout_ms = 3000L) {
+    uint8_t cld[] = { TINY_GSM_CMUX_MSG_CLD | TINY_GSM_CMUX_CR, TINY_GSM_CMUX_EA };
+    sendFrame(0, TINY_GSM_CMUX_UIH, cld, sizeof(cld));
+    // Any control frame from the modem now is the close down response
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms && !closedDown) {
+      poll();
+      TINY_GSM_YIELD();
+    }
+    bool ok = closedDown;
+    reset();
+    return ok;
+  }
+
+  Channel& channel(uint8_t dlci) {
+    return channels[dlci-1];
+  }
+
+  // Reads whatever has arrived on the port and sorts it into the channels
+  void poll() {
+    while (stream.available()) {
+      int a = stream.read();
+      if (a < 0) break;
+      parse(a);
+    }
+  }
+
+  /*
+   * Utilities
+   */
+
+protected:
+
+  enum ParseState {
+    WAIT_FLAG,
+    WAIT_ADDRESS,
+    WAIT_CONTROL,
+    WAIT_LENGTH,
+    WAIT_LENGTH2,
+    WAIT_DATA,
+    WAIT_FCS,
+    WAIT_END
+  };
+
+  void reset() {
+    state = WAIT_FLAG;
+    waitReply = 0xFF;
+    gotReply = 0;
+    closedDown = false;
+    tx_stopped = false;
+    for (uint8_t i = 0; i < TINY_GSM_CMUX_CHANNELS; i++) {
+      channels[i].open = false;
+      channels[i].tx_stopped = false;
+      channels[i].flow_off = false;
+      channels[i].tx_len = 0;
+      channels[i].rx.clear();
+    }
+  }
+
+  bool waitForOk(uint32_t timeout_ms) {
+    const char ok[] = "OK\r\n";
+    uint8_t matched = 0;
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms) {
+      while (stream.available()) {
+        char c = stream.read();
+        matched = (c == ok[matched]) ? matched + 1 : (c == ok[0]);
+        if (!ok[matched]) return true;
+      }
+      TINY_GSM_YIELD();
+    }
+    return false;
+  }
+
+  bool openDlc(uint8_t dlci, uint32_t timeout_ms) {
+    waitReply = dlci;
+    gotReply = 0;
+    sendFrame(dlci, TINY_GSM_CMUX_SABM | TINY_GSM_CMUX_PF, NULL, 0);
+    if (waitFrameReply(timeout_ms) != TINY_GSM_CMUX_UA) {
+      DBG(GF("### CMUX: no UA for DLCI"), dlci);
+      return false;
+    }
+    if (dlci > 0) {
+      channels[dlci-1].open = true;
+    }
+    return true;
+  }
+
+  uint8_t waitFrameReply(uint32_t timeout_ms) {
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms && !gotReply) {
+      poll();
+      TINY_GSM_YIELD();
+    }
+    waitReply = 0xFF;
+    return gotReply;
+  }
+
+  // CRC-8 of 27.010 annex B, reflected polynomial x^8+x^2+x+1
+  static uint8_t crcUpdate(uint8_t crc, uint8_t b) {
+    crc ^= b;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xE0 : (crc >> 1);
+    }
+    return crc;
+  }
+
+  void sendFrame(uint8_t dlci, uint8_t control, const uint8_t* data, size_t len,
+                 bool command = true) {
+    uint8_t head[5];
+    uint8_t n = 0;
+    head[n++] = TINY_GSM_CMUX_FLAG;
+    // We are the initiator, so our commands carry C/R = 1 and responses C/R = 0
+    head[n++] = (dlci << 2) | (command ? TINY_GSM_CMUX_CR : 0) | TINY_GSM_CMUX_EA;
+    head[n++] = control;
+    if (len > 127) {
+      head[n++] = (len << 1) & 0xFE;
+      head[n++] = len >> 7;
+    } else {
+      head[n++] = (len << 1) | TINY_GSM_CMUX_EA;
+    }
+    uint8_t crc = 0xFF;
+    for (uint8_t i = 1; i < n; i++) {
+      crc = crcUpdate(crc, head[i]);
+    }
+    uint8_t tail[2] = { (uint8_t)(0xFF - crc), TINY_GSM_CMUX_FLAG };
+    stream.write(head, n);
+    if (len) {
+      stream.write(data, len);
+    }
+    stream.write(tail, 2);
+  }
+
+  void sendMsc(uint8_t dlci, uint8_t signals) {
+    uint8_t msc[] = { TINY_GSM_CMUX_MSG_MSC | TINY_GSM_CMUX_CR,
+                      (2 << 1) | TINY_GSM_CMUX_EA,
+                      (uint8_t)((dlci << 2) | TINY_GSM_CMUX_CR | TINY_GSM_CMUX_EA),
+                      signals };
+    sendFrame(0, TINY_GSM_CMUX_UIH, msc, sizeof(msc));
+  }
+
+  void sendFlowControl(uint8_t dlci, bool stop) {
+    channels[dlci-1].flow_off = stop;
+    sendMsc(dlci, stop ? (TINY_GSM_CMUX_V24 | TINY_GSM_CMUX_V24_FC) : TINY_GSM_CMUX_V24);
+  }
+
+  size_t writeData(uint8_t dlci, const uint8_t* buf, size_t size) {
+    Channel& ch = channels[dlci-1];
+    if (!ch.open) {
+      return 0;
+    }
+    size_t sent = 0;
+    while (sent < size) {
+      // Honour the modem's flow control, but don't wait forever
+      uint32_t startMillis = millis();
+      while ((tx_stopped || ch.tx_stopped) && millis() - startMillis < ch._timeout) {
+        poll();
+        TINY_GSM_YIELD();
+      }
+      if (tx_stopped || ch.tx_stopped) {
+        break;
+      }
+      size_t chunk = TinyGsmMin(size - sent, (size_t)TINY_GSM_CMUX_FRAME_SIZE);
+      sendFrame(dlci, TINY_GSM_CMUX_UIH, buf + sent, chunk);
+      sent += chunk;
+    }
+    return sent;
+  }
+
+  void parse(uint8_t c) {
+    switch (state) {
+      case WAIT_FLAG:
+        if (c == TINY_GSM_CMUX_FLAG) {
+          state = WAIT_ADDRESS;
+        }
+        break;
+      case WAIT_ADDRESS:
+        if (c == TINY_GSM_CMUX_FLAG) {
+          break;  // Closing flag of the previous frame doubling as opening flag
+        }
+        frameAddr = c;
+        frameCrc = crcUpdate(0xFF, c);
+        state = WAIT_CONTROL;
+        break;
+      case WAIT_CONTROL:
+        frameCtrl = c;
+        frameCrc = crcUpdate(frameCrc, c);
+        state = WAIT_LENGTH;
+        break;
+      case WAIT_LENGTH:
+        frameCrc = crcUpdate(frameCrc, c);
+        frameLen = c >> 1;
+        state = (c & TINY_GSM_CMUX_EA) ? (frameLen ? WAIT_DATA : WAIT_FCS) : WAIT_LENGTH2;
+        frameRead = 0;
+        break;
+      case WAIT_LENGTH2:
+        frameCrc = crcUpdate(frameCrc, c);
+        frameLen |= (uint16_t)c << 7;
+        state = frameLen ? WAIT_DATA : WAIT_FCS;
+        break;
+      case WAIT_DATA:
+        if (frameRead < TINY_GSM_CMUX_FRAME_SIZE) {
+          frame[frameRead] = c;
+        }
+        if (++frameRead >= frameLen) {
+          state = WAIT_FCS;
+        }
+        break;
+      case WAIT_FCS:
+        frameCrc = crcUpdate(frameCrc, c);
+        state = WAIT_END;
+        break;
+      case WAIT_END:
+        state = WAIT_FLAG;
+        if (c != TINY_GSM_CMUX_FLAG) {
+          DBG(GF("### CMUX: framing error"));
+          break;
+        }
+        if (frameCrc != 0xCF) {
+          DBG(GF("### CMUX: bad FCS"));
+        } else if (frameRead > TINY_GSM_CMUX_FRAME_SIZE) {
+          DBG(GF("### CMUX: frame too long"), frameRead);
+        } else {
+          handleFrame();
+        }
+        // The closing flag may also open the next frame
+        state = WAIT_ADDRESS;
+        break;
+    }
+  }
+
+  void handleFrame() {
+    uint8_t dlci = frameAddr >> 2;
+    uint8_t type = frameCtrl & ~TINY_GSM_CMUX_PF;
+
+    if (type == TINY_GSM_CMUX_UIH) {
+      if (dlci == 0) {
+        handleControl();
+      } else if (dlci <= TINY_GSM_CMUX_CHANNELS) {
+        Channel& ch = channels[dlci-1];
+        if (ch.rx.put(frame, frameLen) != frameLen) {
+          DBG(GF("### CMUX: buffer overflow on DLCI"), dlci);
+        }
+        if (!ch.flow_off && ch.rx.size() >= TINY_GSM_CMUX_RX_BUFFER*3/4) {
+          sendFlowControl(dlci, true);
+        }
+      }
+      return;
+    }
+
+    if (dlci == waitReply && (type == TINY_GSM_CMUX_UA || type == TINY_GSM_CMUX_DM)) {
+      gotReply = type;
+      return;
+    }
+
+    if (type == TINY_GSM_CMUX_DISC) {
+      // Modem closed a channel on its own, acknowledge it
+      if (dlci > 0 && dlci <= TINY_GSM_CMUX_CHANNELS) {
+        channels[dlci-1].open = false;
+      }
+      sendFrame(dlci, TINY_GSM_CMUX_UA | TINY_GSM_CMUX_PF, NULL, 0, false);
+    } else if (type == TINY_GSM_CMUX_DM && dlci > 0 && dlci <= TINY_GSM_CMUX_CHANNELS) {
+      channels[dlci-1].open = false;
+    }
+  }
+
+  void handleControl() {
+    if (frameLen < 2) return;
+    uint8_t msg = frame[0] & ~TINY_GSM_CMUX_CR;
+    bool command = frame[0] & TINY_GSM_CMUX_CR;
+    uint8_t len = frame[1] >> 1;
+    const uint8_t* value = frame + 2;
+    if (len > frameLen - 2) return;
+
+    switch (msg) {
+      case TINY_GSM_CMUX_MSG_MSC:
+        if (command && len >= 2) {
+          uint8_t dlci = value[0] >> 2;
+          if (dlci > 0 && dlci <= TINY_GSM_CMUX_CHANNELS) {
+            channels[dlci-1].tx_stopped = value[1] & TINY_GSM_CMUX_V24_FC;
+          }
+        }
+        break;
+      case TINY_GSM_CMUX_MSG_FCON:
+        if (command) tx_stopped = false;
+        break;
+      case TINY_GSM_CMUX_MSG_FCOFF:
+        if (command) tx_stopped = true;
+        break;
+      case TINY_GSM_CMUX_MSG_CLD:
+        closedDown = true;
+        break;
+      case TINY_GSM_CMUX_MSG_TEST:
+        break;
+      default:
+        // 27.010 5.4.6.3.8: commands we don't support (e.g. PN) get NSC
+        if (command) {
+          uint8_t nsc[] = { TINY_GSM_CMUX_MSG_NSC, (1 << 1) | TINY_GSM_CMUX_EA, frame[0] };
+          sendFrame(0, TINY_GSM_CMUX_UIH, nsc, sizeof(nsc));
+        }
+        return;
+    }
+
+    // Commands from the modem are answered with the same message, C/R cleared
+    if (command) {
+      frame[0] &= ~TINY_GSM_CMUX_CR;
+      sendFrame(0, TINY_GSM_CMUX_UIH, frame, len + 2);
+    }
+  }
+
+public:
+  Stream&       stream;
+
+protected:
+  Channel       channels[TINY_GSM_CMUX_CHANNELS];
+  ParseState    state;
+  uint8_t       frameAddr;
+  uint8_t       frameCtrl;
+  uint8_t       frameCrc;
+  uint16_t      frameLen;
+  uint16_t      frameRead;
+  uint8_t       frame[TINY_GSM_CMUX_FRAME_SIZE];
+  uint8_t       waitReply;
+  uint8_t       gotReply;
+  bool          closedDown;
+  bool          tx_stopped;
+};
+
+#endif
@@ -12,6 +12,12 @@
 // The current library version number
 #define TINYGSM_VERSION "0.7.9"
 
+// Building for Linux (or another POSIX host) rather than a board
+#if !defined(TINY_GSM_HOST) && !defined(ARDUINO) && !defined(SPARK) && \
+    !defined(PARTICLE) && (defined(__linux__) || defined(__APPLE__))
+  #define TINY_GSM_HOST
+#endif
+
 #if defined(SPARK) || defined(PARTICLE)
   #include "Particle.h"
 #elif defined(ARDUINO)
@@ -20,20 +26,119 @@
   #else
     #include "WProgram.h"
   #endif
+#elif defined(TINY_GSM_HOST)
+  #include <HostCompat/Arduino.h>
 #endif
 
 #if defined(ARDUINO_DASH)
   #include <ArduinoCompat/Client.h>
+#elif defined(TINY_GSM_HOST)
+  #include <HostCompat/Client.h>
 #else
   #include <Client.h>
 #endif
 
 #include <TinyGsmFifo.h>
 
+#if defined(TINY_GSM_STATS) || defined(TINY_GSM_SOCKET_STATS)
+  #include <TinyGsmStats.h>
+#endif
+
 #ifndef TINY_GSM_YIELD
   #define TINY_GSM_YIELD() { delay(0); }
 #endif
 
+// With TINY_GSM_RTOS every client call and maintain() holds the modem's mutex,
+// see TinyGsmRtos.h
+#if defined(TINY_GSM_RTOS)
+  #include <TinyGsmRtos.h>
+  #define TINY_GSM_LOCK(modem) TinyGsmLock tinyGsmLock((modem)->mutex)
+  #define TINY_GSM_MODEM_MUTEX() TinyGsmMutex mutex;
+#else
+  #define TINY_GSM_LOCK(modem)
+  #define TINY_GSM_MODEM_MUTEX()
+#endif
+
+// Host side of RTS/CTS flow control.  TINY_GSM_RTS(ready) is called with
+// false when the library wants the modem to stop sending and with true when
+// it may send again.  Define TINY_GSM_RTS_PIN to drive a GPIO wired to the
+// modem's RTS input, or define TINY_GSM_RTS yourself for a UART with its own
+// flow control register.  The modem side is set up with setHardwareFlowControl().
+#ifndef TINY_GSM_RTS
+  #if defined(TINY_GSM_RTS_PIN)
+    #define TINY_GSM_RTS(ready) { digitalWrite(TINY_GSM_RTS_PIN, (ready) ? LOW : HIGH); }
+  #else
+    #define TINY_GSM_RTS(ready) { (void)(ready); }
+  #endif
+#endif
+
+// Makes TINY_GSM_RTS_PIN an output and asserts it (ready), so the modem may
+// send as soon as it starts watching RTS
+#if defined(TINY_GSM_RTS_PIN)
+  #define TINY_GSM_RTS_BEGIN() { pinMode(TINY_GSM_RTS_PIN, OUTPUT); digitalWrite(TINY_GSM_RTS_PIN, LOW); }
+#else
+  #define TINY_GSM_RTS_BEGIN()
+#endif
+
+// Fill level of a socket fifo at which the modem is told to hold off
+#ifndef TINY_GSM_RX_HIGH_WATERMARK
+  #define TINY_GSM_RX_HIGH_WATERMARK (TINY_GSM_RX_BUFFER - TINY_GSM_RX_BUFFER/4)
+#endif
+
+// Largest block requested per read of a modem-side HTTP response or file
+#ifndef TINY_GSM_HTTP_CHUNK
+  #define TINY_GSM_HTTP_CHUNK 4096
+#endif
+
+// Interval between progress checks of a modem-side file download
+#ifndef TINY_GSM_DOWNLOAD_POLL
+  #define TINY_GSM_DOWNLOAD_POLL 1000L
+#endif
+
+// Bytes of an AT command line assembled before it is written to the modem;
+// longer lines go out in more than one write
+#ifndef TINY_GSM_AT_BUFFER
+  #define TINY_GSM_AT_BUFFER 64
+#endif
+
+// Wait for each AT command line to leave the UART before listening for the
+// reply.  Not needed for correctness: every reply comes after the whole line.
+// A command nobody waits on (setBaud) flushes by itself.
+#if defined(TINY_GSM_FLUSH_AT)
+  #define TINY_GSM_AT_FLUSH() { stream.flush(); }
+#else
+  #define TINY_GSM_AT_FLUSH()
+#endif
+
+// Bytes maintain() reads ahead into each socket's rx fifo while the modem
+// holds data for it, so read() is served locally; 0 leaves it to read()
+#ifndef TINY_GSM_PREFETCH
+  #define TINY_GSM_PREFETCH 0
+#endif
+
+// TINY_GSM_COMPACT trades a few instructions for RAM on small chips: the
+// per-socket flags become bitfields, and the missed-URC poll and the cached
+// status keep 16-bit timestamps (intervals past 65 s wrap, so a poll may
+// come late or a status field be served stale once)
+#if defined(TINY_GSM_COMPACT)
+  #define TINY_GSM_FLAG(name) bool name : 1
+  typedef uint16_t TinyGsmTick;
+#else
+  #define TINY_GSM_FLAG(name) bool name
+  typedef uint32_t TinyGsmTick;
+#endif
+
+// Silence required around the "+++" escape sequence of a transparent socket
+#ifndef TINY_GSM_DATA_MODE_GUARD_TIME
+  #define TINY_GSM_DATA_MODE_GUARD_TIME 1000L
+#endif
+
+// How long a transparent socket holds back bytes that may begin the modem's
+// close report ("CLOSED", "NO CARRIER") before handing them out as data
+#ifndef TINY_GSM_DATA_MODE_TRAILER_WAIT
+  #define TINY_GSM_DATA_MODE_TRAILER_WAIT 50L
+#endif
+
 #define TINY_GSM_ATTR_NOT_AVAILABLE __attribute__((error("Not available on this modem type")))
 #define TINY_GSM_ATTR_NOT_IMPLEMENTED __attribute__((error("Not implemented")))
 
@@ -49,6 +154,41 @@
   #define GF(x)  x
 #endif
 
+// Hooks for the per-command statistics of TinyGsmStats.h
+#if defined(TINY_GSM_STATS)
+  #define TINY_GSM_STATS_COMMAND(sent, ...) { stats_rec.begin(sent, __VA_ARGS__); }
+  #define TINY_GSM_STATS_RESPONSE(index, r1, bytes) { stats_rec.response(index, (r1) != NULL, bytes); }
+  #define TINY_GSM_STATS_DATA(out, in) { at->stats_rec.data(out, in); }
+  #define TINY_GSM_STATS_MODEM_DATA(out, in) { stats_rec.data(out, in); }
+  #define TINY_GSM_MODEM_STATS() \
+    const TinyGsmStats& getStats() { \
+      return stats_rec.get(); \
+    } \
+    \
+    void resetStats() { \
+      stats_rec.reset(); \
+    } \
+    \
+    TinyGsmStatsRecorder stats_rec;
+#else
+  #define TINY_GSM_STATS_COMMAND(sent, ...) { (void)(sent); }
+  #define TINY_GSM_STATS_RESPONSE(index, r1, bytes)
+  #define TINY_GSM_STATS_DATA(out, in)
+  #define TINY_GSM_STATS_MODEM_DATA(out, in) { (void)(in); }
+  #define TINY_GSM_MODEM_STATS()
+#endif
+
+// Hooks for the per-socket meters of TinyGsmStats.h, e.g.
+// TINY_GSM_METER(sock, modemRead()); TINY_GSM_METER_START declares the
+// start time a read or write is measured from
+#if defined(TINY_GSM_SOCKET_STATS)
+  #define TINY_GSM_METER(sock, call) { (sock)->meter.call; }
+  #define TINY_GSM_METER_START(t) uint32_t t = millis();
+#else
+  #define TINY_GSM_METER(sock, call)
+  #define TINY_GSM_METER_START(t)
+#endif
+
 #ifdef TINY_GSM_DEBUG
 namespace {
   template<typename T>
@@ -88,6 +228,159 @@ const T& TinyGsmMax(const T& a, const T& b)
     return (b < a) ? a : b;
 }
 
+// Calls on a driver's serial port.  For a concrete port class the call is
+// qualified with that class, so it is made (and can be inlined) directly
+// rather than through the Stream vtable; the port object must then be of
+// exactly that class, not derived from it.  A plain Stream or Print keeps
+// the virtual call.
+template<class S>
+struct TinyGsmPort
+{
+  static int available(S& s) { return s.S::available(); }
+  static int read(S& s) { return s.S::read(); }
+  static size_t write(S& s, const uint8_t* buf, size_t len) {
+    return s.S::write(buf, len);
+  }
+};
+
+template<>
+struct TinyGsmPort<Stream>
+{
+  static int available(Stream& s) { return s.available(); }
+  static int read(Stream& s) { return s.read(); }
+  static size_t write(Stream& s, const uint8_t* buf, size_t len) {
+    return s.write(buf, len);
+  }
+};
+
+template<>
+struct TinyGsmPort<Print>
+{
+  static size_t write(Print& s, const uint8_t* buf, size_t len) {
+    return s.write(buf, len);
+  }
+};
+
+// Formats a command line into a stack buffer so that it reaches the serial
+// port in one write() rather than one per argument
+template<size_t N, class Out = Print>
+class TinyGsmLineBuffer : public Print
+{
+public:
+  explicit TinyGsmLineBuffer(Out& out) : out(out), len(0), sent(0) {}
+
+  template<typename T>
+  void add(T last) {
+    print(last);
+  }
+
+  template<typename T, typename... Args>
+  void add(T head, Args... tail) {
+    print(head);
+    add(tail...);
+  }
+
+  size_t write(uint8_t c) {
+    if (len == N) {
+      send();
+    }
+    buf[len++] = c;
+    return 1;
+  }
+
+  size_t write(const uint8_t* data, size_t size) {
+    for (size_t left = size; left; ) {
+      if (len == N) {
+        send();
+      }
+      size_t n = TinyGsmMin(left, N - len);
+      memcpy(buf + len, data, n);
+      len += n;
+      data += n;
+      left -= n;
+    }
+    return size;
+  }
+
+  using Print::write;
+
+  // Writes out what is buffered; returns the bytes written in total
+  size_t send() {
+    if (len) {
+      sent += TinyGsmPort<Out>::write(out, buf, len);
+      len = 0;
+    }
+    return sent;
+  }
+
+private:
+  Out&    out;
+  size_t  len;
+  size_t  sent;
+  uint8_t buf[N];
+};
+
+// Follows an HTTP response header as it is printed to it, picking up the
+// status code and where the body starts without keeping the bytes
+class TinyGsmHttpHeader : public Print
+{
+public:
+  TinyGsmHttpHeader() : pos(0), body(0), status(0), spaces(0), match(0) {}
+
+  size_t write(uint8_t c) {
+    pos++;
+    if (body) {
+      return 1;
+    }
+    // "HTTP/1.1 200 OK": the code is the second word of the first line
+    if (spaces == 1 && c >= '0' && c <= '9') {
+      status = status * 10 + (c - '0');
+    }
+    if (c == '\n') {
+      spaces = 2;
+    } else if (c == ' ' && spaces < 2) {
+      spaces++;
+    }
+    static const char end[] = "\r\n\r\n";
+    match = (c == end[match]) ? match + 1 : (c == '\r');
+    if (match == 4) {
+      body = pos;
+    }
+    return 1;
+  }
+
+  using Print::write;
+
+  int statusCode() {
+    return status;
+  }
+
+  // 0 until the blank line after the header has gone by
+  uint32_t bodyOffset() {
+    return body;
+  }
+
+private:
+  uint32_t pos;
+  uint32_t body;
+  uint16_t status;
+  uint8_t  spaces;
+  uint8_t  match;
+};
+
+// Reads up to len bytes that have already arrived.  Drivers take their serial
+// port type as a template parameter, so an overload for a port that can hand
+// over a whole block is picked up at compile time.
+template<class S>
+size_t TinyGsmReadAvailable(S& stream, uint8_t* buf, size_t len)
+{
+  size_t n = 0;
+  while (n < len && TinyGsmPort<S>::available(stream) > 0) {
+    buf[n++] = TinyGsmPort<S>::read(stream);
+  }
+  return n;
+}
+
 template<class T>
 uint32_t TinyGsmAutoBaud(T& SerialAT, uint32_t minimum = 9600, uint32_t maximum = 115200)
 {
@@ -199,6 +492,43 @@ String TinyGsmDecodeHex16bit(String &instr) {
 }
 
 
+// Socket events reported by poll()
+#define TINY_GSM_POLL_READ   0x01
+#define TINY_GSM_POLL_WRITE  0x02
+#define TINY_GSM_POLL_CLOSED 0x04
+
+// Fields of the cached modem status, see TINY_GSM_MODEM_STATUS()
+#define TINY_GSM_STATUS_SIGNAL       0x01
+#define TINY_GSM_STATUS_REGISTRATION 0x02
+#define TINY_GSM_STATUS_GPRS         0x04
+#define TINY_GSM_STATUS_BATTERY      0x08
+#define TINY_GSM_STATUS_ALL          0x0F
+
+// How long a cached status field is served before it is asked for again
+#ifndef TINY_GSM_STATUS_MAX_AGE
+  #define TINY_GSM_STATUS_MAX_AGE 5000L
+#endif
+
+// Keeps IMEI, SIM CCID, modem name and info in RAM once read, about 140
+// bytes per modem; compact builds ask the modem each time unless set to 1
+#ifndef TINY_GSM_IDENTITY_CACHE
+  #if defined(TINY_GSM_COMPACT)
+    #define TINY_GSM_IDENTITY_CACHE 0
+  #else
+    #define TINY_GSM_IDENTITY_CACHE 1
+  #endif
+#endif
+
+// Room for the cached identity strings, see TINY_GSM_MODEM_IDENTITY()
+// (longer values are truncated)
+#ifndef TINY_GSM_MODEM_NAME_SIZE
+  #define TINY_GSM_MODEM_NAME_SIZE 32
+#endif
+#ifndef TINY_GSM_MODEM_INFO_SIZE
+  #define TINY_GSM_MODEM_INFO_SIZE 64
+#endif
+
+
 // Connect to a IP address given as an IPAddress object by
 // converting said IP address to text
 #define TINY_GSM_CLIENT_CONNECT_OVERLOADS() \
@@ -221,12 +551,30 @@ String TinyGsmDecodeHex16bit(String &instr) {
   }
 
 
-// Writes data out on the client using the modem send functionality
-#define TINY_GSM_CLIENT_WRITE() \
+#define TINY_GSM_CLIENT_READ_OVERLOAD() \
+  virtual int read() { \
+    uint8_t c; \
+    if (read(&c, 1) == 1) { \
+      return c; \
+    } \
+    return -1; \
+  }
+
+
+// Read, write, peek, flush, and connected functions of a transparent (data
+// mode) client.  Data goes straight to and from the modem stream; pause()
+// escapes to command mode so other modem functions can be used, and any
+// read or write resumes data mode again.  closeTrailer is what the modem
+// prints when the far end closes, e.g. GSM_NL "CLOSED" GSM_NL: it ends the
+// connection and is never passed on as data.  Bytes that may begin it are
+// held back until it is complete, something else follows, or
+// TINY_GSM_DATA_MODE_TRAILER_WAIT passes without more.
+#define TINY_GSM_CLIENT_TRANSPARENT(closeTrailer) \
   virtual size_t write(const uint8_t *buf, size_t size) { \
     TINY_GSM_YIELD(); \
-    at->maintain(); \
-    return at->modemSend(buf, size, mux); \
+    TINY_GSM_LOCK(at); \
+    if (!resume()) return 0; \
+    return at->stream.write(buf, size); \
   } \
   \
   virtual size_t write(uint8_t c) {\
@@ -236,180 +584,563 @@ String TinyGsmDecodeHex16bit(String &instr) {
   virtual size_t write(const char *str) { \
     if (str == NULL) return 0; \
     return write((const uint8_t *)str, strlen(str)); \
-  }
-
-
-// Returns the combined number of characters available in the TinyGSM fifo
-// and the modem chips internal fifo, doing an extra check-in with the
-// modem to see if anything has arrived without a UURC.
-#define TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK() \
+  } \
+  \
+  /* May count a close report still to come, which read() then drops */ \
   virtual int available() { \
     TINY_GSM_YIELD(); \
-    if (!rx.size()) { \
-      /* Workaround: sometimes module forgets to notify about data arrival.
-      TODO: Currently we ping the module periodically,
-      but maybe there's a better indicator that we need to poll */ \
-      if (millis() - prev_check > 500) { \
-        got_data = true; \
-        prev_check = millis(); \
+    TINY_GSM_LOCK(at); \
+    if (!resume()) return 0; \
+    int n = at->streamAvailable(); \
+    return (trailer_give_end - trailer_give) + (trailer_extra >= 0) + \
+           (n > 0 ? trailer_held + n : 0); \
+  } \
+  \
+  virtual int read(uint8_t *buf, size_t size) { \
+    TINY_GSM_YIELD(); \
+    TINY_GSM_LOCK(at); \
+    if (!resume()) return 0; \
+    size_t cnt = 0; \
+    while (cnt < size) { \
+      int c = trailerRead(); \
+      if (c < 0) break; \
+      buf[cnt++] = c; \
+    } \
+    return cnt; \
+  } \
+  TINY_GSM_CLIENT_READ_OVERLOAD() \
+  \
+  virtual int peek() { \
+    TINY_GSM_LOCK(at); \
+    if (!resume()) return -1; \
+    if (trailer_give < trailer_give_end) return (uint8_t)closeTrailer[trailer_give]; \
+    if (trailer_extra >= 0) return trailer_extra; \
+    trailerScan(); \
+    if (at->streamAvailable() <= 0) return -1; \
+    return trailer_held ? (uint8_t)closeTrailer[0] : at->stream.peek(); \
+  } \
+  \
+  virtual void flush() { at->stream.flush(); } \
+  \
+  virtual uint8_t connected() { \
+    if (data_mode) { \
+      TINY_GSM_LOCK(at); \
+      trailerScan(); \
+    } \
+    return sock_connected; \
+  } \
+  virtual operator bool() { return connected(); } \
+  \
+  bool pause() { \
+    TINY_GSM_LOCK(at); \
+    if (data_mode && at->modemEscapeDataMode()) { \
+      data_mode = false; \
+    } \
+    return !data_mode; \
+  } \
+  \
+  bool resume() { \
+    if (!data_mode && sock_connected) { \
+      data_mode = at->modemResumeDataMode(); \
+    } \
+    return data_mode; \
+  } \
+  \
+  bool isDataMode() { \
+    return data_mode; \
+  } \
+  \
+  /* Takes bytes from the stream only while they match the close report */ \
+  void trailerScan() { \
+    if (trailer_give < trailer_give_end || trailer_extra >= 0) return; \
+    while (at->streamAvailable() > 0 && \
+           at->stream.peek() == (uint8_t)closeTrailer[trailer_held]) { \
+      at->streamRead(); \
+      trailer_held_at = millis(); \
+      if (!closeTrailer[++trailer_held]) { \
+        trailerClosed(); \
+        return; \
       } \
-      at->maintain(); \
     } \
-    return rx.size() + sock_available; \
-  }
-
-
-// Returns the combined number of characters available in the TinyGSM fifo and
-// the modem chips internal fifo.  Use this if you don't expect to miss any URC's.
-#define TINY_GSM_CLIENT_AVAILABLE_NO_BUFFER_CHECK() \
-  virtual int available() { \
-    TINY_GSM_YIELD(); \
-    if (!rx.size()) { \
-      at->maintain(); \
+    if (trailer_held && at->streamAvailable() <= 0 && \
+        millis() - trailer_held_at >= TINY_GSM_DATA_MODE_TRAILER_WAIT) { \
+      trailerRelease(-1); \
     } \
-    return rx.size() + sock_available; \
-  }
-
-
-// Returns the number of characters avaialable in the TinyGSM fifo
-// Assumes the modem chip has no internal fifo
-#define TINY_GSM_CLIENT_AVAILABLE_NO_MODEM_FIFO() \
-  virtual int available() { \
-    TINY_GSM_YIELD(); \
-    if (!rx.size() && sock_connected) { \
-      at->maintain(); \
+  } \
+  \
+  int trailerRead() { \
+    for (;;) { \
+      if (trailer_give < trailer_give_end) { \
+        return (uint8_t)closeTrailer[trailer_give++]; \
+      } \
+      int c = trailer_extra; \
+      trailer_extra = -1; \
+      if (c < 0) { \
+        trailerScan(); \
+        if (!sock_connected) return -1; \
+        if (trailer_give < trailer_give_end) continue; \
+        if (at->streamAvailable() <= 0) return -1; \
+        c = at->streamRead(); \
+      } \
+      if (c == (uint8_t)closeTrailer[trailer_held]) { \
+        trailer_held_at = millis(); \
+        if (!closeTrailer[++trailer_held]) trailerClosed(); \
+        continue; \
+      } \
+      if (!trailer_held) return c; \
+      trailerRelease(c); \
     } \
-    return rx.size(); \
+  } \
+  \
+  /* Hands the held bytes out as data after all, then c */ \
+  void trailerRelease(int c) { \
+    trailer_give = 0; \
+    trailer_give_end = trailer_held; \
+    trailer_held = 0; \
+    trailer_extra = c; \
+  } \
+  \
+  void trailerClosed() { \
+    trailerReset(); \
+    sock_connected = false; \
+    data_mode = false; \
+  } \
+  \
+  void trailerReset() { \
+    trailer_held = trailer_give = trailer_give_end = 0; \
+    trailer_extra = -1; \
+  } \
+  \
+  uint8_t   trailer_held = 0; \
+  uint8_t   trailer_give = 0; \
+  uint8_t   trailer_give_end = 0; \
+  int16_t   trailer_extra = -1; \
+  uint32_t  trailer_held_at = 0;
+
+
+// Requests of a modem-side HTTP client.  The response body is left on the
+// modem and streamed into a Print sink by readBody().  contentLength() is
+// 0xFFFFFFFF if the server did not send one and the modem can't tell.
+#define TINY_GSM_HTTP_REQUESTS() \
+  int get(const char* url, uint32_t timeout_ms = 60000L) { \
+    return request(url, false, NULL, NULL, 0, timeout_ms); \
+  } \
+  \
+  int post(const char* url, const char* contentType, \
+           const uint8_t* body, size_t len, uint32_t timeout_ms = 60000L) { \
+    return request(url, true, contentType, body, len, timeout_ms); \
+  } \
+  \
+  int post(const char* url, const char* contentType, const char* body, \
+           uint32_t timeout_ms = 60000L) { \
+    return post(url, contentType, (const uint8_t*)body, strlen(body), timeout_ms); \
+  } \
+  \
+  int request(const char* url, bool isPost, const char* contentType, \
+              const uint8_t* body, size_t len, uint32_t timeout_ms) { \
+    TINY_GSM_LOCK(at); \
+    read_pos = 0; \
+    status_code = at->httpRequest(url, isPost, contentType, body, len, \
+                                  timeout_ms, &content_length); \
+    return status_code; \
+  } \
+  \
+  int status() { \
+    return status_code; \
+  } \
+  \
+  uint32_t contentLength() { \
+    return content_length; \
+  } \
+  \
+  size_t readBody(Print& sink) { \
+    TINY_GSM_LOCK(at); \
+    size_t total = 0; \
+    while (read_pos < content_length) { \
+      size_t n = at->httpRead(sink, read_pos, content_length - read_pos); \
+      if (n == 0) break; \
+      read_pos += n; \
+      total += n; \
+    } \
+    return total; \
+  } \
+  \
+  void stop() { \
+    TINY_GSM_LOCK(at); \
+    at->httpEnd(); \
+    status_code = 0; \
+    content_length = 0; \
+    read_pos = 0; \
   }
 
 
-#define TINY_GSM_CLIENT_READ_OVERLOAD() \
-  virtual int read() { \
-    uint8_t c; \
-    if (read(&c, 1) == 1) { \
-      return c; \
+// Moves files between the host and the modem's own storage.  Blocks go over
+// the UART as raw binary, never hex encoded, in TINY_GSM_HTTP_CHUNK pieces
+// (or less where the modem has a smaller limit).
+#define TINY_GSM_MODEM_FILE_ACCESS() \
+  size_t fileStream(const char* filename, Print& sink, uint32_t offset = 0) { \
+    uint32_t size = fileSize(filename); \
+    size_t total = 0; \
+    while (offset < size) { \
+      size_t len = TinyGsmMin(size - offset, (uint32_t)TINY_GSM_HTTP_CHUNK); \
+      size_t n = fileReadBlock(filename, sink, offset, len); \
+      if (n == 0) break; \
+      offset += n; \
+      total += n; \
     } \
-    return -1; \
+    return total; \
+  } \
+  \
+  size_t fileWrite(const char* filename, const uint8_t* data, size_t len, \
+                   bool append = false) { \
+    size_t total = 0; \
+    do { \
+      size_t chunk = TinyGsmMin(len - total, (size_t)TINY_GSM_HTTP_CHUNK); \
+      size_t n = fileWriteBlock(filename, data + total, chunk, append || total > 0); \
+      if (n == 0) break; \
+      total += n; \
+    } while (total < len); \
+    return total; \
   }
 
-// Reads characters out of the TinyGSM fifo, and from the modem chips internal
-// fifo if avaiable, also double checking with the modem if data has arrived
-// without issuing a UURC.
-#define TINY_GSM_CLIENT_READ_WITH_BUFFER_CHECK() \
-  virtual int read(uint8_t *buf, size_t size) { \
-    TINY_GSM_YIELD(); \
-    at->maintain(); \
-    size_t cnt = 0; \
-    while (cnt < size) { \
-      size_t chunk = TinyGsmMin(size-cnt, rx.size()); \
-      if (chunk > 0) { \
-        rx.get(buf, chunk); \
-        buf += chunk; \
-        cnt += chunk; \
-        continue; \
+
+// The file system of Quectel modems (+QFLST, +QFOPEN, +QFREAD, +QFWRITE ...).
+// prefix is the storage in front of every file name, e.g. "UFS:" on the BG96
+// or "" for the default.  Leaves the class in a protected section.
+#define TINY_GSM_MODEM_FILE_QUECTEL(prefix) \
+  /* One name per line */ \
+  String fileList() { \
+    String res; \
+    sendAT(GF("+QFLST=\"" prefix "*\"")); \
+    /* +QFLST: "<filename>",<size> */ \
+    /* Stops at the final OK (or ERROR when there are no files) */ \
+    while (waitResponse(GF(GSM_NL "+QFLST:"), GFP(GSM_OK), GFP(GSM_ERROR)) == 1) { \
+      streamSkipUntil('"'); \
+      String name = stream.readStringUntil('"'); \
+      streamSkipUntil('\n'); \
+      int colon = name.indexOf(':'); \
+      if (res.length()) { \
+        res += '\n'; \
       } \
-      /* Workaround: sometimes module forgets to notify about data arrival.
-      TODO: Currently we ping the module periodically,
-      but maybe there's a better indicator that we need to poll */ \
-      if (millis() - prev_check > 500) { \
-        got_data = true; \
-        prev_check = millis(); \
+      res += name.substring(colon + 1);  /* Without a storage prefix */ \
+    } \
+    return res; \
+  } \
+  \
+  uint32_t fileSize(const char* filename) { \
+    sendAT(GF("+QFLST=\"" prefix), filename, '"'); \
+    if (waitResponse(GF(GSM_NL "+QFLST:")) != 1) { \
+      return 0; \
+    } \
+    streamSkipUntil(','); \
+    uint32_t size = stream.readStringUntil('\n').toInt(); \
+    waitResponse(); \
+    return size; \
+  } \
+  \
+  size_t fileReadBlock(const char* filename, Print& sink, uint32_t offset, size_t len) { \
+    int handle = fileOpen(filename, 2);  /* Read only */ \
+    if (handle < 0) { \
+      return 0; \
+    } \
+    size_t copied = 0; \
+    sendAT(GF("+QFSEEK="), handle, ',', offset, GF(",0")); \
+    if (waitResponse() == 1) { \
+      sendAT(GF("+QFREAD="), handle, ',', len); \
+      if (waitResponse(GF(GSM_NL "CONNECT ")) == 1) { \
+        size_t n = stream.readStringUntil('\n').toInt(); \
+        copied = streamCopy(sink, n, 10000L); \
+        waitResponse(); \
       } \
-      /* TODO: Read directly into user buffer? */ \
-      at->maintain(); \
-      if (sock_available > 0) { \
-        int n = at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux); \
-        if (n == 0) break; \
-      } else { \
-        break; \
+    } \
+    fileClose(handle); \
+    return copied; \
+  } \
+  \
+  size_t fileWriteBlock(const char* filename, const uint8_t* data, size_t len, bool append) { \
+    if (!append) { \
+      fileDelete(filename); \
+    } \
+    int handle = fileOpen(filename, 0);  /* Create if missing */ \
+    if (handle < 0) { \
+      return 0; \
+    } \
+    size_t written = 0; \
+    sendAT(GF("+QFSEEK="), handle, GF(",0,2"));  /* To the end */ \
+    if (waitResponse() == 1) { \
+      sendAT(GF("+QFWRITE="), handle, ',', len); \
+      if (waitResponse(GF("CONNECT" GSM_NL)) == 1) { \
+        stream.write(data, len); \
+        stream.flush(); \
+        /* +QFWRITE: <written>,<total size> */ \
+        if (waitResponse(10000L, GF(GSM_NL "+QFWRITE:")) == 1) { \
+          written = stream.readStringUntil(',').toInt(); \
+          waitResponse(); \
+        } \
       } \
     } \
-    return cnt; \
+    fileClose(handle); \
+    return written; \
+  } \
+  \
+  bool fileDelete(const char* filename) { \
+    sendAT(GF("+QFDEL=\"" prefix), filename, '"'); \
+    return waitResponse() == 1; \
   } \
-  TINY_GSM_CLIENT_READ_OVERLOAD()
+  \
+protected: \
+  \
+  int fileOpen(const char* filename, uint8_t mode) { \
+    sendAT(GF("+QFOPEN=\"" prefix), filename, GF("\","), mode); \
+    if (waitResponse(GF(GSM_NL "+QFOPEN:")) != 1) { \
+      return -1; \
+    } \
+    int handle = stream.readStringUntil('\n').toInt(); \
+    waitResponse(); \
+    return handle; \
+  } \
+  \
+  bool fileClose(int handle) { \
+    sendAT(GF("+QFCLOSE="), handle); \
+    return waitResponse() == 1; \
+  }
 
 
-// Reads characters out of the TinyGSM fifo, and from the modem chips internal
-// fifo if avaiable.  Use this if you don't expect to miss any URC's.
-#define TINY_GSM_CLIENT_READ_NO_BUFFER_CHECK() \
-  virtual int read(uint8_t *buf, size_t size) { \
-    TINY_GSM_YIELD(); \
-    at->maintain(); \
-    size_t cnt = 0; \
-    while (cnt < size) { \
-      size_t chunk = TinyGsmMin(size-cnt, rx.size()); \
-      if (chunk > 0) { \
-        rx.get(buf, chunk); \
-        buf += chunk; \
-        cnt += chunk; \
-        continue; \
-      } \
-      /* TODO: Read directly into user buffer? */ \
-      at->maintain(); \
-      if (sock_available > 0) { \
-        int n = at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux); \
-        if (n == 0) break; \
-      } else { \
-        break; \
-      } \
+// The file system of u-blox modems (+ULSTFILE, +URDBLOCK, +UDWNFILE ...)
+#define TINY_GSM_MODEM_FILE_UBLOX() \
+  /* One name per line */ \
+  String fileList() { \
+    /* +ULSTFILE: "<name1>","<name2>",... */ \
+    sendAT(GF("+ULSTFILE=0")); \
+    if (waitResponse(GF(GSM_NL "+ULSTFILE:")) != 1) { \
+      return ""; \
     } \
-    return cnt; \
+    String res = stream.readStringUntil('\n'); \
+    waitResponse(); \
+    res.trim(); \
+    res.replace("\",\"", "\n"); \
+    res.replace("\"", ""); \
+    return res; \
+  } \
+  \
+  uint32_t fileSize(const char* filename) { \
+    sendAT(GF("+ULSTFILE=2,\""), filename, '"'); \
+    if (waitResponse(GF(GSM_NL "+ULSTFILE:")) != 1) { \
+      return 0; \
+    } \
+    uint32_t size = stream.readStringUntil('\n').toInt(); \
+    waitResponse(); \
+    return size; \
+  } \
+  \
+  size_t fileReadBlock(const char* filename, Print& sink, uint32_t offset, size_t len) { \
+    len = TinyGsmMin(len, (size_t)512);  /* Largest block the modem returns */ \
+    /* +URDBLOCK: "<filename>",<size>,"<data>" */ \
+    sendAT(GF("+URDBLOCK=\""), filename, GF("\","), offset, ',', len); \
+    if (waitResponse(GF(GSM_NL "+URDBLOCK:")) != 1) { \
+      return 0; \
+    } \
+    streamSkipUntil(','); \
+    size_t n = stream.readStringUntil(',').toInt(); \
+    streamSkipUntil('"'); \
+    size_t copied = streamCopy(sink, n, 10000L); \
+    waitResponse(); \
+    return copied; \
+  } \
+  \
+  size_t fileWriteBlock(const char* filename, const uint8_t* data, size_t len, bool append) { \
+    if (!append) { \
+      fileDelete(filename); \
+    } \
+    /* Data for an existing file is appended to it */ \
+    sendAT(GF("+UDWNFILE=\""), filename, GF("\","), len); \
+    if (waitResponse(GF(">")) != 1) { \
+      return 0; \
+    } \
+    stream.write(data, len); \
+    stream.flush(); \
+    return (waitResponse(10000L) == 1) ? len : 0; \
   } \
-  TINY_GSM_CLIENT_READ_OVERLOAD()
+  \
+  bool fileDelete(const char* filename) { \
+    sendAT(GF("+UDELFILE=\""), filename, '"'); \
+    return waitResponse() == 1; \
+  }
 
 
-// Reads characters out of the TinyGSM fifo, waiting for any URC's from the
-// modem for new data if there's nothing in the fifo.  This assumes the
-//modem chip itself has no fifo.
-#define TINY_GSM_CLIENT_READ_NO_MODEM_FIFO() \
-  virtual int read(uint8_t *buf, size_t size) { \
-    TINY_GSM_YIELD(); \
-    size_t cnt = 0; \
-    uint32_t _startMillis = millis(); \
-    while (cnt < size && millis() - _startMillis < _timeout) { \
-      size_t chunk = TinyGsmMin(size-cnt, rx.size()); \
-      if (chunk > 0) { \
-        rx.get(buf, chunk); \
-        buf += chunk; \
-        cnt += chunk; \
-        continue; \
-      } \
-      /* TODO: Read directly into user buffer? */ \
-      if (!rx.size() && sock_connected) { \
-        at->maintain(); \
-      } \
-    } \
-    return cnt; \
+// Called with the bytes stored so far and the expected total (0 if unknown)
+typedef void (*TinyGsmProgress)(uint32_t done, uint32_t total);
+
+// Downloads a URL into the modem's own storage at network speed, then lets
+// the file be drained in offset-based blocks at whatever pace the host can
+// keep up with.  Some modems store the response header in front of the body:
+// bodyOffset is where the body starts (0 where only the body is stored), and
+// downloadStream() offsets count from there, so an interrupted transfer is
+// resumed by calling it again with the offset reached so far.
+#define TINY_GSM_MODEM_FILE_DOWNLOAD(bodyOffset) \
+  uint32_t downloadBodyOffset() { \
+    return (bodyOffset); \
   } \
   \
-  virtual int read() { \
-    uint8_t c; \
-    if (read(&c, 1) == 1) { \
-      return c; \
+  size_t downloadStream(const char* filename, Print& sink, uint32_t offset = 0) { \
+    return fileStream(filename, sink, downloadBodyOffset() + offset); \
+  } \
+  \
+  uint32_t downloadFile(const char* url, const char* filename, \
+                        TinyGsmProgress progress = NULL, \
+                        uint32_t timeout_ms = 600000L) { \
+    if (!downloadBegin(url, filename)) { \
+      return 0; \
+    } \
+    uint32_t done = 0; \
+    uint32_t total = 0; \
+    unsigned long startMillis = millis(); \
+    for (;;) { \
+      int8_t state = downloadStatus(filename, &done, &total); \
+      if (state < 0) { \
+        return 0; \
+      } \
+      if (progress) { \
+        progress(done, total); \
+      } \
+      if (state > 0) { \
+        return done; \
+      } \
+      if (millis() - startMillis >= timeout_ms) { \
+        return 0; \
+      } \
+      delay(TINY_GSM_DOWNLOAD_POLL); \
     } \
-    return -1; \
   }
 
 
-// The peek, flush, and connected functions
-#define TINY_GSM_CLIENT_PEEK_FLUSH_CONNECTED() \
-  virtual int peek() { return -1; } /* TODO */ \
+// Downloads over the u-blox HTTP client (+UHTTP, +UHTTPC) into a file that
+// holds the response header in front of the body.  Needs download_state and
+// download_body members, +UUHTTPCR sets download_state when it is done.
+#define TINY_GSM_MODEM_DOWNLOAD_UBLOX() \
+  /* The file holds the HTTP response header in front of the body, which */ \
+  /* downloadStream() skips once the download is complete */ \
+  bool downloadBegin(const char* url, const char* filename) { \
+    download_state = -1; \
+    download_body = 0; \
+    String target(url); \
+    bool https = target.startsWith("https"); \
+    int start = target.indexOf("://"); \
+    start = (start < 0) ? 0 : start + 3; \
+    int slash = target.indexOf('/', start); \
+    if (slash < 0) { \
+      slash = target.length(); \
+    } \
+    String host = target.substring(start, slash); \
+    String path = (slash < (int)target.length()) ? target.substring(slash) : String("/"); \
+    uint16_t port = https ? 443 : 80; \
+    int colon = host.indexOf(':'); \
+    if (colon >= 0) { \
+      port = host.substring(colon + 1).toInt(); \
+      host = host.substring(0, colon); \
+    } \
   \
-  virtual void flush() { at->stream.flush(); } \
+    sendAT(GF("+UHTTP=0"));  /* Reset profile 0 */ \
+    waitResponse(); \
+    sendAT(GF("+UHTTP=0,1,\""), host, '"'); \
+    if (waitResponse() != 1) { \
+      return false; \
+    } \
+    sendAT(GF("+UHTTP=0,5,"), port); \
+    waitResponse(); \
+    sendAT(GF("+UHTTP=0,6,"), https); \
+    if (waitResponse() != 1 && https) { \
+      return false; \
+    } \
+    fileDelete(filename);  /* Don't append to an old copy */ \
+    /* Command 1 is a GET */ \
+    sendAT(GF("+UHTTPC=0,1,\""), path, GF("\",\""), filename, '"'); \
+    if (waitResponse() != 1) { \
+      return false; \
+    } \
+    download_state = 0; \
+    return true; \
+  } \
   \
-  virtual uint8_t connected() { \
-    if (available()) { \
-      return true; \
+  /* 1 when complete, 0 while in progress, -1 on failure or a non-2xx status */ \
+  int8_t downloadStatus(const char* filename, uint32_t* done, uint32_t* total) { \
+    *done = fileSize(filename);  /* Also picks up a pending +UUHTTPCR */ \
+    if (download_state > 0 && !download_body && !downloadCheckHeader(filename)) { \
+      download_state = -1; \
     } \
-    return sock_connected; \
+    if (download_state > 0) { \
+      *done = (*done > download_body) ? *done - download_body : 0; \
+    } \
+    *total = (download_state > 0) ? *done : 0; \
+    return download_state; \
   } \
-  virtual operator bool() { return connected(); }
+  \
+  /* Reads the stored header up to the blank line and checks the status */ \
+  bool downloadCheckHeader(const char* filename) { \
+    TinyGsmHttpHeader header; \
+    uint32_t size = fileSize(filename); \
+    for (uint32_t offset = 0; offset < size && !header.bodyOffset(); ) { \
+      size_t n = fileReadBlock(filename, header, offset, size - offset); \
+      if (n == 0) break; \
+      offset += n; \
+    } \
+    DBG("### HTTP:", header.statusCode(), "body at", header.bodyOffset()); \
+    if (header.statusCode() < 200 || header.statusCode() > 299 || !header.bodyOffset()) { \
+      return false; \
+    } \
+    download_body = header.bodyOffset(); \
+    return true; \
+  }
 
 
 // Set baud rate via the V.25TER standard IPR command
 #define TINY_GSM_MODEM_SET_BAUD_IPR() \
   void setBaud(unsigned long baud) { \
     sendAT(GF("+IPR="), baud); \
+    stream.flush();  /* Out before the caller changes the port speed */ \
+  }
+
+
+// Enable or disable RTS/CTS hardware flow control via the V.25TER IFC command
+#define TINY_GSM_MODEM_SET_FLOW_CONTROL_IFC() \
+  bool setHardwareFlowControl(bool enable = true) { \
+    if (enable) { \
+      TINY_GSM_RTS_BEGIN(); \
+      sendAT(GF("+IFC=2,2")); \
+    } else { \
+      sendAT(GF("+IFC=0,0")); \
+    } \
+    return waitResponse() == 1; \
+  }
+
+
+// De-asserts RTS while any socket fifo is above the high watermark, so a
+// modem that pushes data on its own holds it instead of overflowing the fifo
+#define TINY_GSM_MODEM_UPDATE_RTS() \
+  void updateRts() { \
+    bool ready = true; \
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) { \
+      GsmClient* sock = sockets[mux]; \
+      if (sock && sock->rx.size() >= TINY_GSM_RX_HIGH_WATERMARK) { \
+        ready = false; \
+      } \
+    } \
+    TINY_GSM_RTS(ready); \
+  }
+
+
+// Leaves data mode with the "+++" escape sequence and returns to it with ATO
+#define TINY_GSM_MODEM_DATA_MODE_SWITCH() \
+  bool modemEscapeDataMode() { \
+    delay(TINY_GSM_DATA_MODE_GUARD_TIME); \
+    stream.print(GF("+++")); \
+    stream.flush(); \
+    return waitResponse(TINY_GSM_DATA_MODE_GUARD_TIME + 1000L) == 1; \
+  } \
+  \
+  bool modemResumeDataMode() { \
+    sendAT(GF("O")); \
+    return waitResponse(GF("CONNECT" GSM_NL)) == 1; \
   }
 
 
@@ -429,6 +1160,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
 // to see if any data is avaiable
 #define TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS() \
   void maintain() { \
+    TINY_GSM_LOCK(this); \
     for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) { \
       GsmClient* sock = sockets[mux]; \
       if (sock && sock->got_data) { \
@@ -436,9 +1168,126 @@ String TinyGsmDecodeHex16bit(String &instr) {
         sock->sock_available = modemGetAvailable(mux); \
       } \
     } \
-    while (stream.available()) { \
+    while (streamAvailable()) { \
       waitResponse(15, NULL, NULL); \
     } \
+    prefetch(); \
+  }
+
+
+// Reads ahead for one socket per call, taking turns so a busy socket can't
+// starve the others.  A socket is topped up to TINY_GSM_PREFETCH bytes once
+// its rx fifo is down to half that, so small reads don't each cost a command.
+#if TINY_GSM_PREFETCH
+#define TINY_GSM_MODEM_PREFETCH() \
+  void prefetch() { \
+    for (int i = 0; i < TINY_GSM_MUX_COUNT; i++) { \
+      GsmClient* sock = sockets[prefetch_next]; \
+      prefetch_next = (prefetch_next + 1) % TINY_GSM_MUX_COUNT; \
+      if (!sock || !sock->sock_available || \
+          sock->rx.size() > (size_t)TINY_GSM_PREFETCH / 2) { \
+        continue; \
+      } \
+      size_t room = TinyGsmMin((size_t)sock->rx.free(), \
+                               (size_t)TINY_GSM_PREFETCH - sock->rx.size()); \
+      room = TinyGsmMin(room, (size_t)Traits::max_read); \
+      if (room) { \
+        size_t n = modemRead(TinyGsmMin(room, (size_t)sock->sock_available), sock->mux); \
+        TINY_GSM_STATS_MODEM_DATA(0, n); \
+        TINY_GSM_METER(sock, modemRead()); \
+        return; \
+      } \
+    } \
+  } \
+  \
+  uint8_t prefetch_next = 0;
+#else
+#define TINY_GSM_MODEM_PREFETCH() \
+  void prefetch() {}
+#endif
+
+
+// Waits for the URC that ends a connect begun with modemConnectStart()
+#define TINY_GSM_MODEM_CONNECT_WAIT() \
+  bool modemConnectWait(uint8_t mux, uint32_t timeout_ms) { \
+    GsmClient* sock = sockets[mux]; \
+    uint32_t startMillis = millis(); \
+    while (sock->sock_connecting && millis() - startMillis < timeout_ms) { \
+      waitResponse(10, NULL, NULL); \
+    } \
+    if (sock->sock_connecting) { \
+      sock->sock_connecting = false; \
+      TINY_GSM_METER(sock, connectEnd()); \
+      return false; \
+    } \
+    return sock->sock_connected; \
+  }
+
+
+// Settles a connect on SIMCom's "<mux>, CONNECT OK" and friends.  These end
+// in "OK", so waitResponse() looks for them before the caller's responses.
+#define TINY_GSM_MODEM_CONNECT_RESULT_CIPSTART() \
+  bool modemConnectResult(const String& data) { \
+    bool ok; \
+    if (data.endsWith(GF("CONNECT OK" GSM_NL)) || \
+        data.endsWith(GF("ALREADY CONNECT" GSM_NL))) { \
+      ok = true; \
+    } else if (data.endsWith(GF("CONNECT FAIL" GSM_NL)) || \
+               data.endsWith(GF("CLOSE OK" GSM_NL))) {  /* TLS handshake failed */ \
+      ok = false; \
+    } else { \
+      return false; \
+    } \
+    int nl = data.lastIndexOf(GSM_NL, data.length() - 3); \
+    int start = (nl < 0) ? 0 : nl + 2; \
+    int coma = data.indexOf(',', start); \
+    if (coma < 0) { \
+      return false; \
+    } \
+    int mux = data.substring(start, coma).toInt(); \
+    if (mux < 0 || mux >= TINY_GSM_MUX_COUNT || !sockets[mux] || \
+        !sockets[mux]->sock_connecting) { \
+      return false; \
+    } \
+    sockets[mux]->sock_connecting = false; \
+    sockets[mux]->sock_connected = ok; \
+    TINY_GSM_METER(sockets[mux], connectEnd()); \
+    DBG("### Connect:", mux, ok); \
+    return true; \
+  }
+
+
+// Waits up to timeout_ms for a socket event, running the URC pump once per
+// pass.  Fills one bit per mux in each mask given and returns true as soon
+// as any of them is non-zero; a NULL mask isn't waited on.
+#define TINY_GSM_MODEM_POLL() \
+  bool poll(uint32_t timeout_ms, uint32_t* readMask, \
+            uint32_t* writeMask = NULL, uint32_t* closedMask = NULL) { \
+    uint32_t startMillis = millis(); \
+    for (;;) { \
+      uint32_t r = 0, w = 0, c = 0; \
+      { \
+        TINY_GSM_LOCK(this); \
+        maintain(); \
+        for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) { \
+          if (!sockets[mux]) continue; \
+          uint8_t ev = sockets[mux]->pollEvents(); \
+          if (ev & TINY_GSM_POLL_READ)   r |= 1UL << mux; \
+          if (ev & TINY_GSM_POLL_WRITE)  w |= 1UL << mux; \
+          if (ev & TINY_GSM_POLL_CLOSED) c |= 1UL << mux; \
+        } \
+      } \
+      if (readMask)   *readMask = r; \
+      if (writeMask)  *writeMask = w; \
+      if (closedMask) *closedMask = c; \
+      if ((readMask && r) || (writeMask && w) || (closedMask && c)) { \
+        return true; \
+      } \
+      if (millis() - startMillis >= timeout_ms) { \
+        return false; \
+      } \
+      TINY_GSM_YIELD(); \
+    } \
   }
 
 
@@ -446,6 +1295,7 @@ String TinyGsmDecodeHex16bit(String &instr) {
 // modem has no internal fifo
 #define TINY_GSM_MODEM_MAINTAIN_LISTEN() \
   void maintain() { \
+    TINY_GSM_LOCK(this); \
     waitResponse(10, NULL, NULL); \
   }
 
@@ -575,49 +1425,309 @@ String TinyGsmDecodeHex16bit(String &instr) {
   }
 
 
+// Signal, registration, GPRS attach and battery, served from a cache.
+// getStatus() asks the modem only for fields older than their max age, all
+// in one command line ("AT+CSQ;+CREG?;+CGATT?;+CBC"), and the +CREG style
+// URCs, enabled on the first refresh, keep the registration current.
+// Call modemStatusUrc() from waitResponse() at the end of each line.
+#define TINY_GSM_MODEM_STATUS(regCommand, hasBattery) \
+  struct ModemStatus { \
+    int16_t   signal;         /* +CSQ 0-31, 99 unknown */ \
+    RegStatus registration; \
+    bool      gprs;           /* attached, +CGATT */ \
+    uint16_t  battery_mv;     /* 0 unknown */ \
+  }; \
+  \
+  /* fields: TINY_GSM_STATUS_* bits that must be fresh */ \
+  const ModemStatus& getStatus(uint8_t fields = TINY_GSM_STATUS_ALL) { \
+    TINY_GSM_LOCK(this); \
+    refreshStatus(fields); \
+    return status; \
+  } \
+  \
+  /* 0 asks the modem every time; TINY_GSM_COMPACT caps it at 65 s */ \
+  void setStatusMaxAge(uint8_t fields, uint32_t max_age_ms) { \
+    max_age_ms = TinyGsmMin(max_age_ms, (uint32_t)(TinyGsmTick)~0UL); \
+    for (uint8_t i = 0; i < 4; i++) { \
+      if (fields & (1 << i)) status_max_age[i] = max_age_ms; \
+    } \
+  } \
+  \
+  void invalidateStatus() { \
+    status_valid = 0; \
+    status_urc = false; \
+  } \
+  \
+  /* The line that ends data, if it's an unsolicited +CREG: <stat>[,...] */ \
+  bool modemStatusUrc(const String& data) { \
+    int start = data.lastIndexOf('\n', data.length() - 2) + 1; \
+    if (data.length() < (unsigned)start + 8 || data[start] != '+' || \
+        data.indexOf(GF("+" #regCommand ": "), start) != start) { \
+      return false; \
+    } \
+    start += sizeof("+" #regCommand ": ") - 1; \
+    int coma = data.indexOf(',', start); \
+    /* A URC carries <stat> first; a stray query reply "<n>,<stat>" second */ \
+    if (coma > 0 && data[coma + 1] != '"') { \
+      start = coma + 1; \
+    } \
+    status.registration = (RegStatus)data.substring(start).toInt(); \
+    statusFresh(TINY_GSM_STATUS_REGISTRATION); \
+    return true; \
+  } \
+  \
+  void statusFresh(uint8_t fields) { \
+    TinyGsmTick now = millis(); \
+    for (uint8_t i = 0; i < 4; i++) { \
+      if (fields & (1 << i)) status_at[i] = now; \
+    } \
+    status_valid |= fields; \
+  } \
+  \
+  void refreshStatus(uint8_t fields) { \
+    if (!(hasBattery)) fields &= ~TINY_GSM_STATUS_BATTERY; \
+    TinyGsmTick now = millis(); \
+    uint8_t stale = 0; \
+    for (uint8_t i = 0; i < 4; i++) { \
+      uint8_t bit = 1 << i; \
+      if ((fields & bit) && (!(status_valid & bit) || \
+                             (TinyGsmTick)(now - status_at[i]) >= status_max_age[i])) { \
+        stale |= bit; \
+      } \
+    } \
+    if (!stale) { \
+      return; \
+    } \
+    bool urc = !status_urc; \
+    sendAT(urc ? GF("+" #regCommand "=1;") : GF(""), \
+           (stale & 0x01) ? GF("+CSQ") : GF(""), \
+           (stale & 0x02) ? ((stale & 0x01) ? GF(";+" #regCommand "?") : GF("+" #regCommand "?")) : GF(""), \
+           (stale & 0x04) ? ((stale & 0x03) ? GF(";+CGATT?") : GF("+CGATT?")) : GF(""), \
+           (stale & 0x08) ? ((stale & 0x07) ? GF(";+CBC") : GF("+CBC")) : GF("")); \
+    uint8_t got = 0; \
+    if ((stale & 0x01) && waitResponse(GF(GSM_NL "+CSQ:")) == 1) { \
+      status.signal = stream.readStringUntil(',').toInt(); \
+      got |= TINY_GSM_STATUS_SIGNAL; \
+    } \
+    if ((stale & 0x02) && waitResponse(GF(GSM_NL "+" #regCommand ":")) == 1) { \
+      streamSkipUntil(','); /* Skip format */ \
+      status.registration = (RegStatus)stream.readStringUntil('\n').toInt(); \
+      got |= TINY_GSM_STATUS_REGISTRATION; \
+    } \
+    if ((stale & 0x04) && waitResponse(GF(GSM_NL "+CGATT:")) == 1) { \
+      status.gprs = stream.readStringUntil('\n').toInt() == 1; \
+      got |= TINY_GSM_STATUS_GPRS; \
+    } \
+    if ((stale & 0x08) && waitResponse(GF(GSM_NL "+CBC:")) == 1) { \
+      streamSkipUntil(','); /* Skip battery charge status */ \
+      streamSkipUntil(','); /* Skip battery charge level */ \
+      status.battery_mv = stream.readStringUntil('\n').toInt(); \
+      got |= TINY_GSM_STATUS_BATTERY; \
+    } \
+    /* An error ends the line early; what arrived before it still counts */ \
+    if (got == stale && waitResponse() == 1 && urc) { \
+      status_urc = true; \
+    } \
+    statusFresh(got); \
+  } \
+  \
+  ModemStatus   status = { 99, REG_UNKNOWN, false, 0 }; \
+  TinyGsmTick   status_at[4]; \
+  TinyGsmTick   status_max_age[4] = { TINY_GSM_STATUS_MAX_AGE, TINY_GSM_STATUS_MAX_AGE, \
+                                      TINY_GSM_STATUS_MAX_AGE, TINY_GSM_STATUS_MAX_AGE }; \
+  uint8_t       status_valid = 0; \
+  bool          status_urc = false;
+
+
+// IMEI, SIM CCID, modem name and modem info, asked for once per power cycle
+// and then served from fixed arrays.  Only real answers are kept: an empty
+// reply, or a placeholder name when the modem didn't answer, is asked for
+// again on the next call.  Call invalidateIdentity() from restart() and
+// poweroff().  Without TINY_GSM_IDENTITY_CACHE only the buffer overloads are
+// left, and they ask the modem every time.
+#if TINY_GSM_IDENTITY_CACHE
+#define TINY_GSM_MODEM_IDENTITY() \
+  const char* getCachedIMEI() { \
+    return identityField(0x01, ident_imei, sizeof(ident_imei)); \
+  } \
+  \
+  const char* getCachedSimCCID() { \
+    return identityField(0x02, ident_ccid, sizeof(ident_ccid)); \
+  } \
+  \
+  const char* getCachedModemName() { \
+    return identityField(0x04, ident_name, sizeof(ident_name)); \
+  } \
+  \
+  const char* getCachedModemInfo() { \
+    return identityField(0x08, ident_info, sizeof(ident_info)); \
+  } \
+  \
+  /* Copy into buf; returns the length, 0 if unknown */ \
+  size_t getIMEI(char* buf, size_t size) { \
+    return identityCopy(getCachedIMEI(), buf, size); \
+  } \
+  \
+  size_t getSimCCID(char* buf, size_t size) { \
+    return identityCopy(getCachedSimCCID(), buf, size); \
+  } \
+  \
+  size_t getModemName(char* buf, size_t size) { \
+    return identityCopy(getCachedModemName(), buf, size); \
+  } \
+  \
+  size_t getModemInfo(char* buf, size_t size) { \
+    return identityCopy(getCachedModemInfo(), buf, size); \
+  } \
+  \
+  void invalidateIdentity() { \
+    ident_valid = 0; \
+  } \
+  \
+  const char* identityField(uint8_t field, char* dst, size_t size) { \
+    TINY_GSM_LOCK(this); \
+    if (!(ident_valid & field)) { \
+      String res; \
+      bool ok; \
+      switch (field) { \
+        case 0x01: res = getIMEI(); ok = res.length(); break; \
+        case 0x02: res = getSimCCID(); ok = res.length(); break; \
+        case 0x04: ok = readModemName(res); break; \
+        default:   res = getModemInfo(); ok = res.length(); break; \
+      } \
+      strncpy(dst, ok ? res.c_str() : "", size - 1); \
+      dst[size - 1] = '\0'; \
+      if (ok) ident_valid |= field; \
+    } \
+    return dst; \
+  } \
+  \
+  static size_t identityCopy(const char* src, char* buf, size_t size) { \
+    if (!buf || !size) return 0; \
+    strncpy(buf, src, size - 1); \
+    buf[size - 1] = '\0'; \
+    return strlen(buf); \
+  } \
+  \
+  char          ident_imei[17] = ""; \
+  char          ident_ccid[23] = ""; \
+  char          ident_name[TINY_GSM_MODEM_NAME_SIZE] = ""; \
+  char          ident_info[TINY_GSM_MODEM_INFO_SIZE] = ""; \
+  uint8_t       ident_valid = 0;
+#else
+#define TINY_GSM_MODEM_IDENTITY() \
+  /* Copy into buf; returns the length, 0 if unknown */ \
+  size_t getIMEI(char* buf, size_t size) { \
+    return identityCopy(getIMEI(), buf, size); \
+  } \
+  \
+  size_t getSimCCID(char* buf, size_t size) { \
+    return identityCopy(getSimCCID(), buf, size); \
+  } \
+  \
+  size_t getModemName(char* buf, size_t size) { \
+    String res; \
+    return identityCopy(readModemName(res) ? res : String(), buf, size); \
+  } \
+  \
+  size_t getModemInfo(char* buf, size_t size) { \
+    return identityCopy(getModemInfo(), buf, size); \
+  } \
+  \
+  void invalidateIdentity() {} \
+  \
+  static size_t identityCopy(const String& src, char* buf, size_t size) { \
+    if (!buf || !size) return 0; \
+    strncpy(buf, src.c_str(), size - 1); \
+    buf[size - 1] = '\0'; \
+    return strlen(buf); \
+  }
+#endif
+
+
+// For drivers whose getModemName() is a constant rather than a query
+#define TINY_GSM_MODEM_READ_NAME_CONSTANT() \
+  bool readModemName(String& name) { \
+    name = getModemName(); \
+    return true; \
+  }
+
+
 // Yields up to a time-out period and then reads a character from the stream into the mux FIFO
 // TODO:  Do we need to wait two _timeout periods for no character return?  Will wait once in the first
 // "while !stream.available()" and then will wait again in the stream.read() function.
 #define TINY_GSM_MODEM_STREAM_TO_MUX_FIFO_WITH_DOUBLE_TIMEOUT \
   uint32_t startMillis = millis(); \
-  while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); } \
-  char c = stream.read(); \
+  while (!streamAvailable() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); } \
+  char c = streamRead(); \
   sockets[mux]->rx.put(c);
 
 
 // Utility templates for writing/skipping characters on a stream
 #define TINY_GSM_MODEM_STREAM_UTILITIES() \
+  /* Direct calls on the port for the read loops, see TinyGsmPort */ \
+  int streamAvailable() { \
+    return TinyGsmPort<StreamT>::available(stream); \
+  } \
+  \
+  int streamRead() { \
+    return TinyGsmPort<StreamT>::read(stream); \
+  } \
+  \
   template<typename T> \
-  void streamWrite(T last) { \
-    stream.print(last); \
+  size_t streamWrite(T last) { \
+    return stream.print(last); \
   } \
   \
   template<typename T, typename... Args> \
-  void streamWrite(T head, Args... tail) { \
-    stream.print(head); \
-    streamWrite(tail...); \
+  size_t streamWrite(T head, Args... tail) { \
+    size_t n = stream.print(head); \
+    return n + streamWrite(tail...); \
   } \
   \
   template<typename... Args> \
   void sendAT(Args... cmd) { \
-    streamWrite("AT", cmd..., GSM_NL); \
-    stream.flush(); \
+    TinyGsmLineBuffer<TINY_GSM_AT_BUFFER, StreamT> line(stream); \
+    line.add("AT", cmd..., GSM_NL); \
+    size_t sent = line.send(); \
+    TINY_GSM_STATS_COMMAND(sent, cmd...); \
+    TINY_GSM_AT_FLUSH(); \
     TINY_GSM_YIELD(); \
     /* DBG("### AT:", cmd...); */ \
   } \
   \
+  size_t streamCopy(Print& sink, size_t len, const unsigned long timeout_ms = 1000L) { \
+    uint8_t buf[64]; \
+    size_t copied = 0; \
+    unsigned long startMillis = millis(); \
+    while (copied < len && millis() - startMillis < timeout_ms) { \
+      size_t n = TinyGsmReadAvailable(stream, buf, TinyGsmMin(sizeof(buf), len - copied)); \
+      if (n) { \
+        sink.write(buf, n); \
+        copied += n; \
+        startMillis = millis(); \
+      } else { \
+        TINY_GSM_YIELD(); \
+      } \
+    } \
+    return copied; \
+  } \
+  \
   bool streamSkipUntil(const char c, const unsigned long timeout_ms = 1000L) { \
     unsigned long startMillis = millis(); \
     while (millis() - startMillis < timeout_ms) { \
-      while (millis() - startMillis < timeout_ms && !stream.available()) { \
+      while (millis() - startMillis < timeout_ms && !streamAvailable()) { \
         TINY_GSM_YIELD(); \
       } \
-      if (stream.read() == c) { \
+      if (streamRead() == c) { \
         return true; \
       } \
     } \
     return false; \
-  }
+  } \
+  \
+  TINY_GSM_MODEM_STATS() \
+  TINY_GSM_MODEM_MUTEX()
 
 
 #endif
@@ -1,6 +1,16 @@
 #ifndef TinyGsmFifo_h
 #define TinyGsmFifo_h
 
+// Smallest unsigned type that can index N slots
+template <unsigned long N, bool Byte = (N <= 0x100UL), bool Word = (N <= 0x10000UL)>
+struct TinyGsmIndexType { typedef uint32_t type; };
+
+template <unsigned long N>
+struct TinyGsmIndexType<N, true, true> { typedef uint8_t type; };
+
+template <unsigned long N>
+struct TinyGsmIndexType<N, false, true> { typedef uint16_t type; };
+
 template <class T, unsigned N>
 class TinyGsmFifo
 {
@@ -85,6 +95,14 @@ public:
         return s;
     }
 
+    bool peek(T* p)
+    {
+        if (_r == _w) // !readable()
+            return false;
+        *p = _b[_r];
+        return true;
+    }
+
     bool get(T* p)
     {
         int r = _r;
@@ -128,9 +146,11 @@ private:
         return (i + n) % N;
     }
 
-    T    _b[N];
-    int  _w;
-    int  _r;
+    typedef typename TinyGsmIndexType<N>::type Index;
+
+    T      _b[N];
+    Index  _w;
+    Index  _r;
 };
 
 #endif
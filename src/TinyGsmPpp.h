@@ -0,0 +1,1824 @@
+/**
+ * @file       TinyGsmPpp.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmPpp_h
+#define TinyGsmPpp_h
+//#pragma message("TinyGSM:  TinyGsmPpp")
+
+/*
+ * PPP data call with a small built-in IPv4/TCP/UDP stack.
+ *
+ * The modem only dials ATD*99# and then carries raw IP packets, so the
+ * number of sockets, their buffers and the protocols on top of them (any
+ * TLS library working over a Client, plain UDP, ...) are no longer limited
+ * by the modem firmware:
+ *
+ *   TinyGsm modem(SerialAT);
+ *   TinyGsmPpp ppp(SerialAT);
+ *   TinyGsmPpp::GsmClient client(ppp, 0);
+ *
+ *   modem.gprsConnect(apn);          // defines the PDP context
+ *   ppp.begin(user, pass);           // dial, LCP, PAP/CHAP, IPCP
+ *   client.connect("example.com", 80);
+ *
+ * The stack is deliberately simple: no IP fragments, no TCP listening
+ * sockets, go-back-N retransmission with a fixed timeout and in-order
+ * reception only.  Everything runs from maintain(), which every socket
+ * calls while it waits.
+ */
+
+#include <TinyGsmCommon.h>
+
+// Number of TCP client sockets
+#if !defined(TINY_GSM_PPP_SOCKETS)
+  #define TINY_GSM_PPP_SOCKETS 4
+#endif
+
+// Number of UDP sockets
+#if !defined(TINY_GSM_PPP_UDP_SOCKETS)
+  #define TINY_GSM_PPP_UDP_SOCKETS 2
+#endif
+
+// Largest IP packet we receive (negotiated as our MRU) and send
+#if !defined(TINY_GSM_PPP_MTU)
+  #define TINY_GSM_PPP_MTU 576
+#endif
+
+// Receive buffer of each socket, also the advertised TCP window
+#if !defined(TINY_GSM_PPP_RX_BUFFER)
+  #define TINY_GSM_PPP_RX_BUFFER 512
+#endif
+
+// Unacknowledged TCP data kept for retransmission, per socket
+#if !defined(TINY_GSM_PPP_TX_BUFFER)
+  #define TINY_GSM_PPP_TX_BUFFER 512
+#endif
+
+// Largest UDP datagram that can be sent
+#if !defined(TINY_GSM_PPP_UDP_TX_BUFFER)
+  #define TINY_GSM_PPP_UDP_TX_BUFFER 256
+#endif
+
+// TCP retransmission timeout and number of retries before giving up
+#if !defined(TINY_GSM_PPP_TCP_RTO)
+  #define TINY_GSM_PPP_TCP_RTO 3000
+#endif
+#if !defined(TINY_GSM_PPP_TCP_RETRIES)
+  #define TINY_GSM_PPP_TCP_RETRIES 6
+#endif
+
+// PPP protocol numbers
+#define TINY_GSM_PPP_IP         0x0021
+#define TINY_GSM_PPP_IPCP       0x8021
+#define TINY_GSM_PPP_LCP        0xC021
+#define TINY_GSM_PPP_PAP        0xC023
+#define TINY_GSM_PPP_CHAP       0xC223
+
+// Control protocol codes shared by LCP and IPCP
+#define TINY_GSM_PPP_CONF_REQ   1
+#define TINY_GSM_PPP_CONF_ACK   2
+#define TINY_GSM_PPP_CONF_NAK   3
+#define TINY_GSM_PPP_CONF_REJ   4
+#define TINY_GSM_PPP_TERM_REQ   5
+#define TINY_GSM_PPP_TERM_ACK   6
+#define TINY_GSM_PPP_PROT_REJ   8
+#define TINY_GSM_PPP_ECHO_REQ   9
+#define TINY_GSM_PPP_ECHO_REP   10
+
+// TCP header flags
+#define TINY_GSM_TCP_FIN        0x01
+#define TINY_GSM_TCP_SYN        0x02
+#define TINY_GSM_TCP_RST        0x04
+#define TINY_GSM_TCP_PSH        0x08
+#define TINY_GSM_TCP_ACK        0x10
+
+class TinyGsmPpp
+{
+
+public:
+
+  enum PppPhase {
+    PPP_DEAD,
+    PPP_ESTABLISH,
+    PPP_AUTHENTICATE,
+    PPP_NETWORK,
+    PPP_RUNNING,
+    PPP_TERMINATE
+  };
+
+  enum TcpState {
+    TCP_CLOSED,
+    TCP_SYN_SENT,
+    TCP_ESTABLISHED,
+    TCP_FIN_WAIT_1,
+    TCP_FIN_WAIT_2,
+    TCP_CLOSING,
+    TCP_CLOSE_WAIT,
+    TCP_LAST_ACK
+  };
+
+class GsmClient : public Client
+{
+  friend class TinyGsmPpp;
+  typedef TinyGsmFifo<uint8_t, TINY_GSM_PPP_RX_BUFFER> RxFifo;
+
+public:
+  GsmClient() {}
+
+  GsmClient(TinyGsmPpp& ppp, uint8_t mux = 0) {
+    init(&ppp, mux);
+  }
+
+  bool init(TinyGsmPpp* ppp, uint8_t mux = 0) {
+    if (mux >= TINY_GSM_PPP_SOCKETS) {
+      return false;
+    }
+    this->at = ppp;
+    this->mux = mux;
+    state = TCP_CLOSED;
+    tx_len = 0;
+
+    at->sockets[mux] = this;
+
+    return true;
+  }
+
+public:
+  virtual int connect(const char *host, uint16_t port, int timeout_s) {
+    stop();
+    TINY_GSM_YIELD();
+    rx.clear();
+    uint8_t ip[4];
+    if (!at->resolve(host, ip)) {
+      return false;
+    }
+    return at->tcpConnect(mux, ip, port, ((uint32_t)timeout_s)*1000);
+  }
+
+TINY_GSM_CLIENT_CONNECT_OVERLOADS()
+
+  virtual void stop() {
+    TINY_GSM_YIELD();
+    at->tcpClose(mux);
+  }
+
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    TINY_GSM_YIELD();
+    at->maintain();
+    size_t sent = at->modemSend(buf, size, mux);
+    TINY_GSM_STATS_DATA(sent, 0);
+    return sent;
+  }
+
+  virtual size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+
+  virtual size_t write(const char *str) {
+    if (str == NULL) return 0;
+    return write((const uint8_t *)str, strlen(str));
+  }
+
+  virtual int available() {
+    TINY_GSM_YIELD();
+    if (!rx.size()) {
+      at->maintain();
+    }
+    return rx.size();
+  }
+
+  virtual int read(uint8_t *buf, size_t size) {
+    TINY_GSM_YIELD();
+    if (!rx.size()) {
+      at->maintain();
+    }
+    size_t cnt = TinyGsmMin(size, rx.size());
+    rx.get(buf, cnt);
+    at->tcpWindowUpdate(mux);
+    return cnt;
+  }
+
+TINY_GSM_CLIENT_READ_OVERLOAD()
+
+  virtual int peek() {
+    uint8_t c;
+    if (!rx.size()) {
+      at->maintain();
+    }
+    return rx.peek(&c) ? c : -1;
+  }
+
+  // Waits until the peer has acknowledged everything written so far
+  virtual void flush() {
+    uint32_t startMillis = millis();
+    while (tx_len && state != TCP_CLOSED && millis() - startMillis < _timeout) {
+      at->maintain();
+      TINY_GSM_YIELD();
+    }
+  }
+
+  virtual uint8_t connected() {
+    if (available()) {
+      return true;
+    }
+    return state == TCP_ESTABLISHED;
+  }
+  virtual operator bool() { return connected(); }
+
+  /*
+   * Extended API
+   */
+
+  IPAddress remoteIP() {
+    return IPAddress(remote_ip[0], remote_ip[1], remote_ip[2], remote_ip[3]);
+  }
+
+private:
+  TinyGsmPpp*     at;
+  uint8_t         mux;
+  uint8_t         state;
+  uint8_t         retries;
+  uint8_t         remote_ip[4];
+  uint16_t        remote_port;
+  uint16_t        local_port;
+  uint16_t        snd_wnd;
+  uint16_t        rcv_adv;
+  uint16_t        peer_mss;
+  uint16_t        rto;
+  uint32_t        rto_start;
+  uint32_t        snd_una;
+  uint32_t        snd_nxt;
+  uint32_t        rcv_nxt;
+  uint16_t        tx_len;
+  uint8_t         tx[TINY_GSM_PPP_TX_BUFFER];
+  RxFifo          rx;
+};
+
+
+// Same interface as the Arduino UDP class
+class GsmUdp : public Stream
+{
+  friend class TinyGsmPpp;
+  typedef TinyGsmFifo<uint8_t, TINY_GSM_PPP_RX_BUFFER> RxFifo;
+
+public:
+  GsmUdp() {}
+
+  GsmUdp(TinyGsmPpp& ppp, uint8_t mux = 0) {
+    init(&ppp, mux);
+  }
+
+  bool init(TinyGsmPpp* ppp, uint8_t mux = 0) {
+    if (mux >= TINY_GSM_PPP_UDP_SOCKETS) {
+      return false;
+    }
+    this->at = ppp;
+    this->mux = mux;
+    local_port = 0;
+    rx_left = 0;
+    tx_len = 0;
+
+    at->udps[mux] = this;
+
+    return true;
+  }
+
+public:
+  uint8_t begin(uint16_t port) {
+    local_port = port ? port : at->nextPort();
+    rx.clear();
+    rx_left = 0;
+    return 1;
+  }
+
+  void stop() {
+    local_port = 0;
+    rx.clear();
+    rx_left = 0;
+  }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    for (uint8_t i = 0; i < 4; i++) {
+      tx_ip[i] = ip[i];
+    }
+    tx_port = port;
+    tx_len = 0;
+    if (!local_port) {
+      begin(0);
+    }
+    return 1;
+  }
+
+  int beginPacket(const char *host, uint16_t port) {
+    uint8_t ip[4];
+    if (!at->resolve(host, ip)) {
+      return 0;
+    }
+    return beginPacket(IPAddress(ip[0], ip[1], ip[2], ip[3]), port);
+  }
+
+  int endPacket() {
+    bool ok = at->sendUdp(tx_ip, tx_port, local_port, tx, tx_len);
+    tx_len = 0;
+    return ok;
+  }
+
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    size_t cnt = TinyGsmMin(size, (size_t)(TINY_GSM_PPP_UDP_TX_BUFFER - tx_len));
+    memcpy(tx + tx_len, buf, cnt);
+    tx_len += cnt;
+    return cnt;
+  }
+
+  virtual size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+
+  // Starts reading the next datagram, returns its size
+  int parsePacket() {
+    TINY_GSM_YIELD();
+    while (rx_left) {
+      uint8_t c;
+      rx.get(&c);
+      rx_left--;
+    }
+    at->maintain();
+    if (rx.size() < 8) {
+      return 0;
+    }
+    uint8_t hdr[8];
+    rx.get(hdr, 8);
+    memcpy(rx_ip, hdr, 4);
+    rx_port = TinyGsmPpp::get16(hdr + 4);
+    rx_left = TinyGsmPpp::get16(hdr + 6);
+    return rx_left;
+  }
+
+  virtual int available() {
+    return rx_left;
+  }
+
+  virtual int read(uint8_t *buf, size_t size) {
+    size_t cnt = TinyGsmMin(size, (size_t)rx_left);
+    rx.get(buf, cnt);
+    rx_left -= cnt;
+    return cnt;
+  }
+
+  virtual int read() {
+    uint8_t c;
+    if (read(&c, 1) == 1) {
+      return c;
+    }
+    return -1;
+  }
+
+  virtual int peek() {
+    uint8_t c;
+    if (!rx_left || !rx.peek(&c)) {
+      return -1;
+    }
+    return c;
+  }
+
+  virtual void flush() {}
+
+  IPAddress remoteIP() {
+    return IPAddress(rx_ip[0], rx_ip[1], rx_ip[2], rx_ip[3]);
+  }
+
+  uint16_t remotePort() {
+    return rx_port;
+  }
+
+private:
+  TinyGsmPpp*     at;
+  uint8_t         mux;
+  uint16_t        local_port;
+  uint8_t         rx_ip[4];
+  uint16_t        rx_port;
+  uint16_t        rx_left;
+  uint8_t         tx_ip[4];
+  uint16_t        tx_port;
+  uint16_t        tx_len;
+  uint8_t         tx[TINY_GSM_PPP_UDP_TX_BUFFER];
+  RxFifo          rx;
+};
+
+
+public:
+
+  TinyGsmPpp(Stream& stream)
+    : stream(stream)
+  {
+    memset(sockets, 0, sizeof(sockets));
+    memset(udps, 0, sizeof(udps));
+    port_next = 49152 + (micros() & 0x3FFF);
+    ip_id = 0;
+    reset();
+  }
+
+  /*
+   * Basic functions
+   */
+
+  // Dials the data call and negotiates the link, returns true once IP is up
+  bool begin(const char* user = NULL, const char* pwd = NULL,
+             bool dial = true, uint32_t timeout_ms = 60000L)
+  {
+    reset();
+    this->user = user ? user : "";
+    this->pwd = pwd ? pwd : "";
+    if (dial) {
+      stream.print(GF("ATD*99#\r\n"));
+      stream.flush();
+      if (!waitForConnect(timeout_ms)) {
+        DBG(GF("### PPP: dial failed"));
+        return false;
+      }
+    }
+    phase = PPP_ESTABLISH;
+    sendLcpRequest();
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms &&
+           phase != PPP_RUNNING && phase != PPP_DEAD)
+    {
+      maintain();
+      TINY_GSM_YIELD();
+    }
+    if (phase != PPP_RUNNING) {
+      DBG(GF("### PPP: negotiation failed in phase"), phase);
+      return false;
+    }
+    DBG(GF("### PPP: local IP"), localIP());
+    return true;
+  }
+
+  // Terminates the link and hangs up the call
+  bool end(uint32_t timeout_ms = 3000L) {
+    if (phase != PPP_DEAD) {
+      phase = PPP_TERMINATE;
+      cp_id++;
+      sendCp(TINY_GSM_PPP_LCP, TINY_GSM_PPP_TERM_REQ, cp_id, NULL, 0);
+      uint32_t startMillis = millis();
+      while (millis() - startMillis < timeout_ms && phase != PPP_DEAD) {
+        maintain();
+        TINY_GSM_YIELD();
+      }
+    }
+    linkDown();
+    if (!no_carrier) {
+      delay(TINY_GSM_DATA_MODE_GUARD_TIME);
+      stream.print(GF("+++"));
+      stream.flush();
+      delay(TINY_GSM_DATA_MODE_GUARD_TIME);
+      stream.print(GF("ATH\r\n"));
+      stream.flush();
+    }
+    return true;
+  }
+
+  bool isConnected() {
+    return phase == PPP_RUNNING;
+  }
+
+  IPAddress localIP() {
+    return IPAddress(local_ip[0], local_ip[1], local_ip[2], local_ip[3]);
+  }
+
+  IPAddress dnsIP(uint8_t index = 0) {
+    const uint8_t* ip = index ? dns2 : dns1;
+    return IPAddress(ip[0], ip[1], ip[2], ip[3]);
+  }
+
+  // Reads and handles everything that has arrived, and retransmits
+  void maintain() {
+    while (stream.available()) {
+      int a = stream.read();
+      if (a < 0) break;
+      parse(a);
+    }
+    checkTimers();
+  }
+
+  // Accepts a dotted quad or looks the name up with the negotiated DNS servers
+  bool resolve(const char* host, uint8_t ip[4], uint32_t timeout_ms = 5000L) {
+    if (parseIp(host, ip)) {
+      return true;
+    }
+    for (uint8_t server = 0; server < 2; server++) {
+      const uint8_t* dns = server ? dns2 : dns1;
+      if (!get32(dns) || !isConnected()) {
+        continue;
+      }
+      dns_id++;
+      dns_done = false;
+      if (!sendDnsQuery(dns, host)) {
+        return false;
+      }
+      uint32_t startMillis = millis();
+      while (millis() - startMillis < timeout_ms && !dns_done) {
+        maintain();
+        TINY_GSM_YIELD();
+      }
+      if (dns_done && get32(dns_ip)) {
+        memcpy(ip, dns_ip, 4);
+        return true;
+      }
+    }
+    DBG(GF("### PPP: cannot resolve"), host);
+    return false;
+  }
+
+  // Counts the socket data, there are no AT commands on the link
+  TINY_GSM_MODEM_STATS()
+
+  /*
+   * Utilities
+   */
+
+  static uint16_t get16(const uint8_t* p) {
+    return ((uint16_t)p[0] << 8) | p[1];
+  }
+
+  static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)get16(p) << 16) | get16(p + 2);
+  }
+
+  static void put16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+  }
+
+  static void put32(uint8_t* p, uint32_t v) {
+    put16(p, v >> 16);
+    put16(p + 2, v);
+  }
+
+protected:
+
+  void reset() {
+    phase = PPP_DEAD;
+    rx_len = 0;
+    rx_fcs = 0xFFFF;
+    rx_escaped = false;
+    rx_discard = false;
+    carrier_match = 0;
+    no_carrier = false;
+    cp_id = 0;
+    lcp_opts = LCP_OPT_MRU | LCP_OPT_ACCM | LCP_OPT_MAGIC;
+    ipcp_opts = IPCP_OPT_ADDR | IPCP_OPT_DNS1 | IPCP_OPT_DNS2;
+    ack_sent = false;
+    ack_rcvd = false;
+    auth_proto = 0;
+    peer_mru = 1500;
+    magic = micros() ^ ((uint32_t)millis() << 16);
+    memset(local_ip, 0, 4);
+    memset(peer_ip, 0, 4);
+    memset(dns1, 0, 4);
+    memset(dns2, 0, 4);
+    memset(dns_ip, 0, 4);
+    dns_done = false;
+    dns_id = 0;
+    dns_port = 0;
+    restart_start = millis();
+    restart_count = 0;
+  }
+
+  void linkDown() {
+    phase = PPP_DEAD;
+    for (uint8_t i = 0; i < TINY_GSM_PPP_SOCKETS; i++) {
+      if (sockets[i]) {
+        sockets[i]->state = TCP_CLOSED;
+      }
+    }
+  }
+
+  bool waitForConnect(uint32_t timeout_ms) {
+    String data;
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms) {
+      while (stream.available() > 0) {
+        int a = stream.read();
+        if (a <= 0) continue;
+        data += (char)a;
+        if (data.endsWith(GF("CONNECT"))) {
+          // Skip the rest of the line, e.g. "CONNECT 150000000"
+          while (millis() - startMillis < timeout_ms) {
+            if (stream.available() && stream.read() == '\n') {
+              return true;
+            }
+            TINY_GSM_YIELD();
+          }
+          return false;
+        } else if (data.endsWith(GF("NO CARRIER")) || data.endsWith(GF("ERROR")) ||
+                   data.endsWith(GF("BUSY")) || data.endsWith(GF("NO ANSWER")))
+        {
+          DBG(GF("### PPP:"), data);
+          return false;
+        }
+      }
+      TINY_GSM_YIELD();
+    }
+    return false;
+  }
+
+  uint16_t nextPort() {
+    if (++port_next < 49152) {
+      port_next = 49152;
+    }
+    return port_next;
+  }
+
+  static bool parseIp(const char* host, uint8_t ip[4]) {
+    uint16_t part = 0;
+    uint8_t dots = 0;
+    bool digit = false;
+    for (const char* c = host; ; c++) {
+      if (*c >= '0' && *c <= '9') {
+        part = part * 10 + (*c - '0');
+        if (part > 255) return false;
+        digit = true;
+      } else if ((*c == '.' || *c == '\0') && digit && dots < 4) {
+        ip[dots++] = part;
+        part = 0;
+        digit = false;
+        if (*c == '\0') break;
+      } else {
+        return false;
+      }
+    }
+    return dots == 4;
+  }
+
+  /*
+   * HDLC-like framing (RFC 1662)
+   */
+
+  static uint16_t fcsUpdate(uint16_t fcs, uint8_t c) {
+    fcs ^= c;
+    for (uint8_t i = 0; i < 8; i++) {
+      fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : (fcs >> 1);
+    }
+    return fcs;
+  }
+
+  void frameStart(uint16_t proto) {
+    tx_fcs = 0xFFFF;
+    tx_chunk_len = 0;
+    tx_chunk[tx_chunk_len++] = 0x7E;
+    uint8_t hdr[4] = { 0xFF, 0x03, (uint8_t)(proto >> 8), (uint8_t)proto };
+    frameWrite(hdr, sizeof(hdr));
+  }
+
+  void frameByte(uint8_t c) {
+    if (tx_chunk_len > sizeof(tx_chunk) - 2) {
+      stream.write(tx_chunk, tx_chunk_len);
+      tx_chunk_len = 0;
+    }
+    // Control characters are always escaped, whatever ACCM the peer asked for
+    if (c < 0x20 || c == 0x7E || c == 0x7D) {
+      tx_chunk[tx_chunk_len++] = 0x7D;
+      c ^= 0x20;
+    }
+    tx_chunk[tx_chunk_len++] = c;
+  }
+
+  void frameWrite(const uint8_t* data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+      tx_fcs = fcsUpdate(tx_fcs, data[i]);
+      frameByte(data[i]);
+    }
+  }
+
+  void frameEnd() {
+    uint16_t fcs = ~tx_fcs;
+    frameByte(fcs);
+    frameByte(fcs >> 8);
+    if (tx_chunk_len == sizeof(tx_chunk)) {
+      stream.write(tx_chunk, tx_chunk_len);
+      tx_chunk_len = 0;
+    }
+    tx_chunk[tx_chunk_len++] = 0x7E;
+    stream.write(tx_chunk, tx_chunk_len);
+    stream.flush();
+  }
+
+  void parse(uint8_t c) {
+    // The modem reports a dropped call in plain text between frames
+    static const char noCarrier[] = "NO CARRIER";
+    carrier_match = (c == noCarrier[carrier_match]) ? carrier_match + 1 : (c == noCarrier[0]);
+    if (!noCarrier[carrier_match] && rx_len < sizeof(noCarrier) + 2) {
+      DBG(GF("### PPP: NO CARRIER"));
+      no_carrier = true;
+      carrier_match = 0;
+      linkDown();
+      return;
+    }
+
+    if (c == 0x7E) {
+      if (rx_len >= 4 && !rx_discard) {
+        if (rx_fcs == 0xF0B8) {
+          handleFrame(rx_frame, rx_len - 2);
+        } else {
+          DBG(GF("### PPP: bad FCS"));
+        }
+      }
+      rx_len = 0;
+      rx_fcs = 0xFFFF;
+      rx_escaped = false;
+      rx_discard = false;
+      return;
+    }
+    if (rx_discard) {
+      return;
+    }
+    if (c == 0x7D) {
+      rx_escaped = true;
+      return;
+    }
+    if (rx_escaped) {
+      c ^= 0x20;
+      rx_escaped = false;
+    }
+    if (rx_len >= sizeof(rx_frame)) {
+      DBG(GF("### PPP: frame too long"));
+      rx_discard = true;
+      return;
+    }
+    rx_frame[rx_len++] = c;
+    rx_fcs = fcsUpdate(rx_fcs, c);
+  }
+
+  void handleFrame(uint8_t* p, uint16_t len) {
+    // Address and control may be compressed (ACFC), the protocol too (PFC)
+    if (len >= 2 && p[0] == 0xFF && p[1] == 0x03) {
+      p += 2;
+      len -= 2;
+    }
+    if (len < 1) return;
+    uint16_t proto = p[0];
+    if (proto & 1) {
+      p += 1;
+      len -= 1;
+    } else {
+      if (len < 2) return;
+      proto = get16(p);
+      p += 2;
+      len -= 2;
+    }
+
+    switch (proto) {
+      case TINY_GSM_PPP_LCP:  handleLcp(p, len); break;
+      case TINY_GSM_PPP_PAP:  handlePap(p, len); break;
+      case TINY_GSM_PPP_CHAP: handleChap(p, len); break;
+      case TINY_GSM_PPP_IPCP: handleIpcp(p, len); break;
+      case TINY_GSM_PPP_IP:
+        if (phase == PPP_RUNNING) {
+          handleIp(p, len);
+        }
+        break;
+      default:
+        if (phase > PPP_ESTABLISH && phase != PPP_TERMINATE) {
+          // Protocol-Reject carries the protocol and as much of the packet as fits
+          uint8_t data[2];
+          put16(data, proto);
+          cp_id++;
+          sendCp(TINY_GSM_PPP_LCP, TINY_GSM_PPP_PROT_REJ, cp_id, data, 2,
+                 p, TinyGsmMin(len, (uint16_t)(peer_mru - 8)));
+        }
+        break;
+    }
+  }
+
+  /*
+   * LCP, PAP, CHAP and IPCP (RFC 1661, 1334, 1994, 1332, 1877)
+   */
+
+  enum {
+    LCP_OPT_MRU   = 0x01,
+    LCP_OPT_ACCM  = 0x02,
+    LCP_OPT_MAGIC = 0x04,
+    IPCP_OPT_ADDR = 0x01,
+    IPCP_OPT_DNS1 = 0x02,
+    IPCP_OPT_DNS2 = 0x04
+  };
+
+  void sendCp(uint16_t proto, uint8_t code, uint8_t id,
+              const uint8_t* data, uint16_t len,
+              const uint8_t* data2 = NULL, uint16_t len2 = 0)
+  {
+    uint8_t hdr[4] = { code, id, 0, 0 };
+    put16(hdr + 2, 4 + len + len2);
+    frameStart(proto);
+    frameWrite(hdr, 4);
+    frameWrite(data, len);
+    frameWrite(data2, len2);
+    frameEnd();
+  }
+
+  void sendLcpRequest() {
+    uint8_t opts[16];
+    uint8_t len = 0;
+    if (lcp_opts & LCP_OPT_MRU) {
+      opts[len++] = 1;
+      opts[len++] = 4;
+      put16(opts + len, TINY_GSM_PPP_MTU);
+      len += 2;
+    }
+    if (lcp_opts & LCP_OPT_ACCM) {
+      opts[len++] = 2;
+      opts[len++] = 6;
+      put32(opts + len, 0);
+      len += 4;
+    }
+    if (lcp_opts & LCP_OPT_MAGIC) {
+      opts[len++] = 5;
+      opts[len++] = 6;
+      put32(opts + len, magic);
+      len += 4;
+    }
+    req_id = ++cp_id;
+    sendCp(TINY_GSM_PPP_LCP, TINY_GSM_PPP_CONF_REQ, req_id, opts, len);
+    restart_start = millis();
+  }
+
+  void sendIpcpRequest() {
+    uint8_t opts[18];
+    uint8_t len = 0;
+    if (ipcp_opts & IPCP_OPT_ADDR) {
+      opts[len++] = 3;
+      opts[len++] = 6;
+      memcpy(opts + len, local_ip, 4);
+      len += 4;
+    }
+    if (ipcp_opts & IPCP_OPT_DNS1) {
+      opts[len++] = 129;
+      opts[len++] = 6;
+      memcpy(opts + len, dns1, 4);
+      len += 4;
+    }
+    if (ipcp_opts & IPCP_OPT_DNS2) {
+      opts[len++] = 131;
+      opts[len++] = 6;
+      memcpy(opts + len, dns2, 4);
+      len += 4;
+    }
+    req_id = ++cp_id;
+    sendCp(TINY_GSM_PPP_IPCP, TINY_GSM_PPP_CONF_REQ, req_id, opts, len);
+    restart_start = millis();
+  }
+
+  void sendPap() {
+    uint8_t ulen = strlen(user);
+    uint8_t plen = strlen(pwd);
+    req_id = ++cp_id;
+    uint8_t hdr[5] = { 1, req_id, 0, 0, ulen };
+    put16(hdr + 2, 6 + ulen + plen);
+    frameStart(TINY_GSM_PPP_PAP);
+    frameWrite(hdr, 5);
+    frameWrite((const uint8_t*)user, ulen);
+    frameWrite(&plen, 1);
+    frameWrite((const uint8_t*)pwd, plen);
+    frameEnd();
+    restart_start = millis();
+  }
+
+  // Sorts the peer's Configure-Request options into acceptable ones (Ack),
+  // ones with a value we want changed (Nak) and unknown ones (Rej)
+  void handleConfReq(uint16_t proto, uint8_t id, uint8_t* opts, uint16_t len) {
+    uint8_t nak[16];
+    uint8_t nak_len = 0;
+    uint8_t rej[32];
+    uint8_t rej_len = 0;
+    uint16_t auth = 0;
+
+    for (uint16_t i = 0; i + 2 <= len; ) {
+      uint8_t type = opts[i];
+      uint8_t olen = opts[i+1];
+      if (olen < 2 || i + olen > len) break;
+      uint8_t* val = opts + i + 2;
+      bool ok = false;
+      if (proto == TINY_GSM_PPP_LCP) {
+        switch (type) {
+          case 1:  // MRU
+            if (olen == 4) {
+              ok = true;
+              peer_mru = get16(val);
+            }
+            break;
+          case 2:  // ACCM, we escape all control characters anyway
+          case 5:  // Magic number
+          case 7:  // Protocol field compression
+          case 8:  // Address and control field compression
+            ok = true;
+            break;
+          case 3:  // Authentication protocol
+            if (olen == 4 && get16(val) == TINY_GSM_PPP_PAP) {
+              ok = true;
+              auth = TINY_GSM_PPP_PAP;
+            } else if (olen == 5 && get16(val) == TINY_GSM_PPP_CHAP && val[2] == 5) {
+              ok = true;
+              auth = TINY_GSM_PPP_CHAP;
+            } else if (nak_len + 4u <= sizeof(nak)) {
+              // Suggest PAP instead
+              nak[nak_len++] = 3;
+              nak[nak_len++] = 4;
+              put16(nak + nak_len, TINY_GSM_PPP_PAP);
+              nak_len += 2;
+              ok = true;
+            }
+            break;
+        }
+      } else if (type == 3 && olen == 6) {  // IPCP IP-Address of the peer
+        ok = true;
+        memcpy(peer_ip, val, 4);
+      }
+      if (!ok && rej_len + olen <= (int)sizeof(rej)) {
+        memcpy(rej + rej_len, opts + i, olen);
+        rej_len += olen;
+      }
+      i += olen;
+    }
+
+    if (rej_len) {
+      sendCp(proto, TINY_GSM_PPP_CONF_REJ, id, rej, rej_len);
+    } else if (nak_len) {
+      sendCp(proto, TINY_GSM_PPP_CONF_NAK, id, nak, nak_len);
+    } else {
+      sendCp(proto, TINY_GSM_PPP_CONF_ACK, id, opts, len);
+      ack_sent = true;
+      if (proto == TINY_GSM_PPP_LCP) {
+        auth_proto = auth;
+      }
+    }
+  }
+
+  // Applies the peer's Nak or Rej of our own Configure-Request
+  void handleConfNakRej(uint16_t proto, uint8_t code, uint8_t* opts, uint16_t len) {
+    for (uint16_t i = 0; i + 2 <= len; ) {
+      uint8_t type = opts[i];
+      uint8_t olen = opts[i+1];
+      if (olen < 2 || i + olen > len) break;
+      uint8_t* val = opts + i + 2;
+      if (proto == TINY_GSM_PPP_LCP) {
+        // Whatever the peer dislikes, we simply stop asking for it
+        if (type == 1) lcp_opts &= ~LCP_OPT_MRU;
+        if (type == 2) lcp_opts &= ~LCP_OPT_ACCM;
+        if (type == 5) {
+          if (code == TINY_GSM_PPP_CONF_NAK) {
+            magic = magic * 1103515245UL + 12345;
+          } else {
+            lcp_opts &= ~LCP_OPT_MAGIC;
+          }
+        }
+      } else {
+        uint8_t  opt = 0;
+        uint8_t* dst = NULL;
+        if (type == 3)   { opt = IPCP_OPT_ADDR; dst = local_ip; }
+        if (type == 129) { opt = IPCP_OPT_DNS1; dst = dns1; }
+        if (type == 131) { opt = IPCP_OPT_DNS2; dst = dns2; }
+        if (code == TINY_GSM_PPP_CONF_REJ) {
+          ipcp_opts &= ~opt;
+        } else if (dst && olen == 6) {
+          memcpy(dst, val, 4);
+        }
+      }
+      i += olen;
+    }
+  }
+
+  void handleLcp(uint8_t* p, uint16_t len) {
+    if (len < 4 || get16(p + 2) > len || get16(p + 2) < 4) return;
+    uint8_t code = p[0];
+    uint8_t id = p[1];
+    len = get16(p + 2) - 4;
+    p += 4;
+
+    switch (code) {
+      case TINY_GSM_PPP_CONF_REQ:
+        if (phase > PPP_ESTABLISH && phase != PPP_TERMINATE) {
+          // The peer restarted negotiation, so does the whole link
+          DBG(GF("### PPP: LCP renegotiation"));
+          linkDown();
+          phase = PPP_ESTABLISH;
+          ack_rcvd = false;
+          sendLcpRequest();
+        }
+        if (phase == PPP_ESTABLISH) {
+          handleConfReq(TINY_GSM_PPP_LCP, id, p, len);
+        }
+        break;
+      case TINY_GSM_PPP_CONF_ACK:
+        if (phase == PPP_ESTABLISH && id == req_id) {
+          ack_rcvd = true;
+        }
+        break;
+      case TINY_GSM_PPP_CONF_NAK:
+      case TINY_GSM_PPP_CONF_REJ:
+        if (phase == PPP_ESTABLISH && id == req_id) {
+          handleConfNakRej(TINY_GSM_PPP_LCP, code, p, len);
+          sendLcpRequest();
+        }
+        break;
+      case TINY_GSM_PPP_TERM_REQ:
+        DBG(GF("### PPP: terminated by peer"));
+        sendCp(TINY_GSM_PPP_LCP, TINY_GSM_PPP_TERM_ACK, id, NULL, 0);
+        linkDown();
+        break;
+      case TINY_GSM_PPP_TERM_ACK:
+        if (phase == PPP_TERMINATE) {
+          linkDown();
+        }
+        break;
+      case TINY_GSM_PPP_ECHO_REQ:
+        if (phase > PPP_ESTABLISH && len >= 4) {
+          uint8_t m[4];
+          put32(m, magic);
+          sendCp(TINY_GSM_PPP_LCP, TINY_GSM_PPP_ECHO_REP, id, m, 4, p + 4, len - 4);
+        }
+        break;
+      default:
+        break;
+    }
+
+    if (phase == PPP_ESTABLISH && ack_sent && ack_rcvd) {
+      ack_sent = false;
+      ack_rcvd = false;
+      restart_count = 0;
+      if (auth_proto == TINY_GSM_PPP_PAP) {
+        phase = PPP_AUTHENTICATE;
+        sendPap();
+      } else if (auth_proto == TINY_GSM_PPP_CHAP) {
+        // The peer sends the challenge
+        phase = PPP_AUTHENTICATE;
+        restart_start = millis();
+      } else {
+        phase = PPP_NETWORK;
+        sendIpcpRequest();
+      }
+    }
+  }
+
+  void authDone(bool success) {
+    if (!success) {
+      DBG(GF("### PPP: authentication failed"));
+      cp_id++;
+      sendCp(TINY_GSM_PPP_LCP, TINY_GSM_PPP_TERM_REQ, cp_id, NULL, 0);
+      linkDown();
+      return;
+    }
+    phase = PPP_NETWORK;
+    restart_count = 0;
+    sendIpcpRequest();
+  }
+
+  void handlePap(uint8_t* p, uint16_t len) {
+    if (phase != PPP_AUTHENTICATE || len < 4 || p[1] != req_id) return;
+    if (p[0] == 2) {
+      authDone(true);
+    } else if (p[0] == 3) {
+      authDone(false);
+    }
+  }
+
+  void handleChap(uint8_t* p, uint16_t len) {
+    if (phase != PPP_AUTHENTICATE || len < 4 || get16(p + 2) > len) return;
+    uint8_t code = p[0];
+    uint8_t id = p[1];
+    if (code == 1 && len >= 5 && p[4] + 5 <= len) {
+      // Response = MD5(id, secret, challenge)
+      Md5 md5;
+      md5.update(&id, 1);
+      md5.update((const uint8_t*)pwd, strlen(pwd));
+      md5.update(p + 5, p[4]);
+      uint8_t resp[17];
+      resp[0] = 16;
+      md5.finish(resp + 1);
+      uint8_t ulen = strlen(user);
+      uint8_t hdr[4] = { 2, id, 0, 0 };
+      put16(hdr + 2, 4 + 17 + ulen);
+      frameStart(TINY_GSM_PPP_CHAP);
+      frameWrite(hdr, 4);
+      frameWrite(resp, 17);
+      frameWrite((const uint8_t*)user, ulen);
+      frameEnd();
+      restart_start = millis();
+    } else if (code == 3) {
+      authDone(true);
+    } else if (code == 4) {
+      authDone(false);
+    }
+  }
+
+  void handleIpcp(uint8_t* p, uint16_t len) {
+    if (phase < PPP_NETWORK || phase == PPP_TERMINATE) return;
+    if (len < 4 || get16(p + 2) > len || get16(p + 2) < 4) return;
+    uint8_t code = p[0];
+    uint8_t id = p[1];
+    len = get16(p + 2) - 4;
+    p += 4;
+
+    switch (code) {
+      case TINY_GSM_PPP_CONF_REQ:
+        handleConfReq(TINY_GSM_PPP_IPCP, id, p, len);
+        break;
+      case TINY_GSM_PPP_CONF_ACK:
+        if (id == req_id) {
+          ack_rcvd = true;
+        }
+        break;
+      case TINY_GSM_PPP_CONF_NAK:
+      case TINY_GSM_PPP_CONF_REJ:
+        if (id == req_id) {
+          handleConfNakRej(TINY_GSM_PPP_IPCP, code, p, len);
+          sendIpcpRequest();
+        }
+        break;
+      case TINY_GSM_PPP_TERM_REQ:
+        sendCp(TINY_GSM_PPP_IPCP, TINY_GSM_PPP_TERM_ACK, id, NULL, 0);
+        linkDown();
+        break;
+      default:
+        break;
+    }
+
+    if (phase == PPP_NETWORK && ack_sent && ack_rcvd) {
+      phase = PPP_RUNNING;
+    }
+  }
+
+  // Retransmits our pending request and gives up after 10 tries (RFC 1661)
+  void checkTimers() {
+    uint32_t now = millis();
+    if (phase >= PPP_ESTABLISH && phase <= PPP_NETWORK && now - restart_start > 3000) {
+      if (++restart_count > 10) {
+        DBG(GF("### PPP: peer not responding"));
+        linkDown();
+        return;
+      }
+      if (phase == PPP_ESTABLISH) {
+        sendLcpRequest();
+      } else if (phase == PPP_NETWORK) {
+        sendIpcpRequest();
+      } else if (auth_proto == TINY_GSM_PPP_PAP) {
+        sendPap();
+      } else {
+        restart_start = now;
+      }
+    }
+
+    for (uint8_t i = 0; i < TINY_GSM_PPP_SOCKETS; i++) {
+      GsmClient* s = sockets[i];
+      if (!s || s->state == TCP_CLOSED) continue;
+      bool pending = s->state == TCP_SYN_SENT || s->snd_nxt != s->snd_una ||
+                     (s->tx_len && !s->snd_wnd);
+      if (!pending || now - s->rto_start < s->rto) continue;
+      if (++s->retries > TINY_GSM_PPP_TCP_RETRIES) {
+        DBG(GF("### PPP: TCP timeout on"), i);
+        tcpAbort(s);
+        continue;
+      }
+      s->rto = TinyGsmMin((uint32_t)s->rto * 2, (uint32_t)60000);
+      tcpRetransmit(s);
+    }
+  }
+
+  /*
+   * IPv4, ICMP echo and UDP
+   */
+
+  static uint32_t checksumAdd(uint32_t sum, const uint8_t* p, uint16_t len) {
+    for (uint16_t i = 0; i + 1 < len; i += 2) {
+      sum += get16(p + i);
+    }
+    if (len & 1) {
+      sum += (uint16_t)p[len-1] << 8;
+    }
+    return sum;
+  }
+
+  static uint16_t checksumFinish(uint32_t sum) {
+    while (sum >> 16) {
+      sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return ~sum;
+  }
+
+  // Sum of the TCP/UDP pseudo header
+  uint32_t checksumPseudo(const uint8_t* src, const uint8_t* dst, uint8_t proto, uint16_t len) {
+    uint32_t sum = checksumAdd(0, src, 4);
+    sum = checksumAdd(sum, dst, 4);
+    return sum + proto + len;
+  }
+
+  // Sends one IP packet made of a transport header and its data
+  bool sendIp(uint8_t proto, const uint8_t* dst,
+              const uint8_t* hdr, uint16_t hlen,
+              const uint8_t* data, uint16_t dlen)
+  {
+    uint16_t total = 20 + hlen + dlen;
+    if (phase != PPP_RUNNING || total > TinyGsmMin(peer_mru, (uint16_t)TINY_GSM_PPP_MTU)) {
+      return false;
+    }
+    uint8_t ip[20] = { 0x45, 0, 0, 0, 0, 0, 0x40, 0, 64, proto, 0, 0, };
+    put16(ip + 2, total);
+    put16(ip + 4, ++ip_id);
+    memcpy(ip + 12, local_ip, 4);
+    memcpy(ip + 16, dst, 4);
+    put16(ip + 10, checksumFinish(checksumAdd(0, ip, 20)));
+    frameStart(TINY_GSM_PPP_IP);
+    frameWrite(ip, 20);
+    frameWrite(hdr, hlen);
+    frameWrite(data, dlen);
+    frameEnd();
+    return true;
+  }
+
+  void handleIp(uint8_t* p, uint16_t len) {
+    if (len < 20 || (p[0] >> 4) != 4) return;
+    uint8_t ihl = (p[0] & 0x0F) * 4;
+    uint16_t total = get16(p + 2);
+    if (ihl < 20 || total < ihl || total > len) return;
+    if (checksumFinish(checksumAdd(0, p, ihl)) != 0) return;
+    if (get16(p + 6) & 0x3FFF) return;  // Fragments are not supported
+    if (memcmp(p + 16, local_ip, 4) != 0) return;
+
+    uint8_t* src = p + 12;
+    uint8_t* data = p + ihl;
+    uint16_t dlen = total - ihl;
+    switch (p[9]) {
+      case 1:
+        // Answer pings, they are often used to check the link
+        if (dlen >= 8 && data[0] == 8 && checksumFinish(checksumAdd(0, data, dlen)) == 0) {
+          data[0] = 0;
+          put16(data + 2, 0);
+          put16(data + 2, checksumFinish(checksumAdd(0, data, dlen)));
+          sendIp(1, src, data, dlen, NULL, 0);
+        }
+        break;
+      case 6:
+        handleTcp(src, data, dlen);
+        break;
+      case 17:
+        handleUdp(src, data, dlen);
+        break;
+    }
+  }
+
+  bool sendUdp(const uint8_t* dst, uint16_t dport, uint16_t sport,
+               const uint8_t* data, uint16_t dlen)
+  {
+    uint8_t hdr[8];
+    put16(hdr, sport);
+    put16(hdr + 2, dport);
+    put16(hdr + 4, 8 + dlen);
+    put16(hdr + 6, 0);
+    uint32_t sum = checksumPseudo(local_ip, dst, 17, 8 + dlen);
+    sum = checksumAdd(sum, hdr, 8);
+    sum = checksumAdd(sum, data, dlen);
+    uint16_t csum = checksumFinish(sum);
+    put16(hdr + 6, csum ? csum : 0xFFFF);
+    return sendIp(17, dst, hdr, 8, data, dlen);
+  }
+
+  void handleUdp(const uint8_t* src, uint8_t* p, uint16_t len) {
+    if (len < 8) return;
+    uint16_t sport = get16(p);
+    uint16_t dport = get16(p + 2);
+    uint16_t ulen = get16(p + 4);
+    if (ulen < 8 || ulen > len) return;
+    if (get16(p + 6) &&
+        checksumFinish(checksumAdd(checksumPseudo(src, local_ip, 17, ulen), p, ulen)) != 0)
+    {
+      return;
+    }
+    uint8_t* data = p + 8;
+    uint16_t dlen = ulen - 8;
+
+    if (dport == dns_port && sport == 53) {
+      handleDns(data, dlen);
+      return;
+    }
+    for (uint8_t i = 0; i < TINY_GSM_PPP_UDP_SOCKETS; i++) {
+      GsmUdp* u = udps[i];
+      if (!u || !u->local_port || u->local_port != dport) continue;
+      if ((size_t)u->rx.free() < 8u + dlen) {
+        DBG(GF("### PPP: UDP datagram dropped on"), i);
+        return;
+      }
+      uint8_t hdr[8];
+      memcpy(hdr, src, 4);
+      put16(hdr + 4, sport);
+      put16(hdr + 6, dlen);
+      u->rx.put(hdr, 8);
+      u->rx.put(data, dlen);
+      return;
+    }
+  }
+
+  /*
+   * DNS A record lookup (RFC 1035)
+   */
+
+  bool sendDnsQuery(const uint8_t* dns, const char* host) {
+    uint8_t q[12 + 2 + 100 + 4];
+    size_t hlen = strlen(host);
+    if (hlen > 100) return false;
+    memset(q, 0, 12);
+    put16(q, dns_id);
+    q[2] = 0x01;  // Recursion desired
+    q[5] = 1;     // One question
+    uint16_t len = 12;
+    // Host name as length-prefixed labels
+    const char* label = host;
+    for (size_t i = 0; i <= hlen; i++) {
+      if (host[i] == '.' || host[i] == '\0') {
+        uint8_t l = host + i - label;
+        q[len++] = l;
+        memcpy(q + len, label, l);
+        len += l;
+        label = host + i + 1;
+      }
+    }
+    q[len++] = 0;
+    put16(q + len, 1);      // Type A
+    put16(q + len + 2, 1);  // Class IN
+    len += 4;
+    dns_port = nextPort();
+    return sendUdp(dns, 53, dns_port, q, len);
+  }
+
+  static uint16_t dnsSkipName(const uint8_t* p, uint16_t pos, uint16_t len) {
+    while (pos < len) {
+      if (p[pos] == 0) return pos + 1;
+      if ((p[pos] & 0xC0) == 0xC0) return pos + 2;
+      pos += p[pos] + 1;
+    }
+    return len;
+  }
+
+  void handleDns(const uint8_t* p, uint16_t len) {
+    if (len < 12 || get16(p) != dns_id || !(p[2] & 0x80)) return;
+    dns_done = true;
+    memset(dns_ip, 0, 4);
+    if (p[3] & 0x0F) return;  // Error code
+    uint16_t pos = 12;
+    for (uint16_t i = get16(p + 4); i > 0; i--) {
+      pos = dnsSkipName(p, pos, len) + 4;
+    }
+    for (uint16_t i = get16(p + 6); i > 0 && pos < len; i--) {
+      pos = dnsSkipName(p, pos, len);
+      if (pos + 10 > len) return;
+      uint16_t type = get16(p + pos);
+      uint16_t rdlen = get16(p + pos + 8);
+      pos += 10;
+      if (pos + rdlen > len) return;
+      if (type == 1 && rdlen == 4) {
+        memcpy(dns_ip, p + pos, 4);
+        return;
+      }
+      pos += rdlen;
+    }
+  }
+
+  /*
+   * TCP (RFC 793), client side only
+   */
+
+  static bool seqAfter(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) > 0;
+  }
+
+  uint16_t tcpWindow(GsmClient* s) {
+    return TinyGsmMin((size_t)s->rx.free(), (size_t)0xFFFF);
+  }
+
+  void sendTcp(const uint8_t* dst, uint16_t sport, uint16_t dport,
+               uint32_t seq, uint32_t ack, uint8_t flags, uint16_t wnd,
+               const uint8_t* data, uint16_t dlen)
+  {
+    uint8_t hdr[24];
+    uint8_t hlen = (flags & TINY_GSM_TCP_SYN) ? 24 : 20;
+    put16(hdr, sport);
+    put16(hdr + 2, dport);
+    put32(hdr + 4, seq);
+    put32(hdr + 8, ack);
+    hdr[12] = (hlen / 4) << 4;
+    hdr[13] = flags;
+    put16(hdr + 14, wnd);
+    put16(hdr + 16, 0);
+    put16(hdr + 18, 0);
+    if (hlen == 24) {
+      // Maximum segment size we can receive
+      hdr[20] = 2;
+      hdr[21] = 4;
+      put16(hdr + 22, TINY_GSM_PPP_MTU - 40);
+    }
+    uint32_t sum = checksumPseudo(local_ip, dst, 6, hlen + dlen);
+    sum = checksumAdd(sum, hdr, hlen);
+    sum = checksumAdd(sum, data, dlen);
+    put16(hdr + 16, checksumFinish(sum));
+    sendIp(6, dst, hdr, hlen, data, dlen);
+  }
+
+  void tcpSend(GsmClient* s, uint8_t flags, uint32_t seq, const uint8_t* data, uint16_t dlen) {
+    s->rcv_adv = tcpWindow(s);
+    sendTcp(s->remote_ip, s->local_port, s->remote_port, seq,
+            s->rcv_nxt, flags, s->rcv_adv, data, dlen);
+  }
+
+  // Sends as much new data as the peer's window allows
+  void tcpOutput(GsmClient* s) {
+    if (s->state != TCP_ESTABLISHED && s->state != TCP_CLOSE_WAIT) return;
+    uint16_t mss = TinyGsmMin(s->peer_mss, (uint16_t)(TINY_GSM_PPP_MTU - 40));
+    for (;;) {
+      uint16_t inflight = s->snd_nxt - s->snd_una;
+      if (inflight >= s->tx_len || inflight >= s->snd_wnd) break;
+      uint16_t n = TinyGsmMin((uint16_t)(s->tx_len - inflight),
+                              TinyGsmMin(mss, (uint16_t)(s->snd_wnd - inflight)));
+      if (!inflight) {
+        s->rto_start = millis();
+      }
+      tcpSend(s, TINY_GSM_TCP_ACK | TINY_GSM_TCP_PSH, s->snd_nxt, s->tx + inflight, n);
+      s->snd_nxt += n;
+    }
+  }
+
+  // Go-back-N: everything unacknowledged is sent again
+  void tcpRetransmit(GsmClient* s) {
+    s->rto_start = millis();
+    switch (s->state) {
+      case TCP_SYN_SENT:
+        sendTcp(s->remote_ip, s->local_port, s->remote_port, s->snd_una, 0,
+                TINY_GSM_TCP_SYN, tcpWindow(s), NULL, 0);
+        break;
+      case TCP_FIN_WAIT_1:
+      case TCP_CLOSING:
+      case TCP_LAST_ACK:
+        tcpSend(s, TINY_GSM_TCP_FIN | TINY_GSM_TCP_ACK, s->snd_una, NULL, 0);
+        break;
+      default:
+        s->snd_nxt = s->snd_una;
+        if (!s->snd_wnd && s->tx_len) {
+          // Zero window probe
+          tcpSend(s, TINY_GSM_TCP_ACK, s->snd_nxt, s->tx, 1);
+          s->snd_nxt++;
+        } else {
+          tcpOutput(s);
+        }
+        break;
+    }
+  }
+
+  void tcpAbort(GsmClient* s) {
+    tcpSend(s, TINY_GSM_TCP_RST | TINY_GSM_TCP_ACK, s->snd_nxt, NULL, 0);
+    s->state = TCP_CLOSED;
+    s->tx_len = 0;
+  }
+
+  bool tcpConnect(uint8_t mux, const uint8_t* ip, uint16_t port, uint32_t timeout_ms) {
+    GsmClient* s = sockets[mux];
+    if (!isConnected()) {
+      return false;
+    }
+    memcpy(s->remote_ip, ip, 4);
+    s->remote_port = port;
+    s->local_port = nextPort();
+    s->snd_una = micros() ^ ((uint32_t)s->local_port << 16);
+    s->snd_nxt = s->snd_una + 1;
+    s->rcv_nxt = 0;
+    s->snd_wnd = 0;
+    s->peer_mss = 536;
+    s->tx_len = 0;
+    s->retries = 0;
+    s->rto = TINY_GSM_PPP_TCP_RTO;
+    s->state = TCP_SYN_SENT;
+    tcpRetransmit(s);
+
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms && s->state == TCP_SYN_SENT) {
+      maintain();
+      TINY_GSM_YIELD();
+    }
+    if (s->state != TCP_ESTABLISHED) {
+      if (s->state != TCP_CLOSED) {
+        tcpAbort(s);
+      }
+      return false;
+    }
+    return true;
+  }
+
+  void tcpClose(uint8_t mux) {
+    GsmClient* s = sockets[mux];
+    if (s->state == TCP_CLOSED) {
+      return;
+    }
+    if (s->state == TCP_SYN_SENT) {
+      s->state = TCP_CLOSED;
+      return;
+    }
+    // Let the written data go out first
+    s->flush();
+    if (s->tx_len) {
+      tcpAbort(s);
+      return;
+    }
+    if (s->state == TCP_ESTABLISHED || s->state == TCP_CLOSE_WAIT) {
+      s->state = (s->state == TCP_ESTABLISHED) ? TCP_FIN_WAIT_1 : TCP_LAST_ACK;
+      tcpSend(s, TINY_GSM_TCP_FIN | TINY_GSM_TCP_ACK, s->snd_nxt, NULL, 0);
+      s->snd_nxt++;
+      s->rto_start = millis();
+      s->retries = 0;
+    }
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < 2000L && s->state != TCP_CLOSED &&
+           s->state != TCP_FIN_WAIT_2)
+    {
+      maintain();
+      TINY_GSM_YIELD();
+    }
+    if (s->state != TCP_CLOSED && s->state != TCP_FIN_WAIT_2) {
+      tcpAbort(s);
+    }
+    s->state = TCP_CLOSED;
+  }
+
+  int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    GsmClient* s = sockets[mux];
+    const uint8_t* buf = (const uint8_t*)buff;
+    size_t cnt = 0;
+    uint32_t startMillis = millis();
+    while (cnt < len && (s->state == TCP_ESTABLISHED || s->state == TCP_CLOSE_WAIT)) {
+      uint16_t n = TinyGsmMin(len - cnt, (size_t)(TINY_GSM_PPP_TX_BUFFER - s->tx_len));
+      if (n) {
+        memcpy(s->tx + s->tx_len, buf + cnt, n);
+        s->tx_len += n;
+        cnt += n;
+        tcpOutput(s);
+        startMillis = millis();
+      } else if (millis() - startMillis > s->_timeout) {
+        break;
+      } else {
+        // Wait for acknowledgements to free the buffer
+        maintain();
+        TINY_GSM_YIELD();
+      }
+    }
+    return cnt;
+  }
+
+  // Tells the peer about space freed by the reader
+  void tcpWindowUpdate(uint8_t mux) {
+    GsmClient* s = sockets[mux];
+    if (s->state != TCP_ESTABLISHED) return;
+    uint16_t wnd = tcpWindow(s);
+    if (wnd >= s->rcv_adv + TINY_GSM_PPP_RX_BUFFER / 2 || (s->rcv_adv == 0 && wnd)) {
+      tcpSend(s, TINY_GSM_TCP_ACK, s->snd_nxt, NULL, 0);
+    }
+  }
+
+  void tcpAck(GsmClient* s, uint32_t ack, uint16_t wnd) {
+    s->snd_wnd = wnd;
+    if (!seqAfter(ack, s->snd_una) || seqAfter(ack, s->snd_nxt)) {
+      return;
+    }
+    uint32_t acked = ack - s->snd_una;
+    uint16_t data = TinyGsmMin(acked, (uint32_t)s->tx_len);
+    memmove(s->tx, s->tx + data, s->tx_len - data);
+    s->tx_len -= data;
+    s->snd_una = ack;
+    s->retries = 0;
+    s->rto = TINY_GSM_PPP_TCP_RTO;
+    s->rto_start = millis();
+    if (ack == s->snd_nxt) {
+      // Our FIN, if any, is acknowledged too
+      if (s->state == TCP_FIN_WAIT_1) s->state = TCP_FIN_WAIT_2;
+      else if (s->state == TCP_CLOSING || s->state == TCP_LAST_ACK) s->state = TCP_CLOSED;
+    }
+    tcpOutput(s);
+  }
+
+  void handleTcp(const uint8_t* src, uint8_t* p, uint16_t len) {
+    if (len < 20) return;
+    if (checksumFinish(checksumAdd(checksumPseudo(src, local_ip, 6, len), p, len)) != 0) {
+      return;
+    }
+    uint16_t sport = get16(p);
+    uint16_t dport = get16(p + 2);
+    uint32_t seq = get32(p + 4);
+    uint32_t ack = get32(p + 8);
+    uint8_t off = (p[12] >> 4) * 4;
+    uint8_t flags = p[13];
+    uint16_t wnd = get16(p + 14);
+    if (off < 20 || off > len) return;
+    uint8_t* data = p + off;
+    uint16_t dlen = len - off;
+
+    GsmClient* s = NULL;
+    for (uint8_t i = 0; i < TINY_GSM_PPP_SOCKETS; i++) {
+      GsmClient* c = sockets[i];
+      if (c && c->state != TCP_CLOSED && c->local_port == dport &&
+          c->remote_port == sport && memcmp(c->remote_ip, src, 4) == 0)
+      {
+        s = c;
+        break;
+      }
+    }
+    if (!s) {
+      if (!(flags & TINY_GSM_TCP_RST)) {
+        uint32_t seg_len = dlen + ((flags & TINY_GSM_TCP_SYN) ? 1 : 0) +
+                           ((flags & TINY_GSM_TCP_FIN) ? 1 : 0);
+        if (flags & TINY_GSM_TCP_ACK) {
+          sendTcp(src, dport, sport, ack, 0, TINY_GSM_TCP_RST, 0, NULL, 0);
+        } else {
+          sendTcp(src, dport, sport, 0, seq + seg_len,
+                  TINY_GSM_TCP_RST | TINY_GSM_TCP_ACK, 0, NULL, 0);
+        }
+      }
+      return;
+    }
+
+    if (flags & TINY_GSM_TCP_RST) {
+      DBG(GF("### PPP: connection reset on"), s->mux);
+      s->state = TCP_CLOSED;
+      s->tx_len = 0;
+      return;
+    }
+
+    if (s->state == TCP_SYN_SENT) {
+      if ((flags & (TINY_GSM_TCP_SYN | TINY_GSM_TCP_ACK)) ==
+          (TINY_GSM_TCP_SYN | TINY_GSM_TCP_ACK) && ack == s->snd_nxt)
+      {
+        s->rcv_nxt = seq + 1;
+        s->snd_una = ack;
+        s->snd_wnd = wnd;
+        for (uint8_t i = 20; i + 1 < off; ) {
+          if (p[i] == 0) break;
+          if (p[i] == 1) { i++; continue; }
+          if (p[i] == 2 && p[i+1] == 4 && i + 4 <= off) {
+            s->peer_mss = get16(p + i + 2);
+          }
+          if (p[i+1] < 2) break;
+          i += p[i+1];
+        }
+        s->state = TCP_ESTABLISHED;
+        s->retries = 0;
+        tcpSend(s, TINY_GSM_TCP_ACK, s->snd_nxt, NULL, 0);
+      }
+      return;
+    }
+
+    if (flags & TINY_GSM_TCP_ACK) {
+      tcpAck(s, ack, wnd);
+    }
+
+    if (dlen || (flags & TINY_GSM_TCP_FIN)) {
+      // Only in-order data is kept, anything else is acknowledged and dropped
+      if (seq == s->rcv_nxt) {
+        uint16_t n = TinyGsmMin((size_t)dlen, (size_t)s->rx.free());
+        s->rx.put(data, n);
+        s->rcv_nxt += n;
+        if (n == dlen && (flags & TINY_GSM_TCP_FIN)) {
+          s->rcv_nxt++;
+          switch (s->state) {
+            case TCP_ESTABLISHED: s->state = TCP_CLOSE_WAIT; break;
+            case TCP_FIN_WAIT_1:  s->state = TCP_CLOSING; break;
+            case TCP_FIN_WAIT_2:  s->state = TCP_CLOSED; break;
+            default: break;
+          }
+        }
+      }
+      tcpSend(s, TINY_GSM_TCP_ACK, s->snd_nxt, NULL, 0);
+    }
+  }
+
+  /*
+   * MD5 for CHAP (RFC 1321)
+   */
+
+  class Md5 {
+  public:
+    Md5() : len(0) {
+      h[0] = 0x67452301; h[1] = 0xefcdab89; h[2] = 0x98badcfe; h[3] = 0x10325476;
+    }
+
+    void update(const uint8_t* data, size_t n) {
+      while (n--) {
+        buf[len++ & 63] = *data++;
+        if (!(len & 63)) block();
+      }
+    }
+
+    void finish(uint8_t out[16]) {
+      uint64_t bits = (uint64_t)len * 8;
+      uint8_t pad = 0x80;
+      update(&pad, 1);
+      pad = 0;
+      while ((len & 63) != 56) update(&pad, 1);
+      for (uint8_t i = 0; i < 8; i++) {
+        pad = bits >> (8 * i);
+        update(&pad, 1);
+      }
+      for (uint8_t i = 0; i < 16; i++) {
+        out[i] = h[i / 4] >> (8 * (i % 4));
+      }
+    }
+
+  private:
+    void block() {
+      static const uint8_t r[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+      static const uint32_t k[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+      };
+      uint32_t m[16];
+      for (uint8_t i = 0; i < 16; i++) {
+        m[i] = buf[i*4] | ((uint32_t)buf[i*4+1] << 8) |
+               ((uint32_t)buf[i*4+2] << 16) | ((uint32_t)buf[i*4+3] << 24);
+      }
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+      for (uint8_t i = 0; i < 64; i++) {
+        uint32_t f;
+        uint8_t g;
+        if (i < 16)      { f = (b & c) | (~b & d); g = i; }
+        else if (i < 32) { f = (d & b) | (~d & c); g = (5*i + 1) & 15; }
+        else if (i < 48) { f = b ^ c ^ d;          g = (3*i + 5) & 15; }
+        else             { f = c ^ (b | ~d);       g = (7*i) & 15; }
+        f += a + k[i] + m[g];
+        a = d;
+        d = c;
+        c = b;
+        uint8_t s = r[(i / 16) * 4 + (i % 4)];
+        b += (f << s) | (f >> (32 - s));
+      }
+      h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    }
+
+    uint32_t h[4];
+    uint8_t  buf[64];
+    uint32_t len;
+  };
+
+public:
+  Stream&       stream;
+
+protected:
+  GsmClient*    sockets[TINY_GSM_PPP_SOCKETS];
+  GsmUdp*       udps[TINY_GSM_PPP_UDP_SOCKETS];
+
+  uint8_t       phase;
+  const char*   user;
+  const char*   pwd;
+
+  // Framing
+  uint8_t       rx_frame[TINY_GSM_PPP_MTU + 8];
+  uint16_t      rx_len;
+  uint16_t      rx_fcs;
+  bool          rx_escaped;
+  bool          rx_discard;
+  uint8_t       carrier_match;
+  bool          no_carrier;
+  uint8_t       tx_chunk[32];
+  uint8_t       tx_chunk_len;
+  uint16_t      tx_fcs;
+
+  // Negotiation
+  uint8_t       cp_id;
+  uint8_t       req_id;
+  uint8_t       lcp_opts;
+  uint8_t       ipcp_opts;
+  bool          ack_sent;
+  bool          ack_rcvd;
+  uint16_t      auth_proto;
+  uint16_t      peer_mru;
+  uint32_t      magic;
+  uint32_t      restart_start;
+  uint8_t       restart_count;
+
+  // IP
+  uint8_t       local_ip[4];
+  uint8_t       peer_ip[4];
+  uint8_t       dns1[4];
+  uint8_t       dns2[4];
+  uint16_t      ip_id;
+  uint16_t      port_next;
+  uint16_t      dns_id;
+  uint16_t      dns_port;
+  uint8_t       dns_ip[4];
+  bool          dns_done;
+};
+
+#endif
@@ -0,0 +1,178 @@
+/**
+ * @file       TinyGsmRtos.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Sharing one modem between tasks, compiled in with TINY_GSM_RTOS on
+ * FreeRTOS (ESP32 and others) or on a host with std::thread.
+ *
+ * The modem owns a recursive mutex that every client call, maintain() and
+ * a TinyGsmLock take, so an AT exchange is never interleaved with another
+ * one.  Socket data lands in each client's own fifo, so a task only ever
+ * reads its own socket.  A TinyGsmReader keeps the UART drained and URCs
+ * dispatched from its own task, whether or not any client is being read:
+ *
+ *   TinyGsm modem(SerialAT);
+ *   TinyGsmReader<TinyGsm> reader(modem);
+ *   ...
+ *   reader.begin();                     // after modem.init()
+ *   {
+ *     TinyGsmLock lock(modem.mutex);    // direct modem calls from a task
+ *     csq = modem.getSignalQuality();
+ *   }
+ */
+
+#ifndef TinyGsmRtos_h
+#define TinyGsmRtos_h
+
+#if defined(TINY_GSM_HOST)
+  #include <mutex>
+  #include <thread>
+  #include <atomic>
+#elif defined(ESP32) || defined(ESP_PLATFORM)
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/semphr.h>
+  #include <freertos/task.h>
+#elif defined(INC_FREERTOS_H)
+  #include <semphr.h>
+  #include <task.h>
+#else
+  #error "TINY_GSM_RTOS needs FreeRTOS or a host build"
+#endif
+
+// Stack and priority of the reader task on FreeRTOS
+#ifndef TINY_GSM_READER_STACK
+  #define TINY_GSM_READER_STACK 4096
+#endif
+
+#ifndef TINY_GSM_READER_PRIORITY
+  #define TINY_GSM_READER_PRIORITY 2
+#endif
+
+#if defined(TINY_GSM_HOST)
+
+class TinyGsmMutex
+{
+public:
+  void lock()   { m.lock(); }
+  void unlock() { m.unlock(); }
+
+private:
+  std::recursive_mutex m;
+};
+
+#else
+
+class TinyGsmMutex
+{
+public:
+  TinyGsmMutex() : m(xSemaphoreCreateRecursiveMutex()) {}
+  ~TinyGsmMutex() { vSemaphoreDelete(m); }
+
+  void lock()   { xSemaphoreTakeRecursive(m, portMAX_DELAY); }
+  void unlock() { xSemaphoreGiveRecursive(m); }
+
+private:
+  SemaphoreHandle_t m;
+};
+
+#endif
+
+// Holds a modem's mutex for the rest of the scope
+class TinyGsmLock
+{
+public:
+  explicit TinyGsmLock(TinyGsmMutex& m) : m(m) {
+    m.lock();
+  }
+  ~TinyGsmLock() {
+    m.unlock();
+  }
+
+private:
+  TinyGsmLock(const TinyGsmLock&);
+  TinyGsmLock& operator=(const TinyGsmLock&);
+
+  TinyGsmMutex& m;
+};
+
+// Runs modem.maintain() every period_ms from a task of its own
+template <class Modem>
+class TinyGsmReader
+{
+public:
+  explicit TinyGsmReader(Modem& modem)
+    : modem(modem), period_ms(10), running(false)
+  {}
+
+  ~TinyGsmReader() {
+    end();
+  }
+
+  bool begin(uint32_t period_ms = 10) {
+    if (running) {
+      return true;
+    }
+    this->period_ms = period_ms;
+    running = true;
+#if defined(TINY_GSM_HOST)
+    thread = std::thread(run, this);
+    return true;
+#else
+    done = xSemaphoreCreateBinary();
+    if (xTaskCreate(run, "TinyGsmReader", TINY_GSM_READER_STACK, this,
+                    TINY_GSM_READER_PRIORITY, NULL) != pdPASS) {
+      vSemaphoreDelete(done);
+      running = false;
+      return false;
+    }
+    return true;
+#endif
+  }
+
+  // Stops the task once its current pass is over
+  void end() {
+    if (!running) {
+      return;
+    }
+    running = false;
+#if defined(TINY_GSM_HOST)
+    thread.join();
+#else
+    xSemaphoreTake(done, portMAX_DELAY);
+    vSemaphoreDelete(done);
+#endif
+  }
+
+  bool isRunning() { return running; }
+
+private:
+  static void run(void* arg) {
+    TinyGsmReader* self = static_cast<TinyGsmReader*>(arg);
+    while (self->running) {
+      {
+        TinyGsmLock lock(self->modem.mutex);
+        self->modem.maintain();
+      }
+      delay(self->period_ms);
+    }
+#if !defined(TINY_GSM_HOST)
+    xSemaphoreGive(self->done);
+    vTaskDelete(NULL);
+#endif
+  }
+
+  Modem&            modem;
+  uint32_t          period_ms;
+#if defined(TINY_GSM_HOST)
+  std::atomic<bool> running;
+  std::thread       thread;
+#else
+  volatile bool     running;
+  SemaphoreHandle_t done;
+#endif
+};
+
+#endif
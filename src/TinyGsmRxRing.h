@@ -0,0 +1,195 @@
+/**
+ * @file       TinyGsmRxRing.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Large receive buffer in front of the modem's serial port.  The core's own
+ * buffer (64 bytes on AVR) fills in a few ms at 115200 baud, so a long
+ * +CIPRXGET or +IPD payload is lost whenever the sketch is busy elsewhere.
+ * Here the bytes are moved into a ring of N bytes by whatever sees them
+ * first - the UART interrupt, a DMA callback or a timer - and the driver
+ * parses them from the ring whenever it next runs:
+ *
+ *   TinyGsmRxRing<4096, HardwareSerial> ring(SerialAT);
+ *   TinyGsmT<TinyGsmRxRing<4096, HardwareSerial> > modem(ring);
+ *
+ *   void timerIsr()            { ring.pump(); }        // or, per byte,
+ *   void uartRxIsr(uint8_t c)  { ring.put(c); }        // or, per block,
+ *   void dmaDone(uint8_t* b, size_t n) { ring.put(b, n); }
+ *
+ * Until setAutoPump(false) is called the ring also pumps the port itself
+ * each time the driver asks what is available, so it is never worse than
+ * the bare port.  Turn that off once an interrupt feeds the ring: there
+ * must be only one writer.  pump() leaves what doesn't fit in the port;
+ * bytes handed to a full ring with put() are counted in overruns().
+ */
+
+#ifndef TinyGsmRxRing_h
+#define TinyGsmRxRing_h
+
+#include <TinyGsmCommon.h>
+
+#if defined(__AVR__)
+  #include <util/atomic.h>
+#endif
+
+template <size_t N, class Port = Stream>
+class TinyGsmRxRing final : public Stream
+{
+  // available() returns an int, which is 16 bits on AVR
+  static_assert(N >= 2 && N <= 16384 && (N & (N - 1)) == 0,
+                "TinyGsmRxRing size must be a power of two up to 16384");
+
+public:
+  explicit TinyGsmRxRing(Port& port)
+    : port(port), head(0), tail(0), lost(0), auto_pump(true)
+  {}
+
+  /*
+   * Producer side, safe in an interrupt
+   */
+
+  bool put(uint8_t c) {
+    uint16_t h = head;
+    if ((uint16_t)(h - tail) >= N) {
+      lost++;
+      return false;
+    }
+    buf[h & (N - 1)] = c;
+    barrier();
+    head = h + 1;
+    return true;
+  }
+
+  size_t put(const uint8_t* data, size_t len) {
+    uint16_t h = head;
+    size_t room = N - (uint16_t)(h - tail);
+    if (len > room) {
+      lost += len - room;
+      len = room;
+    }
+    for (size_t i = 0; i < len; i++) {
+      buf[(h + i) & (N - 1)] = data[i];
+    }
+    barrier();
+    head = h + len;
+    return len;
+  }
+
+  // Moves what the port has received into the ring, as far as it fits
+  size_t pump() {
+    size_t n = 0;
+    while ((uint16_t)(head - tail) < N && port.available() > 0) {
+      int c = port.read();
+      if (c < 0) break;
+      put((uint8_t)c);
+      n++;
+    }
+    return n;
+  }
+
+  void setAutoPump(bool enable) { auto_pump = enable; }
+
+  // Bytes dropped because the ring was full
+  uint32_t overruns() {
+#if defined(__AVR__)
+    uint32_t n;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { n = lost; }
+    return n;
+#else
+    return lost;
+#endif
+  }
+
+  /*
+   * Consumer side, for the driver
+   */
+
+  size_t readAvailable(uint8_t* out, size_t len) {
+    if (auto_pump) pump();
+    uint16_t t = tail;
+    size_t n = TinyGsmMin(len, (size_t)(uint16_t)(loadHead() - t));
+    for (size_t i = 0; i < n; i++) {
+      out[i] = buf[(t + i) & (N - 1)];
+    }
+    storeTail(t + n);
+    return n;
+  }
+
+  int available() {
+    if (auto_pump) pump();
+    return (uint16_t)(loadHead() - tail);
+  }
+
+  int read() {
+    if (!available()) {
+      return -1;
+    }
+    uint16_t t = tail;
+    uint8_t c = buf[t & (N - 1)];
+    storeTail(t + 1);
+    return c;
+  }
+
+  int peek() {
+    if (!available()) {
+      return -1;
+    }
+    return buf[tail & (N - 1)];
+  }
+
+  size_t write(uint8_t c) { return port.write(c); }
+  size_t write(const uint8_t* data, size_t len) { return port.write(data, len); }
+  using Print::write;
+
+  void flush() { port.flush(); }
+
+private:
+  // Orders the buffer access against the index update that publishes it
+  static void barrier() {
+#if defined(__AVR__)
+    __asm__ __volatile__("" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+  }
+
+  // 16-bit loads and stores aren't atomic on AVR
+  void storeTail(uint16_t t) {
+    barrier();
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { tail = t; }
+#else
+    tail = t;
+#endif
+  }
+
+  uint16_t loadHead() {
+#if defined(__AVR__)
+    uint16_t h;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { h = head; }
+    return h;
+#else
+    uint16_t h = head;
+    barrier();
+    return h;
+#endif
+  }
+
+  Port&             port;
+  volatile uint16_t head;
+  volatile uint16_t tail;
+  volatile uint32_t lost;
+  bool              auto_pump;
+  uint8_t           buf[N];
+};
+
+// Block reads out of the ring for streamCopy() and the bulk read paths
+template <size_t N, class Port>
+size_t TinyGsmReadAvailable(TinyGsmRxRing<N, Port>& ring, uint8_t* buf, size_t len) {
+  return ring.readAvailable(buf, len);
+}
+
+#endif
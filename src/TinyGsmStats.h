@@ -0,0 +1,355 @@
+/**
+ * @file       TinyGsmStats.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Per-command counters and latency histograms, compiled in with
+ * TINY_GSM_STATS.  A transaction runs from one sendAT() to the next; it is
+ * filed under the command's prefix ("+CIPSEND", "+CSQ", "" for a bare AT)
+ * and takes the time until its last waitResponse(), the bytes of the
+ * command line and response, and any socket data sent or read in between.
+ *
+ * TINY_GSM_SOCKET_STATS adds a TinyGsmSocketMeter to each client: bytes and
+ * modem commands per direction, time spent in read() and write(), the last
+ * connect's latency and a smoothed rate per direction.
+ */
+
+#ifndef TinyGsmStats_h
+#define TinyGsmStats_h
+
+#include <string.h>
+
+// Distinct command prefixes kept; once full, the last entry ("*") takes the rest
+#ifndef TINY_GSM_STATS_COMMANDS
+  #define TINY_GSM_STATS_COMMANDS 16
+#endif
+
+// Characters of a prefix kept
+#ifndef TINY_GSM_STATS_TAG_LEN
+  #define TINY_GSM_STATS_TAG_LEN 11
+#endif
+
+// Latency buckets: [0] under 1 ms, [n] from 2^(n-1) up to 2^n ms, the last open
+#ifndef TINY_GSM_STATS_BUCKETS
+  #define TINY_GSM_STATS_BUCKETS 16
+#endif
+
+struct TinyGsmCommandStats {
+  char     tag[TINY_GSM_STATS_TAG_LEN + 1];
+  uint32_t count;
+  uint32_t timeouts;        // transactions where a wait matched nothing
+  uint32_t total_ms;
+  uint32_t max_ms;
+  uint32_t bytes_out;
+  uint32_t bytes_in;
+  uint32_t matched[6];      // last wait: [0] nothing, [1..5] r1..r5
+  uint16_t histogram[TINY_GSM_STATS_BUCKETS];
+};
+
+struct TinyGsmStats {
+  TinyGsmCommandStats commands[TINY_GSM_STATS_COMMANDS];
+  uint8_t             used;
+};
+
+class TinyGsmStatsRecorder
+{
+public:
+  TinyGsmStatsRecorder()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    memset(&stats, 0, sizeof(stats));
+    open = false;
+  }
+
+  // A command line of 'sent' bytes went out
+  void begin(size_t sent)
+  {
+    commit();
+    start(sent);
+    tag[0] = '\0';
+  }
+
+  template<typename T, typename... Args>
+  void begin(size_t sent, T head, Args...)
+  {
+    commit();
+    start(sent);
+    setTag(head);
+  }
+
+  // A wait returned; only waits that expect something count (r1 != NULL)
+  void response(uint8_t index, bool expected, size_t bytes)
+  {
+    if (!open || !expected) {
+      return;
+    }
+    end_ms = millis();
+    last_index = index;
+    if (!index) {
+      timed_out = true;
+    }
+    bytes_in += bytes;
+  }
+
+  // Socket data moved as part of the open transaction
+  void data(size_t out, size_t in)
+  {
+    if (open) {
+      bytes_out += out;
+      bytes_in += in;
+    }
+  }
+
+  const TinyGsmStats& get()
+  {
+    commit();
+    return stats;
+  }
+
+  static uint8_t bucket(uint32_t ms)
+  {
+    uint8_t b = 0;
+    while (ms && b < TINY_GSM_STATS_BUCKETS - 1) {
+      ms >>= 1;
+      b++;
+    }
+    return b;
+  }
+
+protected:
+  void start(size_t sent)
+  {
+    open = true;
+    start_ms = end_ms = millis();
+    bytes_out = sent;
+    bytes_in = 0;
+    last_index = 0;
+    timed_out = false;
+  }
+
+  void setTag(const char* cmd)
+  {
+    size_t i = 0;
+    while (i < TINY_GSM_STATS_TAG_LEN && cmd[i] && !isTagEnd(cmd[i])) {
+      tag[i] = cmd[i];
+      i++;
+    }
+    tag[i] = '\0';
+  }
+
+#if defined(__AVR__)
+  void setTag(const __FlashStringHelper* cmd)
+  {
+    PGM_P p = reinterpret_cast<PGM_P>(cmd);
+    size_t i = 0;
+    char c;
+    while (i < TINY_GSM_STATS_TAG_LEN && (c = pgm_read_byte(p + i)) && !isTagEnd(c)) {
+      tag[i++] = c;
+    }
+    tag[i] = '\0';
+  }
+#endif
+
+  // A first argument that is not a string, e.g. a number
+  template<typename T>
+  void setTag(T)
+  {
+    tag[0] = '\0';
+  }
+
+  static bool isTagEnd(char c)
+  {
+    return c == '=' || c == '?' || c == ',' || c == ' ';
+  }
+
+  TinyGsmCommandStats* find()
+  {
+    for (uint8_t i = 0; i < stats.used; i++) {
+      if (!strcmp(stats.commands[i].tag, tag)) {
+        return &stats.commands[i];
+      }
+    }
+    if (stats.used < TINY_GSM_STATS_COMMANDS - 1) {
+      TinyGsmCommandStats* s = &stats.commands[stats.used++];
+      strcpy(s->tag, tag);
+      return s;
+    }
+    TinyGsmCommandStats* s = &stats.commands[TINY_GSM_STATS_COMMANDS - 1];
+    if (stats.used < TINY_GSM_STATS_COMMANDS) {
+      stats.used++;
+      strcpy(s->tag, "*");
+    }
+    return s;
+  }
+
+  void commit()
+  {
+    if (!open) {
+      return;
+    }
+    open = false;
+    TinyGsmCommandStats* s = find();
+    uint32_t ms = end_ms - start_ms;
+    s->count++;
+    s->timeouts += timed_out;
+    s->total_ms += ms;
+    if (ms > s->max_ms) {
+      s->max_ms = ms;
+    }
+    s->bytes_out += bytes_out;
+    s->bytes_in += bytes_in;
+    s->matched[last_index <= 5 ? last_index : 0]++;
+    uint16_t& h = s->histogram[bucket(ms)];
+    if (h != 0xFFFF) {
+      h++;
+    }
+  }
+
+private:
+  TinyGsmStats stats;
+  bool         open;
+  bool         timed_out;
+  uint8_t      last_index;
+  char         tag[TINY_GSM_STATS_TAG_LEN + 1];
+  uint32_t     start_ms;
+  uint32_t     end_ms;
+  uint32_t     bytes_out;
+  uint32_t     bytes_in;
+};
+
+// Window over which a socket's byte rate is measured before it is folded
+// into the running average
+#ifndef TINY_GSM_RATE_WINDOW
+  #define TINY_GSM_RATE_WINDOW 1000L
+#endif
+
+struct TinyGsmSocketStats {
+  uint32_t bytes_rx;        // returned by read()
+  uint32_t bytes_tx;        // taken by the modem
+  uint32_t modem_reads;     // read commands sent; 0 where the modem pushes data
+  uint32_t modem_sends;
+  uint32_t read_ms;         // time spent in read()
+  uint32_t write_ms;        // time spent in write()
+  uint32_t connect_ms;      // last connect, from the command to the outcome
+  uint32_t rx_rate;         // bytes/s, exponentially weighted (1/4 per window)
+  uint32_t tx_rate;
+};
+
+class TinyGsmSocketMeter
+{
+public:
+  TinyGsmSocketMeter()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    memset(&stats, 0, sizeof(stats));
+    rx_avg = tx_avg = 0;
+    restartWindows();
+    connect_start = 0;
+    connect_open = false;
+  }
+
+  void read(size_t n, uint32_t start)
+  {
+    uint32_t now = millis();
+    stats.read_ms += now - start;
+    stats.bytes_rx += n;
+    advance(rx_avg, rx_window, rx_start, now);
+    rx_window += n;
+  }
+
+  void write(size_t n, uint32_t start)
+  {
+    uint32_t now = millis();
+    stats.write_ms += now - start;
+    stats.bytes_tx += n;
+    advance(tx_avg, tx_window, tx_start, now);
+    tx_window += n;
+  }
+
+  void modemRead()  { stats.modem_reads++; }
+  void modemSend()  { stats.modem_sends++; }
+
+  // Rates are measured per connection
+  void connectBegin()
+  {
+    connect_start = millis();
+    connect_open = true;
+    rx_avg = tx_avg = 0;
+    restartWindows();
+  }
+
+  // Only the first outcome after connectBegin() counts
+  void connectEnd()
+  {
+    if (connect_open) {
+      stats.connect_ms = millis() - connect_start;
+      connect_open = false;
+    }
+  }
+
+  // Until a full window has passed, the rates come from the data so far.
+  // Windows that ended with no read() or write() count as 0 bytes/s.
+  const TinyGsmSocketStats& get()
+  {
+    uint32_t now = millis();
+    advance(rx_avg, rx_window, rx_start, now);
+    advance(tx_avg, tx_window, tx_start, now);
+    stats.rx_rate = rx_avg ? rx_avg : partial(rx_window, now - rx_start);
+    stats.tx_rate = tx_avg ? tx_avg : partial(tx_window, now - tx_start);
+    return stats;
+  }
+
+protected:
+  void restartWindows()
+  {
+    rx_window = tx_window = 0;
+    rx_start = tx_start = millis();
+  }
+
+  static uint32_t partial(uint32_t window, uint32_t dt)
+  {
+    return dt ? window * 1000UL / dt : 0;
+  }
+
+  // Folds the windows that have ended by 'now' into the average: the first
+  // holds the bytes counted so far, any after it were idle
+  static void advance(uint32_t& avg, uint32_t& window, uint32_t& start,
+                      uint32_t now)
+  {
+    uint32_t windows = (now - start) / TINY_GSM_RATE_WINDOW;
+    if (!windows) {
+      return;
+    }
+    uint32_t r = window * 1000UL / TINY_GSM_RATE_WINDOW;
+    avg = avg ? avg - avg / 4 + r / 4 : r;
+    window = 0;
+    start += windows * TINY_GSM_RATE_WINDOW;
+    // Rounded up so that a long idle spell reaches 0
+    while (--windows && avg) {
+      avg -= (avg + 3) / 4;
+    }
+  }
+
+private:
+  TinyGsmSocketStats stats;
+  uint32_t           rx_avg;
+  uint32_t           tx_avg;
+  uint32_t           rx_window;
+  uint32_t           tx_window;
+  uint32_t           rx_start;
+  uint32_t           tx_start;
+  uint32_t           connect_start;
+  bool               connect_open;
+};
+
+#endif
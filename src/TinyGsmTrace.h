@@ -0,0 +1,236 @@
+/**
+ * @file       TinyGsmTrace.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Binary record of the traffic between the library and the modem, kept in
+ * RAM without touching the timing the way DBG output over a UART does.
+ * Put it between the modem's Stream and the driver, like StreamDebugger:
+ *
+ *   TinyGsmTrace<2048> trace(SerialAT);
+ *   TinyGsm modem(trace);
+ *   ...
+ *   trace.exportTo(Serial);  // or a file, a socket, ...
+ *
+ * The oldest records are dropped when the ring is full.  A trace can be
+ * played back into a driver on a host with ModemSim::loadTrace(), and
+ * tools/AT_Spy writes the same format.
+ *
+ * Format: the magic "TGT1", then records of
+ *   1 byte   bit 7 set for modem -> library, bits 0-6 the data length - 1
+ *   varint   ms since the previous record started, 7 bits per byte, LSB first
+ *   data     1 to 128 bytes
+ * Bytes in the same direction less than TINY_GSM_TRACE_GAP ms apart share a
+ * record.
+ */
+
+#ifndef TinyGsmTrace_h
+#define TinyGsmTrace_h
+
+#include <TinyGsmCommon.h>
+
+// Longest pause, in ms, inside one record
+#ifndef TINY_GSM_TRACE_GAP
+  #define TINY_GSM_TRACE_GAP 2
+#endif
+
+#define TINY_GSM_TRACE_MAGIC "TGT1"
+#define TINY_GSM_TRACE_MAX_RECORD 128
+
+// Splits traffic into records and hands each one, complete, to emit()
+class TinyGsmTraceEncoder
+{
+public:
+  TinyGsmTraceEncoder()
+    : rec_len(0), rec_in(false), rec_start(0), last_byte(0), prev_start(0), started(false)
+  {}
+
+  virtual ~TinyGsmTraceEncoder() {}
+
+  void put(bool in, uint8_t c) {
+    uint32_t now = millis();
+    if (rec_len && (in != rec_in || rec_len >= TINY_GSM_TRACE_MAX_RECORD ||
+                    now - last_byte > TINY_GSM_TRACE_GAP)) {
+      finishRecord();
+    }
+    if (!rec_len) {
+      rec_in = in;
+      rec_start = now;
+    }
+    data[rec_len++] = c;
+    last_byte = now;
+  }
+
+  // Emits the open record once the line has been quiet for TINY_GSM_TRACE_GAP,
+  // for writers that would otherwise hold the last record back
+  void tick() {
+    if (rec_len && millis() - last_byte > TINY_GSM_TRACE_GAP) {
+      finishRecord();
+    }
+  }
+
+  // Emits the record being built, e.g. before an export
+  void finishRecord() {
+    if (!rec_len) {
+      return;
+    }
+    uint8_t head[6];
+    size_t n = 0;
+    head[n++] = (rec_in ? 0x80 : 0x00) | (uint8_t)(rec_len - 1);
+    uint32_t delta = started ? rec_start - prev_start : 0;
+    do {
+      uint8_t b = delta & 0x7F;
+      delta >>= 7;
+      head[n++] = delta ? (b | 0x80) : b;
+    } while (delta);
+    emit(head, n, data, rec_len);
+    prev_start = rec_start;
+    started = true;
+    rec_len = 0;
+  }
+
+protected:
+  virtual void emit(const uint8_t* head, size_t head_len,
+                    const uint8_t* body, size_t body_len) = 0;
+
+private:
+  uint8_t  data[TINY_GSM_TRACE_MAX_RECORD];
+  size_t   rec_len;
+  bool     rec_in;
+  uint32_t rec_start;
+  uint32_t last_byte;
+  uint32_t prev_start;
+  bool     started;
+};
+
+// Writes records straight to a Print, e.g. a serial port or an SD file
+class TinyGsmTraceWriter : public TinyGsmTraceEncoder
+{
+public:
+  explicit TinyGsmTraceWriter(Print& out) : out(out) {}
+
+  void begin() {
+    out.print(TINY_GSM_TRACE_MAGIC);
+  }
+
+protected:
+  void emit(const uint8_t* head, size_t head_len, const uint8_t* body, size_t body_len) {
+    out.write(head, head_len);
+    out.write(body, body_len);
+  }
+
+private:
+  Print& out;
+};
+
+// A Stream that passes everything through and keeps the last N bytes of
+// records in a ring
+template <unsigned N>
+class TinyGsmTrace : public Stream, public TinyGsmTraceEncoder
+{
+public:
+  explicit TinyGsmTrace(Stream& io) : io(io) {
+    clear();
+  }
+
+  void clear() {
+    head = tail = used = 0;
+  }
+
+  // Bytes of complete records held
+  size_t size() const { return used; }
+
+  // Writes the magic and every record held, oldest first
+  size_t exportTo(Print& out) {
+    finishRecord();
+    size_t n = out.print(TINY_GSM_TRACE_MAGIC);
+    size_t pos = tail;
+    for (size_t left = used; left; ) {
+      size_t chunk = TinyGsmMin(left, (size_t)(N - pos));
+      n += out.write(ring + pos, chunk);
+      pos = (pos + chunk) % N;
+      left -= chunk;
+    }
+    return n;
+  }
+
+  /*
+   * Stream
+   */
+
+  int available() {
+    return io.available();
+  }
+
+  int read() {
+    int c = io.read();
+    if (c >= 0) {
+      put(true, c);
+    }
+    return c;
+  }
+
+  int peek() {
+    return io.peek();
+  }
+
+  size_t write(uint8_t c) {
+    put(false, c);
+    return io.write(c);
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      put(false, buf[i]);
+    }
+    return io.write(buf, size);
+  }
+  using Print::write;
+
+  void flush() {
+    io.flush();
+  }
+
+protected:
+  void emit(const uint8_t* rec_head, size_t head_len, const uint8_t* body, size_t body_len) {
+    size_t len = head_len + body_len;
+    if (len > N) {
+      return;
+    }
+    while (N - used < len) {
+      dropOldest();
+    }
+    push(rec_head, head_len);
+    push(body, body_len);
+  }
+
+  void push(const uint8_t* p, size_t len) {
+    while (len--) {
+      ring[head] = *p++;
+      head = (head + 1) % N;
+      used++;
+    }
+  }
+
+  void dropOldest() {
+    size_t len = 1 + (ring[tail] & 0x7F) + 1;  // header, data, first varint byte
+    size_t pos = (tail + 1) % N;
+    while (ring[pos] & 0x80) {
+      pos = (pos + 1) % N;
+      len++;
+    }
+    tail = (tail + len) % N;
+    used -= len;
+  }
+
+private:
+  Stream& io;
+  uint8_t ring[N];
+  size_t  head;
+  size_t  tail;
+  size_t  used;
+};
+
+#endif
@@ -25,6 +25,15 @@
 #include <AltSoftSerial.h>
 AltSoftSerial BOARD_TX;
 
+// Write a binary TinyGsmTrace to SPY instead of the plain text; save it to a
+// file and run it on a PC with "make replay"
+// #define SPY_TRACE
+
+#ifdef SPY_TRACE
+  #include <TinyGsmTrace.h>
+  TinyGsmTraceWriter trace(SPY);
+#endif
+
 
 void setup() {
   // Set console baud rate
@@ -33,15 +42,28 @@ void setup() {
   MODEM_TX.begin(BAUD_RATE);
   BOARD_TX.begin(BAUD_RATE);
   delay(1000);
+#ifdef SPY_TRACE
+  trace.begin();
+#endif
 }
 
 void loop()
 {
+#ifdef SPY_TRACE
+  while (MODEM_TX.available()) {
+    trace.put(true, MODEM_TX.read());
+  }
+  while (BOARD_TX.available()) {
+    trace.put(false, BOARD_TX.read());
+  }
+  trace.tick();
+#else
   while (MODEM_TX.available()) {
     SPY.write(MODEM_TX.read());
   }
   while (BOARD_TX.available()) {
     SPY.write(BOARD_TX.read());
   }
+#endif
 }
 
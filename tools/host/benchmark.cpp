@@ -0,0 +1,371 @@
+/**
+ * @file       benchmark.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Download and upload throughput of one driver, as CSV.
+ *
+ * Against the simulator (default) every size is downloaded and uploaded;
+ * with --port the same downloads go through a real modem from --server
+ * (test_<size>.bin, as in examples/FileDownload), uploads are skipped.
+ *
+ *   bench_SIM800 --header --baud 115200 --latency 20 --sizes 1k,10k
+ *   bench_BG96 --port /dev/ttyUSB0 --apn internet
+ *
+ * Columns:
+ *   modem, direction, size, baud, latency_ms  what was run
+ *   bytes, ms, bytes_per_sec                  payload moved and wall time
+ *   at_per_kb                                 AT commands per kB (simulator only)
+ *   cpu_ms                                    process CPU time; with --baud 0
+ *                                             --latency 0 this is the cost of the
+ *                                             driver's parsing (and the simulator)
+ *   ram_bytes                                 sizeof the modem and one client
+ *   peak_rss_kb                               host process high-water mark
+ *   ok                                        length and CRC32 matched
+ */
+
+#include <HostCompat/ModemSim.h>
+#include <HostCompat/SerialPort.h>
+#include <sys/resource.h>
+
+#if defined(TINY_GSM_MODEM_SIM800) || defined(TINY_GSM_MODEM_SIM808) || \
+    defined(TINY_GSM_MODEM_SIM868) || defined(TINY_GSM_MODEM_SIM7000)
+  #define BENCH_FAMILY ModemSim::SIMCOM
+#elif defined(TINY_GSM_MODEM_BG96)
+  #define BENCH_FAMILY ModemSim::QUECTEL
+#elif defined(TINY_GSM_MODEM_UBLOX) || defined(TINY_GSM_MODEM_SARAR4)
+  #define BENCH_FAMILY ModemSim::UBLOX
+#elif defined(TINY_GSM_MODEM_SEQUANS_MONARCH)
+  #define BENCH_FAMILY ModemSim::SEQUANS
+#elif defined(TINY_GSM_MODEM_ESP8266)
+  #define BENCH_FAMILY ModemSim::ESPRESSIF
+#elif defined(TINY_GSM_MODEM_XBEE)
+  #define BENCH_FAMILY ModemSim::XBEE
+#else
+  #error "The simulator has no script for this modem"
+#endif
+
+// The ESP8266 pushes whole TCP segments (up to 1460 bytes) into the fifo
+// as they come, a few of them can land between two reads
+#ifndef TINY_GSM_RX_BUFFER
+  #if defined(TINY_GSM_MODEM_ESP8266)
+    #define TINY_GSM_RX_BUFFER 4096
+  #else
+    #define TINY_GSM_RX_BUFFER 1024
+  #endif
+#endif
+
+// The simulated modem holds its output while the driver de-asserts RTS.  It
+// finishes a segment it has begun, so above the watermark the ESP8266's fifo
+// needs room for the segment just read and the one under way.
+static ModemSim* bench_sim = NULL;
+#define TINY_GSM_RTS(ready) { if (bench_sim) bench_sim->setRts(ready); }
+#if defined(TINY_GSM_MODEM_ESP8266) && !defined(TINY_GSM_RX_HIGH_WATERMARK)
+  #define TINY_GSM_RX_HIGH_WATERMARK (TINY_GSM_RX_BUFFER - 2 * 1460)
+#endif
+
+// Set by the Makefile, e.g. -DBENCH_MODEM=\"SIM800\"
+#ifndef BENCH_MODEM
+  #define BENCH_MODEM "modem"
+#endif
+
+#include <TinyGsmClient.h>
+#include <vector>
+
+struct Options {
+  unsigned long baud;
+  uint32_t      latency;
+  std::string   sizes;
+  std::string   extras;
+  const char*   port;
+  const char*   apn;
+  const char*   server;
+  const char*   path;
+  bool          header;
+  uint32_t      timeout;
+};
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static uint64_t cpuMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static long peakRssKb() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+  return ru.ru_maxrss / 1024;
+#else
+  return ru.ru_maxrss;
+#endif
+}
+
+// "1k" -> 1024, "1m" -> 1048576
+static size_t parseSize(const std::string& name) {
+  size_t n = strtoul(name.c_str(), NULL, 10);
+  char unit = name.empty() ? 0 : tolower(name[name.size() - 1]);
+  if (unit == 'k') n *= 1024;
+  if (unit == 'm') n *= 1024 * 1024;
+  return n;
+}
+
+// extras/test_<name>.bin, or the same number of pseudo-random bytes when the
+// file is not in the tree (there is no test_1m.bin)
+static std::string loadTestFile(const Options& opt, const std::string& name) {
+  std::string data;
+  std::string path = opt.extras + "/test_" + name + ".bin";
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f) {
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      data.append(buf, n);
+    }
+    fclose(f);
+    return data;
+  }
+  size_t len = parseSize(name);
+  uint32_t x = 2463534242UL;
+  data.resize(len);
+  for (size_t i = 0; i < len; i++) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    data[i] = (char)x;
+  }
+  return data;
+}
+
+struct Result {
+  size_t   bytes;
+  uint64_t us;
+  uint64_t cpu_us;
+  uint32_t commands;
+  bool     ok;
+};
+
+static void printRow(const Options& opt, const char* direction, const std::string& size,
+                     const Result& r, bool simulated) {
+  double secs = r.us / 1e6;
+  printf("%s,%s,%s,%lu,%u,%zu,%.1f,%.0f,", BENCH_MODEM, direction, size.c_str(),
+         opt.baud, opt.latency, r.bytes, r.us / 1000.0, secs > 0 ? r.bytes / secs : 0.0);
+  if (simulated && r.bytes) {
+    printf("%.2f", r.commands * 1024.0 / r.bytes);
+  }
+  printf(",%.1f,%zu,%ld,%d\n", r.cpu_us / 1000.0,
+         sizeof(TinyGsm) + sizeof(TinyGsmClient), peakRssKb(), r.ok ? 1 : 0);
+  fflush(stdout);
+}
+
+static bool bringUp(TinyGsm& modem, const Options& opt) {
+  if (!modem.init()) {
+    return false;
+  }
+#if defined(TINY_GSM_MODEM_ESP8266)
+  return modem.networkConnect("TinyGSM", "benchmark");
+#elif defined(TINY_GSM_MODEM_XBEE)
+  return modem.waitForNetwork(60000L);
+#else
+  return modem.waitForNetwork(60000L) && modem.gprsConnect(opt.apn, "", "");
+#endif
+}
+
+// GET the file, skip the response header, read the body in blocks
+static Result download(TinyGsm& modem, const Options& opt, const std::string& expected,
+                       const std::string& resource, ModemSim* sim) {
+  Result r = { 0, 0, 0, 0, false };
+  TinyGsmClient client(modem);
+  uint32_t cmds = sim ? sim->commands() : 0;
+  uint64_t cpu = cpuMicros();
+  uint64_t start = hostMicros64();
+
+  if (client.connect(opt.server, 80)) {
+    // In one write, the simulated ESP8266's server answers the first one
+    client.print(String("GET ") + resource.c_str() + " HTTP/1.0\r\n" +
+                 "Host: " + opt.server + "\r\n\r\n");
+
+    // Header, up to the empty line
+    uint32_t timeout = millis();
+    int matched = 0;
+    while (matched < 4 && millis() - timeout < opt.timeout) {
+      int c = client.read();
+      if (c < 0) {
+        if (!client.connected()) break;
+        continue;
+      }
+      matched = (c == "\r\n\r\n"[matched]) ? matched + 1 : (c == '\r');
+      timeout = millis();
+    }
+
+    uint8_t buf[512];
+    uint32_t crc = 0;
+    timeout = millis();
+    while (r.bytes < expected.size() && millis() - timeout < opt.timeout) {
+      int n = client.read(buf, sizeof(buf));
+      if (n > 0) {
+        crc = crc32(crc, buf, n);
+        r.bytes += n;
+        timeout = millis();
+      } else if (!client.connected() && !client.available()) {
+        break;
+      }
+    }
+    r.ok = (r.bytes == expected.size()) &&
+           (crc == crc32(0, (const uint8_t*)expected.data(), expected.size()));
+  }
+
+  r.us = hostMicros64() - start;
+  r.cpu_us = cpuMicros() - cpu;
+  r.commands = sim ? sim->commands() - cmds : 0;
+  client.stop();
+  return r;
+}
+
+// Write the file to a socket in blocks; done when the modem has taken it all
+static Result upload(TinyGsm& modem, const Options& opt, const std::string& data,
+                     ModemSim& sim) {
+  Result r = { 0, 0, 0, 0, false };
+  TinyGsmClient client(modem);
+  uint32_t cmds = sim.commands();
+  size_t before = sim.uploaded();
+  uint64_t cpu = cpuMicros();
+  uint64_t start = hostMicros64();
+
+  if (client.connect(opt.server, 80)) {
+    const uint8_t* p = (const uint8_t*)data.data();
+    uint32_t timeout = millis();
+    while (r.bytes < data.size() && millis() - timeout < opt.timeout) {
+      size_t n = client.write(p + r.bytes, TinyGsmMin(data.size() - r.bytes, (size_t)1024));
+      if (n) {
+        r.bytes += n;
+        timeout = millis();
+      } else if (!client.connected()) {
+        break;
+      }
+    }
+    client.flush();
+    r.ok = (sim.uploaded() - before == data.size());
+  }
+
+  r.us = hostMicros64() - start;
+  r.cpu_us = cpuMicros() - cpu;
+  r.commands = sim.commands() - cmds;
+  client.stop();
+  return r;
+}
+
+static void usage() {
+  fprintf(stderr,
+    "usage: bench_<MODEM> [--header] [--baud N] [--latency MS] [--sizes 1k,10k,100k,1m]\n"
+    "                     [--extras DIR] [--timeout MS]\n"
+    "                     [--port DEV --apn APN --server HOST --path /TinyGSM/]\n");
+  exit(1);
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  opt.baud = 921600;
+  opt.latency = 10;
+  opt.sizes = "1k,10k,100k,1m";
+  opt.extras = "extras";
+  opt.port = NULL;
+  opt.apn = "";
+  opt.server = "vsh.pp.ua";
+  opt.path = "/TinyGSM/";
+  opt.header = false;
+  opt.timeout = 10000;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (arg == "--header") { opt.header = true; continue; }
+    if (!val) usage();
+    if      (arg == "--baud")    opt.baud = strtoul(val, NULL, 10);
+    else if (arg == "--latency") opt.latency = strtoul(val, NULL, 10);
+    else if (arg == "--sizes")   opt.sizes = val;
+    else if (arg == "--extras")  opt.extras = val;
+    else if (arg == "--timeout") opt.timeout = strtoul(val, NULL, 10);
+    else if (arg == "--port")    opt.port = val;
+    else if (arg == "--apn")     opt.apn = val;
+    else if (arg == "--server")  opt.server = val;
+    else if (arg == "--path")    opt.path = val;
+    else usage();
+    i++;
+  }
+
+  if (opt.header) {
+    printf("modem,direction,size,baud,latency_ms,bytes,ms,bytes_per_sec,"
+           "at_per_kb,cpu_ms,ram_bytes,peak_rss_kb,ok\n");
+  }
+
+  std::vector<std::string> sizes;
+  for (size_t pos = 0; pos <= opt.sizes.size(); ) {
+    size_t end = opt.sizes.find(',', pos);
+    if (end == std::string::npos) end = opt.sizes.size();
+    if (end > pos) sizes.push_back(opt.sizes.substr(pos, end - pos));
+    pos = end + 1;
+  }
+
+  if (opt.port) {
+    SerialPort port;
+    if (!port.begin(opt.port, opt.baud)) {
+      fprintf(stderr, "cannot open %s\n", opt.port);
+      return 1;
+    }
+    TinyGsm modem(port);
+    if (!bringUp(modem, opt)) {
+      fprintf(stderr, "modem did not come up\n");
+      return 1;
+    }
+    for (size_t i = 0; i < sizes.size(); i++) {
+      std::string expected = loadTestFile(opt, sizes[i]);
+      std::string resource = std::string(opt.path) + "test_" + sizes[i] + ".bin";
+      printRow(opt, "download", sizes[i], download(modem, opt, expected, resource, NULL), false);
+    }
+    return 0;
+  }
+
+  ModemSim sim(BENCH_FAMILY, opt.baud);
+  TinyGsm modem(sim);
+  bench_sim = &sim;
+  if (!bringUp(modem, opt)) {
+    fprintf(stderr, "modem did not come up\n");
+    return 1;
+  }
+  sim.setLatency(opt.latency);
+
+  int failed = 0;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    std::string data = loadTestFile(opt, sizes[i]);
+    String head = String("HTTP/1.0 200 OK\r\nContent-Length: ") + (int)data.size() + "\r\n\r\n";
+    std::string response = std::string(head.c_str()) + data;
+    std::string resource = std::string(opt.path) + "test_" + sizes[i] + ".bin";
+
+    sim.setPayload((const uint8_t*)response.data(), response.size());
+    sim.setCloseAfterPayload(true);
+    Result r = download(modem, opt, data, resource, &sim);
+    printRow(opt, "download", sizes[i], r, true);
+    failed += !r.ok;
+    sim.purge();
+
+    sim.setPayload(NULL, 0);
+    sim.setCloseAfterPayload(false);
+    r = upload(modem, opt, data, sim);
+    printRow(opt, "upload", sizes[i], r, true);
+    failed += !r.ok;
+    sim.purge();
+  }
+  return failed ? 2 : 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file       cmux_test.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * TinyGsmCmux against the simulator's 27.010 side: two SIM800 drivers on
+ * their own channels, replies and URCs longer than one frame, an unknown
+ * control command, flow control and the close down.  Exits non-zero on a failure.
+ */
+
+#define TINY_GSM_MODEM_SIM800
+
+#include <HostCompat/ModemSim.h>
+#include <TinyGsmClient.h>
+#include <TinyGsmCmux.h>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%s - %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok) failures++;
+}
+
+// Reads a channel for timeout_ms and returns everything that came
+static std::string drain(Stream& s, uint32_t timeout_ms) {
+  std::string got;
+  uint32_t start = millis();
+  while (millis() - start < timeout_ms) {
+    int c = s.read();
+    if (c >= 0) got += (char)c;
+  }
+  return got;
+}
+
+int main() {
+  ModemSim sim(ModemSim::SIMCOM, 115200);
+  sim.setLatency(5);
+
+  // Longer than N1 = 31, shorter than the modem's default 127
+  const std::string info(100, 'x');
+  sim.on("I", (info + "\nOK").c_str());
+
+  TinyGsmCmux cmux(sim);
+  check(cmux.begin(), "begin");
+  check(sim.muxFrameSize() == TINY_GSM_CMUX_FRAME_SIZE, "modem uses our N1");
+  check(cmux.openChannel(1) && cmux.openChannel(2), "open channels");
+
+  TinyGsm modem(cmux.channel(1));
+  TinyGsm data(cmux.channel(2));
+  check(modem.testAT(1000), "AT on channel 1");
+  check(modem.getModemInfo() == info.c_str(), "long reply arrives whole");
+  check(data.getIMEI() == "861234567890123", "AT on channel 2");
+
+  std::string urc = "+CMTI: \"SM\"," + std::string(60, '7');
+  sim.urc(urc.c_str());
+  check(drain(cmux.channel(1), 200).find(urc) != std::string::npos, "long URC arrives whole");
+
+  // PN command from the modem, which we don't implement
+  const uint8_t pn[] = { TINY_GSM_CMUX_MSG_PN | TINY_GSM_CMUX_CR, (8 << 1) | TINY_GSM_CMUX_EA,
+                         0x01, 0xE0, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 };
+  sim.muxReceived().clear();
+  sim.muxControl(std::string((const char*)pn, sizeof(pn)));
+  drain(cmux.channel(1), 50);
+  bool nsc = false;
+  for (size_t i = 0; i < sim.muxReceived().size(); i++) {
+    const std::string& m = sim.muxReceived()[i];
+    nsc |= m.size() == 3 && (uint8_t)m[0] == TINY_GSM_CMUX_MSG_NSC && (uint8_t)m[2] == pn[0];
+  }
+  check(nsc, "unknown command answered with NSC");
+
+  // A command written while the modem holds us off past the timeout is kept
+  // and goes out once it lets go
+  const uint8_t fcoff[] = { TINY_GSM_CMUX_MSG_FCOFF | TINY_GSM_CMUX_CR, TINY_GSM_CMUX_EA };
+  const uint8_t fcon[]  = { TINY_GSM_CMUX_MSG_FCON | TINY_GSM_CMUX_CR, TINY_GSM_CMUX_EA };
+  sim.muxControl(std::string((const char*)fcoff, sizeof(fcoff)));
+  drain(cmux.channel(1), 50);
+  cmux.channel(2).setTimeout(50);
+  cmux.channel(2).print("AT+GSN\r\n");
+  cmux.channel(2).flush();
+  sim.muxControl(std::string((const char*)fcon, sizeof(fcon)));
+  drain(cmux.channel(1), 50);
+  cmux.channel(2).flush();
+  check(drain(cmux.channel(2), 200).find("861234567890123") != std::string::npos,
+        "write held by flow control is not lost");
+
+  check(sim.muxBadFrames() == 0, "no bad frames");
+  check(cmux.end() && !sim.muxActive(), "close down");
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+/**
+ * @file       main.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Runs a sketch on a POSIX host the way the Arduino core would.
+ */
+
+#include <HostCompat/Arduino.h>
+
+int main() {
+  setup();
+  for (;;) {
+    loop();
+  }
+}
@@ -0,0 +1,531 @@
+/**
+ * @file       ppp_test.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * TinyGsmPpp against a small PPP server behind ATD*99#: LCP with a rejected
+ * option, PAP and CHAP, IPCP with the addresses handed out by Nak, then DNS,
+ * a TCP exchange larger than the receive window, UDP, a ping from the
+ * network and the link termination.  Exits non-zero on a failure.
+ */
+
+#define TINY_GSM_DATA_MODE_GUARD_TIME 20L
+
+#include <HostCompat/ModemSim.h>
+#include <TinyGsmPpp.h>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%s - %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok) failures++;
+}
+
+// Reaches the CHAP hash of the client, to check its answers
+struct PppAccess : public TinyGsmPpp {
+  typedef TinyGsmPpp::Md5 Md5;
+};
+
+static const uint8_t PEER_IP[4]   = { 10, 64, 0, 1 };
+static const uint8_t HOST_IP[4]   = { 10, 64, 0, 2 };
+static const uint8_t DNS2_IP[4]   = { 10, 64, 0, 9 };
+static const uint8_t SERVER_IP[4] = { 93, 184, 216, 34 };
+
+static uint16_t get16(const std::string& s, size_t i) {
+  return ((uint8_t)s[i] << 8) | (uint8_t)s[i+1];
+}
+
+static uint32_t get32(const std::string& s, size_t i) {
+  return ((uint32_t)get16(s, i) << 16) | get16(s, i + 2);
+}
+
+static void put16(std::string& s, uint16_t v) {
+  s += (char)(v >> 8);
+  s += (char)v;
+}
+
+static void put32(std::string& s, uint32_t v) {
+  put16(s, v >> 16);
+  put16(s, v);
+}
+
+static uint32_t sumAdd(uint32_t sum, const std::string& s) {
+  for (size_t i = 0; i < s.size(); i += 2) {
+    sum += ((uint8_t)s[i] << 8) | (i + 1 < s.size() ? (uint8_t)s[i+1] : 0);
+  }
+  return sum;
+}
+
+static uint16_t sumFinish(uint32_t sum) {
+  while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+  return ~sum;
+}
+
+static std::string ip4(const uint8_t* ip) {
+  return std::string((const char*)ip, 4);
+}
+
+static std::string pseudo(const std::string& src, const std::string& dst,
+                          uint8_t proto, uint16_t len)
+{
+  std::string p = src + dst;
+  p += (char)0;
+  p += (char)proto;
+  put16(p, len);
+  return p;
+}
+
+// The network side of the call: frames, control protocols and a few servers
+struct PppPeer {
+  uint16_t    auth;          // PAP or CHAP, asked for in our LCP request
+  std::string user, pwd;
+
+  std::string frame;
+  bool        esc;
+  uint8_t     id;
+  bool        rejected_accm, lcp_acked, lcp_up, auth_ok, ipcp_nakked, ipcp_up;
+  bool        terminated, pong;
+  int         bad;           // frames or packets with a wrong checksum
+  uint8_t     challenge[16];
+  uint8_t     chap_id;
+
+  // TCP server on port 80, sends `body` once a request has arrived
+  std::string body, request;
+  uint16_t    host_port;
+  uint32_t    iss, snd_una, snd_nxt, rcv_nxt;
+  uint16_t    host_wnd, host_mss;
+  bool        fin_sent, host_fin;
+
+  PppPeer(uint16_t auth, const char* user, const char* pwd)
+    : auth(auth), user(user), pwd(pwd), esc(false), id(0),
+      rejected_accm(false), lcp_acked(false), lcp_up(false), auth_ok(false),
+      ipcp_nakked(false), ipcp_up(false), terminated(false), pong(false), bad(0),
+      chap_id(0), host_port(0), iss(5000), snd_una(0), snd_nxt(0), rcv_nxt(0),
+      host_wnd(0), host_mss(0), fin_sent(false), host_fin(false)
+  {
+    for (int i = 0; i < 16; i++) challenge[i] = i * 37 + 11;
+  }
+
+  static uint16_t fcs(const std::string& s) {
+    uint16_t f = 0xFFFF;
+    for (size_t i = 0; i < s.size(); i++) {
+      f ^= (uint8_t)s[i];
+      for (int b = 0; b < 8; b++) f = (f & 1) ? (f >> 1) ^ 0x8408 : f >> 1;
+    }
+    return f;
+  }
+
+  void send(ModemSim& sim, uint16_t proto, const std::string& payload) {
+    std::string raw = "\xFF\x03";
+    put16(raw, proto);
+    raw += payload;
+    uint16_t f = ~fcs(raw);
+    raw += (char)(f & 0xFF);
+    raw += (char)(f >> 8);
+    std::string out = "\x7E";
+    for (size_t i = 0; i < raw.size(); i++) {
+      uint8_t c = raw[i];
+      if (c < 0x20 || c == 0x7E || c == 0x7D) {
+        out += (char)0x7D;
+        c ^= 0x20;
+      }
+      out += (char)c;
+    }
+    out += (char)0x7E;
+    sim.replyRaw(out);
+  }
+
+  void sendCp(ModemSim& sim, uint16_t proto, uint8_t code, uint8_t cid,
+              const std::string& data)
+  {
+    std::string p;
+    p += (char)code;
+    p += (char)cid;
+    put16(p, 4 + data.size());
+    send(sim, proto, p + data);
+  }
+
+  void feed(ModemSim& sim, uint8_t c) {
+    if (c == 0x7E) {
+      if (frame.size() >= 4) {
+        if (fcs(frame) != 0xF0B8) {
+          bad++;
+        } else {
+          std::string f = frame.substr(0, frame.size() - 2);
+          if (f.compare(0, 2, "\xFF\x03") == 0) f.erase(0, 2);
+          if (f.size() >= 2) onFrame(sim, get16(f, 0), f.substr(2));
+        }
+      }
+      frame.clear();
+      esc = false;
+    } else if (c == 0x7D) {
+      esc = true;
+    } else {
+      frame += (char)(esc ? c ^ 0x20 : c);
+      esc = false;
+    }
+  }
+
+  void onFrame(ModemSim& sim, uint16_t proto, const std::string& p) {
+    if (proto == 0x0021) {
+      onIp(sim, p);
+      return;
+    }
+    if (p.size() < 4) return;
+    uint8_t code = p[0];
+    uint8_t cid = p[1];
+    std::string opts = p.substr(4, get16(p, 2) - 4);
+
+    if (proto == 0xC021) {
+      if (code == 1) {
+        // Reject the ACCM once, then take the request as it comes
+        size_t accm = std::string::npos;
+        for (size_t i = 0; i + 2 <= opts.size(); i += (uint8_t)opts[i+1]) {
+          if (opts[i] == 2) accm = i;
+        }
+        if (accm != std::string::npos && !rejected_accm) {
+          rejected_accm = true;
+          sendCp(sim, proto, 4, cid, opts.substr(accm, 6));
+        } else {
+          sendCp(sim, proto, 2, cid, opts);
+          lcp_acked = true;
+        }
+        if (id == 0) {
+          std::string ours = "\x01\x04\x05\xDC";          // MRU 1500
+          ours += auth == 0xC023 ? std::string("\x03\x04\xC0\x23", 4)
+                                 : std::string("\x03\x05\xC2\x23\x05", 5);
+          ours += "\x05\x06";
+          put32(ours, 0x5EED1234);
+          sendCp(sim, proto, 1, ++id, ours);
+        }
+      } else if (code == 2 && cid == id) {
+        lcp_up = true;
+      } else if (code == 5) {
+        sendCp(sim, proto, 6, cid, "");
+        terminated = true;
+      }
+      if (lcp_up && lcp_acked && auth == 0xC223 && !chap_id) {
+        std::string c = "\x10";
+        c += std::string((const char*)challenge, 16);
+        c += "sim";
+        chap_id = 0x42;
+        sendCp(sim, 0xC223, 1, chap_id, c);
+      }
+    } else if (proto == 0xC023 && code == 1) {
+      uint8_t ulen = opts[0];
+      bool ok = opts.substr(1, ulen) == user &&
+                opts.substr(2 + ulen, (uint8_t)opts[1 + ulen]) == pwd;
+      auth_ok = ok;
+      sendCp(sim, proto, ok ? 2 : 3, cid, std::string("\x00", 1));
+    } else if (proto == 0xC223 && code == 2 && cid == chap_id) {
+      PppAccess::Md5 md5;
+      md5.update(&chap_id, 1);
+      md5.update((const uint8_t*)pwd.data(), pwd.size());
+      md5.update(challenge, 16);
+      uint8_t want[16];
+      md5.finish(want);
+      bool ok = opts.size() >= 17 && opts[0] == 16 &&
+                memcmp(opts.data() + 1, want, 16) == 0 && opts.substr(17) == user;
+      auth_ok = ok;
+      sendCp(sim, proto, ok ? 3 : 4, cid, "");
+    } else if (proto == 0x8021) {
+      if (code == 1) {
+        // Hand out the addresses by Nak, then Ack the corrected request
+        std::string nak;
+        for (size_t i = 0; i + 6 <= opts.size(); i += 6) {
+          uint8_t type = opts[i];
+          const uint8_t* want = type == 3 ? HOST_IP : type == 129 ? PEER_IP : DNS2_IP;
+          if (opts.substr(i + 2, 4) != ip4(want)) {
+            nak += opts.substr(i, 2) + ip4(want);
+          }
+        }
+        if (nak.size()) {
+          ipcp_nakked = true;
+          sendCp(sim, proto, 3, cid, nak);
+        } else {
+          sendCp(sim, proto, 2, cid, opts);
+        }
+        if (id < 2) {
+          sendCp(sim, proto, 1, id = 2, "\x03\x06" + ip4(PEER_IP));
+        }
+      } else if (code == 2 && cid == id) {
+        ipcp_up = true;
+      }
+    }
+  }
+
+  void sendIp(ModemSim& sim, uint8_t proto, const std::string& src,
+              const std::string& payload)
+  {
+    std::string ip = "\x45";
+    ip += (char)0;
+    put16(ip, 20 + payload.size());
+    put32(ip, 0x00004000);
+    ip += (char)64;
+    ip += (char)proto;
+    put16(ip, 0);
+    ip += src + ip4(HOST_IP);
+    uint16_t sum = sumFinish(sumAdd(0, ip));
+    ip[10] = sum >> 8;
+    ip[11] = sum;
+    send(sim, 0x0021, ip + payload);
+  }
+
+  void sendUdp(ModemSim& sim, const std::string& src, uint16_t sport,
+               uint16_t dport, const std::string& data)
+  {
+    std::string u;
+    put16(u, sport);
+    put16(u, dport);
+    put16(u, 8 + data.size());
+    put16(u, 0);
+    u += data;
+    uint16_t sum = sumFinish(sumAdd(sumAdd(0, pseudo(src, ip4(HOST_IP), 17, u.size())), u));
+    if (!sum) sum = 0xFFFF;
+    u[6] = sum >> 8;
+    u[7] = sum;
+    sendIp(sim, 17, src, u);
+  }
+
+  void sendTcp(ModemSim& sim, uint8_t flags, uint32_t seq,
+               const std::string& data, bool mss = false)
+  {
+    std::string t;
+    put16(t, 80);
+    put16(t, host_port);
+    put32(t, seq);
+    put32(t, rcv_nxt);
+    t += (char)((mss ? 6 : 5) << 4);
+    t += (char)flags;
+    put16(t, 8192);
+    put32(t, 0);
+    if (mss) put32(t, 0x02040578);  // MSS 1400
+    t += data;
+    std::string src = ip4(SERVER_IP);
+    uint16_t sum = sumFinish(sumAdd(sumAdd(0, pseudo(src, ip4(HOST_IP), 6, t.size())), t));
+    t[16] = sum >> 8;
+    t[17] = sum;
+    sendIp(sim, 6, src, t);
+  }
+
+  void sendPing(ModemSim& sim) {
+    std::string icmp = "\x08";
+    icmp += std::string(3, '\0');
+    put32(icmp, 0x12340001);
+    icmp += "are you there";
+    uint16_t sum = sumFinish(sumAdd(0, icmp));
+    icmp[2] = sum >> 8;
+    icmp[3] = sum;
+    sendIp(sim, 1, ip4(PEER_IP), icmp);
+  }
+
+  void onIp(ModemSim& sim, const std::string& p) {
+    if (p.size() < 20 || sumFinish(sumAdd(0, p.substr(0, 20))) != 0) {
+      bad++;
+      return;
+    }
+    std::string src = p.substr(12, 4);
+    std::string dst = p.substr(16, 4);
+    uint8_t proto = p[9];
+    std::string d = p.substr(20, get16(p, 2) - 20);
+    if (proto != 1 && sumFinish(sumAdd(sumAdd(0, pseudo(src, dst, proto, d.size())), d)) != 0) {
+      bad++;
+      return;
+    }
+
+    if (proto == 1) {
+      pong |= (uint8_t)d[0] == 0 && d.substr(8) == "are you there";
+    } else if (proto == 17) {
+      uint16_t sport = get16(d, 0);
+      uint16_t dport = get16(d, 2);
+      std::string data = d.substr(8);
+      if (dport == 53) {
+        onDns(sim, sport, data);
+      } else if (dport == 7) {
+        sendUdp(sim, dst, 7, sport, data);
+      }
+    } else if (proto == 6 && get16(d, 2) == 80) {
+      onTcp(sim, d);
+    }
+  }
+
+  // Answers A queries with a CNAME and then the address
+  void onDns(ModemSim& sim, uint16_t sport, const std::string& q) {
+    size_t end = 12;
+    while (end < q.size() && q[end]) end += (uint8_t)q[end] + 1;
+    std::string question = q.substr(12, end + 5 - 12);
+    std::string r = q.substr(0, 2);
+    r += "\x81\x80";
+    put16(r, 1);
+    put16(r, 2);
+    put32(r, 0);
+    r += question;
+    r += "\xC0\x0C";
+    put16(r, 5);
+    put16(r, 1);
+    put32(r, 60);
+    put16(r, 6);
+    r += "\x03www\xC0\x0C";
+    r += "\xC0\x0C";
+    put16(r, 1);
+    put16(r, 1);
+    put32(r, 60);
+    put16(r, 4);
+    r += ip4(SERVER_IP);
+    sendUdp(sim, ip4(PEER_IP), 53, sport, r);
+  }
+
+  void onTcp(ModemSim& sim, const std::string& t) {
+    uint32_t seq = get32(t, 4);
+    uint32_t ack = get32(t, 8);
+    uint8_t off = ((uint8_t)t[12] >> 4) * 4;
+    uint8_t flags = t[13];
+    std::string data = t.substr(off);
+
+    if (flags & 0x02) {
+      host_port = get16(t, 0);
+      for (size_t i = 20; i + 4 <= off; i += t[i] <= 1 ? 1 : (uint8_t)t[i+1]) {
+        if (t[i] == 2) host_mss = get16(t, i + 2);
+      }
+      rcv_nxt = seq + 1;
+      snd_una = snd_nxt = iss + 1;
+      host_wnd = get16(t, 14);
+      sendTcp(sim, 0x12, iss, "", true);
+      return;
+    }
+    if (flags & 0x10) {
+      if (ack - snd_una <= snd_nxt - snd_una) snd_una = ack;
+      host_wnd = get16(t, 14);
+    }
+    if (seq == rcv_nxt && (data.size() || (flags & 0x01))) {
+      request += data;
+      rcv_nxt += data.size();
+      if (flags & 0x01) {
+        host_fin = true;
+        rcv_nxt++;
+      }
+      sendTcp(sim, 0x10, snd_nxt, "");
+    }
+    pump(sim);
+  }
+
+  // Sends the reply within the host's window, then closes our side
+  void pump(ModemSim& sim) {
+    if (request.find("\r\n\r\n") == std::string::npos || fin_sent) return;
+    for (;;) {
+      size_t sent = snd_nxt - (iss + 1);
+      uint32_t inflight = snd_nxt - snd_una;
+      if (sent >= body.size() || inflight >= host_wnd) break;
+      size_t n = std::min(body.size() - sent, (size_t)std::min(536u, host_wnd - inflight));
+      sendTcp(sim, 0x18, snd_nxt, body.substr(sent, n));
+      snd_nxt += n;
+    }
+    if (snd_una == iss + 1 + body.size()) {
+      sendTcp(sim, 0x11, snd_nxt, "");
+      snd_nxt++;
+      fin_sent = true;
+    }
+  }
+};
+
+// Dials into a fresh peer with the given authentication
+static void answer(ModemSim& sim, PppPeer& peer) {
+  sim.on("D*99#", [&peer](ModemSim& s, const String&) {
+    s.reply("CONNECT 150000000");
+    s.setByteHandler([&peer](ModemSim& s2, uint8_t c) { peer.feed(s2, c); });
+  });
+}
+
+int main() {
+  // An MD5 test vector from RFC 1321 before trusting it for CHAP
+  PppAccess::Md5 md5;
+  md5.update((const uint8_t*)"abc", 3);
+  uint8_t digest[16];
+  md5.finish(digest);
+  check(memcmp(digest, "\x90\x01\x50\x98\x3c\xd2\x4f\xb0\xd6\x96\x3f\x7d\x28\xe1\x7f\x72", 16) == 0,
+        "MD5 of abc");
+
+  {
+    ModemSim sim(ModemSim::SIMCOM, 460800);
+    PppPeer peer(0xC023, "user", "secret");
+    answer(sim, peer);
+    for (int i = 0; i < 2000; i++) peer.body += (char)(i * 7);
+
+    TinyGsmPpp ppp(sim);
+    check(ppp.begin("user", "secret", true, 5000), "PAP: link up");
+    check(peer.rejected_accm && peer.auth_ok && peer.ipcp_nakked && peer.ipcp_up,
+          "PAP: ACCM rejected, authenticated, addresses from Nak");
+    check(ppp.localIP() == IPAddress(10, 64, 0, 2), "PAP: local IP");
+    check(ppp.dnsIP(0) == IPAddress(10, 64, 0, 1) && ppp.dnsIP(1) == IPAddress(10, 64, 0, 9),
+          "PAP: DNS servers");
+
+    uint8_t ip[4];
+    check(ppp.resolve("example.com", ip) && !memcmp(ip, SERVER_IP, 4), "DNS past a CNAME");
+
+    TinyGsmPpp::GsmClient client(ppp);
+    check(client.connect("example.com", 80), "TCP connect");
+    check(peer.host_mss == TINY_GSM_PPP_MTU - 40, "TCP: MSS from our MTU");
+    client.print("GET / HTTP/1.0\r\nHost: example.com\r\n\r\n");
+    std::string got;
+    uint32_t start = millis();
+    while (client.connected() && millis() - start < 3000) {
+      uint8_t buf[100];
+      int n = client.read(buf, sizeof(buf));
+      if (n > 0) got.append((const char*)buf, n);
+    }
+    check(peer.request == "GET / HTTP/1.0\r\nHost: example.com\r\n\r\n", "TCP: request arrived");
+    check(got == peer.body, "TCP: reply larger than the window arrives whole");
+    client.stop();
+    check(peer.host_fin, "TCP: close");
+
+    TinyGsmPpp::GsmUdp udp(ppp);
+    udp.begin(40000);
+    udp.beginPacket(IPAddress(10, 64, 0, 1), 7);
+    udp.print("echo me");
+    check(udp.endPacket(), "UDP: send");
+    int len = 0;
+    start = millis();
+    while (len <= 0 && millis() - start < 1000) {
+      ppp.maintain();
+      len = udp.parsePacket();
+    }
+    char echo[16] = { 0 };
+    udp.read((uint8_t*)echo, sizeof(echo) - 1);
+    check(len == 7 && !strcmp(echo, "echo me") && udp.remotePort() == 7, "UDP: echo");
+
+    peer.sendPing(sim);
+    start = millis();
+    while (!peer.pong && millis() - start < 1000) ppp.maintain();
+    check(peer.pong, "answers a ping");
+
+    check(peer.bad == 0, "PAP: no bad checksums");
+    ppp.end();
+    check(peer.terminated && !ppp.isConnected(), "PAP: terminate");
+  }
+
+  {
+    ModemSim sim(ModemSim::SIMCOM, 460800);
+    PppPeer peer(0xC223, "user", "secret");
+    answer(sim, peer);
+
+    TinyGsmPpp ppp(sim);
+    check(ppp.begin("user", "secret", true, 5000), "CHAP: link up");
+    check(peer.auth_ok, "CHAP: response matches");
+    check(peer.bad == 0, "CHAP: no bad checksums");
+    ppp.end();
+    check(peer.terminated, "CHAP: terminate");
+  }
+
+  {
+    ModemSim sim(ModemSim::SIMCOM, 460800);
+    PppPeer peer(0xC023, "user", "secret");
+    answer(sim, peer);
+
+    TinyGsmPpp ppp(sim);
+    check(!ppp.begin("user", "wrong", true, 5000) && !peer.auth_ok, "PAP: wrong password fails");
+  }
+
+  return failures ? 1 : 0;
+}
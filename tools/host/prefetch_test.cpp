@@ -0,0 +1,52 @@
+/**
+ * @file       prefetch_test.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * TINY_GSM_PREFETCH on a SIM800 socket whose payload is larger than its rx
+ * fifo: maintain() reads ahead, and stop() leaves nothing of the closed
+ * connection behind.  Exits non-zero on a failure.
+ */
+
+#define TINY_GSM_MODEM_SIM800
+#define TINY_GSM_RX_BUFFER 64
+#define TINY_GSM_PREFETCH  128
+
+#include <HostCompat/ModemSim.h>
+#include <TinyGsmClient.h>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%s - %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok) failures++;
+}
+
+int main() {
+  ModemSim sim(ModemSim::SIMCOM, 115200);
+  sim.setLatency(2);
+  std::string payload(300, 'p');
+  sim.setPayload((const uint8_t*)payload.data(), payload.size());
+
+  TinyGsm modem(sim);
+  check(modem.init(), "init");
+
+  TinyGsmClient client(modem, 0);
+  check(client.connect("10.0.0.1", 80), "connect");
+
+  uint32_t start = millis();
+  while (client.available() <= 0 && millis() - start < 2000L) {
+    modem.maintain();
+  }
+  check(client.available() > 0, "data read ahead");
+
+  client.stop();
+  check(client.available() == 0, "nothing available after stop");
+  check(!client.connected(), "not connected after stop");
+  uint8_t buf[32];
+  check(client.read(buf, sizeof(buf)) <= 0, "nothing to read after stop");
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file       replay.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * Runs a sketch with Serial1 playing back a TinyGsmTrace, so a field
+ * capture can be reproduced step by step on a host:
+ *
+ *   make replay SKETCH=examples/WebClient/WebClient.ino TRACE=field.tgt
+ *
+ * Exits when the trace has been played and the sketch is idle for a few
+ * seconds, or after --timeout seconds, and says whether the library wrote
+ * the same bytes the recorded device did.
+ */
+
+#include <HostCompat/Replay.h>
+#include <signal.h>
+
+ModemSim Serial1(ModemSim::SIMCOM);
+
+static unsigned timeout = 300;
+static unsigned elapsed = 0;
+static unsigned idle = 0;
+
+static void report() {
+  long mismatch = Serial1.replayMismatch();
+  fprintf(stderr, "replay: %zu of %zu records played, ",
+          Serial1.replayPosition(), Serial1.replayRecords());
+  if (mismatch < 0) {
+    fprintf(stderr, "output matches the trace\n");
+  } else {
+    fprintf(stderr, "output differs from the trace at byte %ld\n", mismatch);
+  }
+  _exit(mismatch < 0 ? 0 : 2);
+}
+
+// Sketches tend to spin forever once done or on failure, so a once a second
+// tick decides when to stop: at the end of the trace, or when the output has
+// diverged and the trace is stuck waiting for bytes that will not come
+static void tick(int) {
+  bool stuck = Serial1.replayDone() ||
+               (Serial1.replayMismatch() >= 0 && Serial1.replayIdle());
+  idle = stuck ? idle + 1 : 0;
+  if (idle >= 3 || ++elapsed >= timeout) {
+    report();
+  }
+  alarm(1);
+}
+
+int main(int argc, char* argv[]) {
+  const char* path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--timeout") && i + 1 < argc) {
+      timeout = atoi(argv[++i]);
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path || !Serial1.loadTrace(path)) {
+    fprintf(stderr, "usage: replay [--timeout SECONDS] TRACE\n");
+    return 1;
+  }
+  signal(SIGALRM, tick);
+  alarm(1);
+
+  setup();
+  for (;;) {
+    loop();
+  }
+}
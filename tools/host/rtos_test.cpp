@@ -0,0 +1,102 @@
+/**
+ * @file       rtos_test.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ *
+ * TINY_GSM_RTOS with std::thread: two threads each send a payload through
+ * their own SIM800 socket and read the echo back, while a TinyGsmReader
+ * runs maintain() on a third.  Every byte has to come back on the socket
+ * it went out on.  Exits non-zero on a failure.
+ */
+
+#define TINY_GSM_MODEM_SIM800
+#ifndef TINY_GSM_RTOS
+  #define TINY_GSM_RTOS
+#endif
+
+#include <HostCompat/ModemSim.h>
+#include <TinyGsmClient.h>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%s - %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok) failures++;
+}
+
+// Different on every socket, so a byte that lands on the wrong one shows
+static std::string pattern(int mux, size_t len) {
+  std::string s;
+  for (size_t i = 0; i < len; i++) {
+    s += (char)('A' + mux * 8 + (i * 7 + i / 97) % 8);
+  }
+  return s;
+}
+
+struct Worker {
+  TinyGsmClient* client;
+  std::string    sent;
+  std::string    got;
+  bool           connected;
+
+  // Writes in pieces and reads whatever has come back in between
+  void run() {
+    connected = client->connect("10.0.0.1", 80);
+    if (!connected) return;
+    size_t pos = 0;
+    uint32_t start = millis();
+    while (got.size() < sent.size() && millis() - start < 20000L) {
+      if (pos < sent.size()) {
+        size_t n = TinyGsmMin(sent.size() - pos, (size_t)300);
+        pos += client->write((const uint8_t*)sent.data() + pos, n);
+      }
+      uint8_t buf[128];
+      int n = client->read(buf, sizeof(buf));
+      if (n > 0) {
+        got.append((const char*)buf, n);
+      } else {
+        delay(1);
+      }
+    }
+    client->stop();
+  }
+
+  static void start(Worker* w) { w->run(); }
+};
+
+int main() {
+  ModemSim sim(ModemSim::SIMCOM, 115200);
+  sim.setLatency(2);
+  sim.setEcho(true);
+
+  TinyGsm modem(sim);
+  check(modem.init(), "init");
+
+  TinyGsmClient client0(modem, 0);
+  TinyGsmClient client1(modem, 1);
+  Worker w0 = { &client0, pattern(0, 4000), "", false };
+  Worker w1 = { &client1, pattern(1, 3000), "", false };
+
+  TinyGsmReader<TinyGsm> reader(modem);
+  check(reader.begin(5), "reader started");
+
+  std::thread t0(Worker::start, &w0);
+  std::thread t1(Worker::start, &w1);
+  t0.join();
+  t1.join();
+
+  check(w0.connected && w1.connected, "both sockets connected");
+  check(w0.got == w0.sent, "socket 0 echo intact");
+  check(w1.got == w1.sent, "socket 1 echo intact");
+
+  {
+    TinyGsmLock lock(modem.mutex);
+    check(modem.testAT(1000), "AT after the sockets");
+  }
+  reader.end();
+  check(!reader.isRunning(), "reader stopped");
+
+  return failures ? 1 : 0;
+}
@@ -14,6 +14,14 @@ TinyGsmClient client(modem);
   TinyGsmClientSecure client_secure(modem);
 #endif
 
+#if defined(TINY_GSM_MODEM_HAS_TRANSPARENT)
+  TinyGsmClientTransparent client_transparent(modem);
+#endif
+
+#if defined(TINY_GSM_MODEM_HAS_HTTP)
+  TinyGsmHttp http(modem);
+#endif
+
 char server[] = "somewhere";
 char resource[] = "something";
 
@@ -71,6 +79,46 @@ void loop() {
 
   client.stop();
 
+  #if defined(TINY_GSM_MODEM_HAS_TRANSPARENT)
+    client_transparent.connect(server, 80);
+    client_transparent.print("Connection: close\r\n\r\n");
+    client_transparent.pause();
+    modem.getSignalQuality();
+    client_transparent.resume();
+    client_transparent.read();
+    client_transparent.stop();
+  #endif
+
+  #if defined(TINY_GSM_MODEM_HAS_HTTP)
+    http.get("http://somewhere/something");
+    http.contentLength();
+    http.readBody(Serial);
+    http.post("http://somewhere/something", "text/plain", "data");
+    http.stop();
+  #endif
+
+  #if defined(TINY_GSM_MODEM_HAS_FILES)
+    modem.fileList();
+    modem.fileWrite("config.txt", (const uint8_t*)"abc", 3);
+    modem.fileSize("config.txt");
+    modem.fileStream("config.txt", Serial);
+    modem.fileDelete("config.txt");
+  #endif
+
+  #if defined(TINY_GSM_MODEM_HAS_FILE_DOWNLOAD)
+    modem.downloadFile("http://somewhere/something", "update.bin");
+    modem.fileStream("update.bin", Serial, 1024);
+  #endif
+
+  #if defined(TINY_GSM_STATS)
+    const TinyGsmStats& stats = modem.getStats();
+    for (int i = 0; i < stats.used; i++) {
+      Serial.println(stats.commands[i].tag);
+      Serial.println(stats.commands[i].max_ms);
+    }
+    modem.resetStats();
+  #endif
+
   #if defined(TINY_GSM_MODEM_HAS_GPRS)
     modem.gprsDisconnect();
   #endif